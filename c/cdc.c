@@ -32,10 +32,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(_WIN32) && \
+  !defined(CDC_NO_VECTOR_KERNELS)
+// We compile SSE4.1 and AVX2 versions of the column kernels and the
+// bulk parser and pick one at run time.
+#define CDC_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(_WIN32)
+// For sched_yield(), while we wait for another thread.
+#include <sched.h>
+#endif
+
 #define DEBUG_GTAI 0
 #define DEBUG_UTC 0
 #define DEBUG_UTCPLUS 0
@@ -75,6 +89,13 @@ static int chain_dispose(struct cdc_zone_struct *self);
 static int null_init(struct cdc_zone_struct *self, int arg_i, void *arg_n);
 static int null_dispose(struct cdc_zone_struct *self);
 
+/** A generic span function for zones whose offset never changes */
+static int const_offset_span(struct cdc_zone_struct *self,
+			     const cdc_calendar_t *cal,
+			     cdc_calendar_t *start,
+			     cdc_calendar_t *end,
+			     cdc_calendar_t *offset);
+
 static int system_gtai_diff(struct cdc_zone_struct *self,
 			    cdc_interval_t *ival,
 			    const cdc_calendar_t *before,
@@ -116,7 +137,9 @@ static cdc_zone_t s_system_gtai =
     system_gtai_op,
     system_gtai_aux,
     system_gtai_epoch,
-    system_gtai_lower_zone
+    system_gtai_lower_zone,
+    const_offset_span,
+    0
   };
 
 /* UTC: Applies UTC corrections to TAI
@@ -183,7 +206,7 @@ static utc_lookup_entry_t utc_lookup_table[] =
 
 
     // The June 1972 leap second
-    { { 1972, CDC_JUNE, 31, 23, 59, 59, 0, CDC_SYSTEM_UTC }, 
+    { { 1972, CDC_JUNE, 30, 23, 59, 59, 0, CDC_SYSTEM_UTC }, 
       { -11, 0 }
     },
 
@@ -264,7 +287,7 @@ static utc_lookup_entry_t utc_lookup_table[] =
     },
 
     { { 1997, CDC_JUNE, 30, 23, 59, 59, 0, CDC_SYSTEM_UTC },
-      { -331, 0 }
+      { -31, 0 }
     },
 
     { { 1998, CDC_DECEMBER, 31, 23, 59, 59, 0, CDC_SYSTEM_UTC },
@@ -281,6 +304,14 @@ static utc_lookup_entry_t utc_lookup_table[] =
 
     { { 2012, CDC_JUNE, 30, 23, 59, 59, 0, CDC_SYSTEM_UTC },
       { -35, 0 }
+    },
+
+    { { 2015, CDC_JUNE, 30, 23, 59, 59, 0, CDC_SYSTEM_UTC },
+      { -36, 0 }
+    },
+
+    { { 2016, CDC_DECEMBER, 31, 23, 59, 59, 0, CDC_SYSTEM_UTC },
+      { -37, 0 }
     }
   };
      
@@ -318,6 +349,12 @@ static int system_utc_epoch(struct cdc_zone_struct *self,
 static int system_utc_lower_zone(struct cdc_zone_struct *self,
 				 struct cdc_zone_struct **next);
 
+static int system_utc_span(struct cdc_zone_struct *self,
+			   const cdc_calendar_t *cal,
+			   cdc_calendar_t *start,
+			   cdc_calendar_t *end,
+			   cdc_calendar_t *offset);
+
 static cdc_zone_t s_system_utc = 
   {
     NULL,
@@ -329,7 +366,9 @@ static cdc_zone_t s_system_utc =
     system_utc_op,
     system_utc_aux,
     system_utc_epoch ,
-    system_utc_lower_zone
+    system_utc_lower_zone,
+    system_utc_span,
+    0
   };
 
 
@@ -381,7 +420,9 @@ static cdc_zone_t s_system_utcplus =
     system_utcplus_op,
     system_utcplus_aux,
     system_utcplus_epoch,
-    system_utcplus_lower_zone 
+    system_utcplus_lower_zone,
+    const_offset_span,
+    0
   };
 
 
@@ -408,6 +449,12 @@ static int system_ukct_epoch(struct cdc_zone_struct *self,
 static int system_ukct_lower_zone(struct cdc_zone_struct *self,
 				 struct cdc_zone_struct **next);
 
+static int system_ukct_span(struct cdc_zone_struct *self,
+			    const cdc_calendar_t *cal,
+			    cdc_calendar_t *start,
+			    cdc_calendar_t *end,
+			    cdc_calendar_t *offset);
+
 
 static cdc_zone_t s_system_ukct = 
   {
@@ -420,7 +467,9 @@ static cdc_zone_t s_system_ukct =
     system_ukct_op,
     system_ukct_aux,
     system_ukct_epoch,
-    system_ukct_lower_zone
+    system_ukct_lower_zone,
+    system_ukct_span,
+    0
   };
 
 /* -------------------------- Rebase ------------------- */
@@ -472,7 +521,9 @@ static cdc_zone_t s_system_rebased =
     system_rebased_op,
     system_rebased_aux,
     system_rebased_epoch,
-    system_rebased_lower_zone
+    system_rebased_lower_zone,
+    const_offset_span,
+    0
   };
 
 
@@ -507,6 +558,313 @@ static int gregorian_months[] =
 #define SECONDS_PER_DAY    (SECONDS_PER_MINUTE * MINUTES_PER_HOUR * HOURS_PER_DAY)
 #define SECONDS_PER_YEAR   (GREGORIAN_DAYS_IN_YEAR * SECONDS_PER_DAY)
 
+// Days in a 400-year Gregorian cycle, after which everything repeats.
+#define GREGORIAN_DAYS_PER_ERA (146097)
+
+// Days from 0000-03-01 (the start of our internal March-based era) to
+//  1958-01-01, which is day 0 for cdc_days_from_civil().
+#define CIVIL_EPOCH_SHIFT (715085)
+
+// Day numbers a little beyond those of years INT_MIN and INT_MAX. 
+//  civil_from_days() overflows for days far enough outside these, and
+//  no day outside them has a year that fits in an int anyway.
+#define CIVIL_DAYS_MAX \
+  ((((int64_t)INT_MAX / 400) + 2) * GREGORIAN_DAYS_PER_ERA - CIVIL_EPOCH_SHIFT)
+#define CIVIL_DAYS_MIN \
+  ((((int64_t)INT_MIN / 400) - 2) * GREGORIAN_DAYS_PER_ERA - CIVIL_EPOCH_SHIFT)
+
+/** Division and remainder rounding towards -infinity, so that times
+ *  before the epoch fold the same way as those after it.
+ */
+static inline int64_t floor_div(int64_t a, int64_t b)
+{
+  int64_t q = a / b;
+  return ((a % b) && ((a < 0) != (b < 0))) ? (q - 1) : q;
+}
+
+static inline int64_t floor_mod(int64_t a, int64_t b)
+{
+  return a - (floor_div(a, b) * b);
+}
+
+/** Closed-form day number for a proleptic Gregorian date.
+ *
+ *  Counting years from 1 March puts the leap day at the end of the
+ *  year, so the day of the year becomes a linear function of the
+ *  month and the era a linear function of the year.
+ *
+ *  Months outside 0-11 are folded into the year and mday is linear,
+ *  so this will happily normalise dates like 2010-13-40.
+ */
+static inline int64_t days_from_civil(int64_t year, int64_t month, int64_t mday)
+{
+  int64_t era, yoe, mp, doy, doe;
+
+  year += floor_div(month, 12);
+  month = floor_mod(month, 12);
+  if (month < CDC_MARCH) { --year; }
+
+  era = floor_div(year, 400);
+  yoe = year - (era * 400);
+  mp = (month + 10) % 12; // March = 0, February = 11
+  doy = ((153 * mp + 2) / 5) + mday - 1;
+  doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+  return (era * GREGORIAN_DAYS_PER_ERA) + doe - CIVIL_EPOCH_SHIFT;
+}
+
+/** The inverse of days_from_civil(). days must be between 
+ *  CIVIL_DAYS_MIN and CIVIL_DAYS_MAX.
+ */
+static inline void civil_from_days(int64_t days,
+				   int64_t *year, int *month, int *mday)
+{
+  int64_t z = days + CIVIL_EPOCH_SHIFT;
+  int64_t era = floor_div(z, GREGORIAN_DAYS_PER_ERA);
+  int64_t doe = z - (era * GREGORIAN_DAYS_PER_ERA);
+  int64_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+  int64_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+  int64_t mp = ((5 * doy) + 2) / 153;
+  int m = (int)((mp < 10) ? (mp + 2) : (mp - 10));
+
+  (*year) = yoe + (era * 400) + ((m < CDC_MARCH) ? 1 : 0);
+  (*month) = m;
+  (*mday) = (int)(doy - (((153 * mp) + 2) / 5) + 1);
+}
+
+/** Normalise a Gregorian calendar time in place.
+ *
+ *  Any field may be out of range (or negative). The time of day is
+ *  folded into a count of seconds, any whole days carried into the
+ *  day number of the date and the result converted back, so this
+ *  costs the same however far out the fields are.
+ *
+ *  Month and year carries happen before day carries, exactly as they
+ *  would if you added them fieldwise: 31 Jan + 1 month is 31 Feb,
+ *  which is 3 Mar (or 2 Mar in a leap year).
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if the year
+ *          overflows.
+ */
+static int gtai_normalise(cdc_calendar_t *cal)
+{
+  int64_t ns = cal->ns;
+  int64_t secs, days, year;
+
+  secs = floor_div(ns, ONE_BILLION) + cal->second + 
+    ((int64_t)cal->minute * SECONDS_PER_MINUTE) + 
+    ((int64_t)cal->hour * SECONDS_PER_HOUR);
+  days = floor_div(secs, SECONDS_PER_DAY) + 
+    days_from_civil(cal->year, cal->month, cal->mday);
+  secs = floor_mod(secs, SECONDS_PER_DAY);
+
+  if (days < CIVIL_DAYS_MIN || days > CIVIL_DAYS_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  civil_from_days(days, &year, &cal->month, &cal->mday);
+  if (year < INT_MIN || year > INT_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  cal->year = (int)year;
+  cal->hour = (int)(secs / SECONDS_PER_HOUR);
+  cal->minute = (int)((secs / SECONDS_PER_MINUTE) % MINUTES_PER_HOUR);
+  cal->second = (int)(secs % SECONDS_PER_MINUTE);
+  cal->ns = (long int)floor_mod(ns, ONE_BILLION);
+  return 0;
+}
+
+int cdc_days_from_civil(int64_t *days, int year, int month, int mday)
+{
+  (*days) = days_from_civil(year, month, mday);
+  return 0;
+}
+
+int cdc_civil_from_days(int *year, int *month, int *mday, int64_t days)
+{
+  int64_t y;
+
+  if (days < CIVIL_DAYS_MIN || days > CIVIL_DAYS_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  civil_from_days(days, &y, month, mday);
+  if (y < INT_MIN || y > INT_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+  (*year) = (int)y;
+  return 0;
+}
+
+/* -------------------- Instants ---------------- */
+
+/** Is 'zone' built entirely from zones whose diff() is linear
+ *  in TAI, so that we can take differences between instants?
+ */
+static int zone_has_linear_diff(cdc_zone_t *zone)
+{
+  while (zone)
+    {
+      cdc_zone_t *low = NULL;
+
+      if (zone->diff == system_gtai_diff) { return 1; }
+      if (zone->diff != system_lower_diff) { return 0; }
+      if (zone->lower_zone(zone, &low)) { return 0; }
+      zone = low;
+    }
+  return 0;
+}
+
+/** Are both months in range? system_gtai_diff() and the instant
+ *  paths that stand in for it reject dates whose months aren't.
+ */
+static int diff_months_valid(const cdc_calendar_t *before,
+			     const cdc_calendar_t *after)
+{
+  return (before->month >= 0 && before->month <= CDC_DECEMBER &&
+	  after->month >= 0 && after->month <= CDC_DECEMBER);
+}
+
+/** Is 'zone' one whose simple adds are elapsed-time adds, and for
+ *  which going via an instant is no more expensive than a fieldwise
+ *  op?
+ */
+static int zone_has_linear_op(const cdc_zone_t *zone)
+{
+  return (zone->op == system_gtai_op);
+}
+
+static void instant_from_tai(cdc_instant_t *out, const cdc_calendar_t *tai)
+{
+  int64_t s;
+
+  s = ((int64_t)tai->hour * SECONDS_PER_HOUR) + 
+    ((int64_t)tai->minute * SECONDS_PER_MINUTE) + tai->second + 
+    floor_div(tai->ns, ONE_BILLION);
+
+  out->s = (SECONDS_PER_DAY * days_from_civil(tai->year, tai->month, tai->mday)) + s;
+  out->ns = (long int)floor_mod(tai->ns, ONE_BILLION);
+}
+
+static int instant_to_tai(cdc_calendar_t *out, const cdc_instant_t *src)
+{
+  int64_t year;
+  int64_t ns = src->ns;
+  int64_t s = src->s + floor_div(ns, ONE_BILLION);
+  int64_t secs = floor_mod(s, SECONDS_PER_DAY);
+  int64_t days = floor_div(s, SECONDS_PER_DAY);
+
+  if (days < CIVIL_DAYS_MIN || days > CIVIL_DAYS_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  civil_from_days(days, &year, &out->month, &out->mday);
+  if (year < INT_MIN || year > INT_MAX)
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  out->year = (int)year;
+  out->hour = (int)(secs / SECONDS_PER_HOUR);
+  out->minute = (int)((secs / SECONDS_PER_MINUTE) % MINUTES_PER_HOUR);
+  out->second = (int)(secs % SECONDS_PER_MINUTE);
+  out->ns = (long int)floor_mod(ns, ONE_BILLION);
+  out->system = CDC_SYSTEM_GREGORIAN_TAI;
+  out->flags = 0;
+  return 0;
+}
+
+int cdc_zone_to_instant(cdc_zone_t *zone,
+			cdc_instant_t *out,
+			const cdc_calendar_t *src)
+{
+  cdc_calendar_t tai;
+  cdc_zone_t *low;
+  int rv;
+
+  rv = cdc_zone_lower_to(zone, &tai, &low, src, CDC_SYSTEM_GREGORIAN_TAI);
+  if (rv) { return rv; }
+
+  instant_from_tai(out, &tai);
+  return 0;
+}
+
+int cdc_zone_from_instant(cdc_zone_t *zone,
+			  cdc_calendar_t *out,
+			  const cdc_instant_t *src)
+{
+  cdc_calendar_t tai;
+  int rv;
+
+  rv = instant_to_tai(&tai, src);
+  if (rv) { return rv; }
+
+  if (zone->system == CDC_SYSTEM_GREGORIAN_TAI)
+    {
+      memcpy(out, &tai, sizeof(cdc_calendar_t));
+      return 0;
+    }
+
+  return cdc_zone_raise(zone, out, &tai);
+}
+
+int cdc_instant_cmp(const cdc_instant_t *a,
+		    const cdc_instant_t *b)
+{
+  if (a->s != b->s) { return (a->s < b->s) ? -1 : 1; }
+  if (a->ns != b->ns) { return (a->ns < b->ns) ? -1 : 1; }
+  return 0;
+}
+
+int cdc_instant_diff(cdc_interval_t *result,
+		     const cdc_instant_t *before,
+		     const cdc_instant_t *after)
+{
+  // Negative intervals are the negation of the positive one, as 
+  // they are from system_gtai_diff().
+  if (cdc_instant_cmp(before, after) > 0)
+    {
+      cdc_instant_diff(result, after, before);
+      result->s = -result->s;
+      result->ns = -result->ns;
+      return 0;
+    }
+
+  result->s = after->s - before->s;
+  result->ns = after->ns - before->ns;
+  if (result->ns < 0)
+    {
+      --result->s;
+      result->ns += ONE_BILLION;
+    }
+  return 0;
+}
+
+int cdc_instant_add(cdc_instant_t *result,
+		    const cdc_instant_t *a,
+		    const cdc_interval_t *ival)
+{
+  int64_t ns = (int64_t)a->ns + ival->ns;
+  int64_t s = ival->s + floor_div(ns, ONE_BILLION);
+
+  if ((s > 0 && a->s > INT64_MAX - s) ||
+      (s < 0 && a->s < INT64_MIN - s))
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  result->s = a->s + s;
+  result->ns = (long int)floor_mod(ns, ONE_BILLION);
+  return 0;
+}
+
+
 int cdc_interval_add(cdc_interval_t *result,
 			  const cdc_interval_t *a,
 			  const cdc_interval_t *b)
@@ -544,13 +902,10 @@ int cdc_interval_subtract(cdc_interval_t *result,
 
 
 
-int cdc_zone_new(int system,
-		      cdc_zone_t **out_zone,
-		      int arg_i,
-		      void *arg_n)
+/** @return The zone cdc_zone_new() copies for system, or NULL. */
+static cdc_zone_t *zone_prototype(int system)
 {
   cdc_zone_t *prototype = NULL;
-  int rv;
 
   if (system >= CDC_SYSTEM_UTCPLUS_BASE && 
       system <= (CDC_SYSTEM_UTCPLUS_BASE + 1440))
@@ -576,6 +931,17 @@ int cdc_zone_new(int system,
         // Intentional dropthrough ..
         break;
     }
+  return prototype;
+}
+
+int cdc_zone_new(int system,
+		      cdc_zone_t **out_zone,
+		      int arg_i,
+		      void *arg_n)
+{
+  cdc_zone_t *prototype = zone_prototype(system);
+  int rv;
+
   if (prototype == NULL)
     {
       (*out_zone) = NULL;
@@ -606,6 +972,11 @@ int cdc_zone_dispose(cdc_zone_t **io_zone)
   int rv = 0;
   
   if (!io_zone || !(*io_zone)) { return 0; }
+  if ((*io_zone)->flags & (CDC_ZONE_FLAG_SHARED | CDC_ZONE_FLAG_ARENA)) 
+    {
+      (*io_zone) = NULL;
+      return 0;
+    }
   {
     cdc_zone_t *t = *io_zone;
     rv = t->dispose(t);
@@ -719,43 +1090,76 @@ int cdc_interval_cmp(const cdc_interval_t *a,
   return 0;
 }
 
+/** Make the fieldwise offset that cdc_zone_add() adds to 'date' to
+ *  add 'ival' to it.
+ */
+static int zone_add_offset(cdc_calendar_t *offset,
+			   const cdc_calendar_t *date,
+			   const cdc_interval_t *ival)
+{
+  int64_t s;
+
+  memset(offset, '\0', sizeof(cdc_calendar_t));
+
+  s = ival->s;
+
+  if (s > (1 << 30) || s < -(1 << 30))
+    {
+      // Too big for the seconds field, so split it into whole
+      // Gregorian cycles, days and seconds. Days in the underlying TAI
+      // are always 86400s long, so this is exactly the same fieldwise
+      // add and every zone layer gets to normalise it just once.
+      int64_t days = floor_div(s, SECONDS_PER_DAY);
+      int64_t cycles = floor_div(days, GREGORIAN_DAYS_PER_ERA);
+      int64_t years = cycles * 400;
+
+      if (years < INT_MIN || years > INT_MAX ||
+	  date->year + years < INT_MIN || date->year + years > INT_MAX)
+	{
+	  return CDC_ERR_INVALID_ARGUMENT;
+	}
+
+      offset->year = (int)years;
+      offset->mday = (int)(days - (cycles * GREGORIAN_DAYS_PER_ERA));
+      offset->second = (int)floor_mod(s, SECONDS_PER_DAY);
+    }
+  else
+    {
+      offset->second = (int)s;
+    }
+
+  offset->ns = ival->ns;
+  return 0;
+}
+
 int cdc_zone_add(cdc_zone_t *zone,
 		      cdc_calendar_t *out,
 		      const cdc_calendar_t *date,
 		      const cdc_interval_t *ival)
 {
   int rv;
-  int64_t s;
   cdc_calendar_t offset, tmp;
 
-
-  memset(&offset, '\0', sizeof(cdc_calendar_t));
-  memcpy(out, date, sizeof(cdc_calendar_t));
-
-  s = ival->s;
-
-  while (s > (1 << 30))
+  if (date->system == zone->system && zone_has_linear_op(zone))
     {
-      offset.second = (1<<30); 
-      rv = cdc_op(zone, &tmp, out, &offset, CDC_OP_SIMPLE_ADD);
-      memcpy(out, &tmp, sizeof(cdc_calendar_t));
+      // A simple add is an elapsed-time add, so do it on instants.
+      cdc_instant_t when;
+
+      rv = cdc_zone_to_instant(zone, &when, date);
       if (rv) { return rv; }
-      s -= (1<<30);
-    }
-  while (s < -(1<<30))
-    {
-      offset.second = -(1<<30);
-      rv = cdc_op(zone, &tmp, out, &offset, CDC_OP_SIMPLE_ADD);
-      memcpy(out, &tmp, sizeof(cdc_calendar_t));
+      rv = cdc_instant_add(&when, &when, ival);
       if (rv) { return rv; }
-      s += (1<<30);
+      return cdc_zone_from_instant(zone, out, &when);
     }
 
-  offset.second = s;
-  offset.ns = ival->ns;
-  rv = cdc_op(zone, &tmp, out, &offset, CDC_OP_SIMPLE_ADD);
+  rv = zone_add_offset(&offset, date, ival);
+  if (rv) { return rv; }
+
+  rv = cdc_op(zone, &tmp, date, &offset, CDC_OP_SIMPLE_ADD);
+  if (rv) { return rv; }
+
   memcpy(out, &tmp, sizeof(cdc_calendar_t));
-  return rv;
+  return 0;
 }
 
 int cdc_interval_sprintf(char *buf,
@@ -781,179 +1185,597 @@ int cdc_interval_parse(cdc_interval_t *out,
     return 0;
 }
 
-int cdc_calendar_sprintf(char *buf,
-			      int n,
-			      const cdc_calendar_t *date)
-{
-  return snprintf(buf, n, 
-		  "%04d-%02d-%02d %02d:%02d:%02d.%09ld %s",
-		  date->year,
-		  date->month+1,
-		  date->mday,
-		  date->hour,
-		  date->minute,
-		  date->second,
-		  date->ns,
-		  cdc_describe_system(date->system));
-}
+/* Calendar time printing, without snprintf(): digits go out two at a
+ * time from a table. The output is exactly what 
+ * "%04d-%02d-%02d %02d:%02d:%02d.%09ld %s" would give, however odd 
+ * the fields.
+ */
 
-int cdc_calendar_parse(cdc_calendar_t *date,
-                       const char *buf,
-                       const int n)
+static const char s_digit_pairs[] = 
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+//! Longest thing cdc_calendar_format() can write: seven fields of up
+//! to 20 characters, punctuation and a system.
+#define FORMAT_MAX 192
+
+/** Write v as "%0<width>lld" would, returning the new end. */
+static char *format_int(char *p, int64_t v, int width)
 {
-    int rv;
-    int where = -1;
-    int year, month, mday, hour, minute, second;
-    long int ns;
-                                                   
-
-    rv = sscanf(buf, "%04d-%02d-%02d %02d:%02d:%02d.%09ld %n",
-                &year, &month, &mday, &hour, &minute, &second, &ns, 
-                &where);
-    // %n apparently either does or does not get reflected in the
-    // return value, depending on the whim of your C library
-    // implementation.
-    if (rv != 7 && rv != 8)
+  char tmp[24];
+  char *q = tmp + sizeof(tmp);
+  uint64_t u = (v < 0) ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+  int len;
+
+  while (u >= 100)
     {
-        return CDC_ERR_CANNOT_CONVERT;
+      q -= 2;
+      memcpy(q, &s_digit_pairs[(u % 100) * 2], 2);
+      u /= 100;
+    }
+  if (u >= 10) 
+    { 
+      q -= 2; 
+      memcpy(q, &s_digit_pairs[u * 2], 2); 
+    }
+  else 
+    { 
+      *--q = (char)('0' + u); 
     }
-    date->year = year;
-    date->month = month-1;
-    date->mday = mday;
-    date->hour = hour;
-    date->minute = minute;
-    date->second = second;
-    date->ns = ns;
-    // Right. Now then .. 
 
-    if (where < 0) 
-    {
-        return CDC_ERR_CANNOT_CONVERT;
+  len = (int)(tmp + sizeof(tmp) - q);
+  if (v < 0) 
+    { 
+      *p++ = '-'; 
+      --width; 
     }
-    rv = cdc_undescribe_system(&date->system, &buf[where]);
-    return rv;
+  for (; width > len; --width) { *p++ = '0'; }
+  memcpy(p, q, len);
+  return p + len;
 }
 
-int cdc_interval_sgn(const cdc_interval_t *a)
+/** A two digit field, then sep. */
+static char *format_2(char *p, int v, char sep)
 {
-  if (a->s > 0) { return 1; }
-  if (a->s < 0) { return -1; }
-  if (a->ns > 0) { return 1; }
-  if (a->ns < 0) { return -1; }
-  return 0;
+  if (v >= 0 && v < 100)
+    {
+      memcpy(p, &s_digit_pairs[v * 2], 2);
+      p += 2;
+    }
+  else
+    {
+      p = format_int(p, v, 2);
+    }
+  *p++ = sep;
+  return p;
 }
 
-
-const char *cdc_describe_system(const int sys)
+/** Describe sys into buf, which has room for CDC_DESCRIBE_SYSTEM_MAX 
+ *  characters. 
+ *
+ * @return The length of the description.
+ */
+static int describe_system(char *buf, int sys)
 {
-  static char buf[128];
+  const char *name;
   int system = sys;
-  const char *modifier = "";
+  int tainted = 0;
+  char *p = buf;
 
   if (system & CDC_SYSTEM_TAINTED)
     {
-      modifier = "*";
+      tainted = 1;
       system &= ~CDC_SYSTEM_TAINTED;
     }
 
-
   if (system >= CDC_SYSTEM_UTCPLUS_BASE && 
       system <= (CDC_SYSTEM_UTCPLUS_BASE + 1440))
     {
       int mins = UTCPLUS_SYSTEM_TO_MINUTES(system);
 
       // We describe 0 as '+' not '-' for convention's sake.
-      if (mins >= 0)
-	{
-	  sprintf(buf, "UTC+%02d%02d%s", (mins/60), (mins%60), modifier);
-	}
-      else
+      memcpy(p, "UTC", 3);
+      p[3] = (mins >= 0) ? '+' : '-';
+      if (mins < 0) { mins = -mins; }
+      memcpy(&p[4], &s_digit_pairs[(mins / 60) * 2], 2);
+      memcpy(&p[6], &s_digit_pairs[(mins % 60) * 2], 2);
+      p += 8;
+    }
+  else
+    {
+      size_t len;
+
+      switch (system)
 	{
-	  sprintf(buf, "UTC-%02d%02d%s", (-mins/60), (-mins)%60, modifier);
+	case CDC_SYSTEM_GREGORIAN_TAI:
+	  name = "TAI";
+	  break;
+	case CDC_SYSTEM_UTC:
+	  name = "UTC";
+	  break;
+	case CDC_SYSTEM_OFFSET:
+	  name = "OFF";
+	  break;
+	case CDC_SYSTEM_UKCT:
+	  name = "UK";
+	  break;
+	case (CDC_SYSTEM_REBASED & ~CDC_SYSTEM_TAINTED):
+	  name = "REBASED";
+	  break;
+	default:
+	  // No modifier for these.
+	  name = "UNKNOWN";
+	  tainted = 0;
+	  break;
 	}
-      return buf;
+      len = strlen(name);
+      memcpy(p, name, len);
+      p += len;
     }
-      
 
-  switch (system)
+  if (tainted) { *p++ = '*'; }
+  *p = '\0';
+  return (int)(p - buf);
+}
+
+int cdc_calendar_format(char *buf,
+			int n,
+			const cdc_calendar_t *date,
+			int flags)
+{
+  char tmp[FORMAT_MAX];
+  char *p = tmp;
+  int len;
+
+  if (date->year >= 0 && date->year < 10000)
     {
-    case CDC_SYSTEM_GREGORIAN_TAI:
-      sprintf(buf, "TAI%s",modifier);
-      break;
-    case CDC_SYSTEM_UTC:
-      sprintf(buf, "UTC%s", modifier);
-      break;
-    case CDC_SYSTEM_OFFSET:
-      sprintf(buf, "OFF%s", modifier);
-      break;
-    case CDC_SYSTEM_UKCT:
-      sprintf(buf, "UK%s", modifier);
-      break;
-    case (CDC_SYSTEM_REBASED & ~CDC_SYSTEM_TAINTED):
-      sprintf(buf, "REBASED%s", modifier);
-      break;
-    default:
-      return "UNKNOWN";
-      break;
+      memcpy(p, &s_digit_pairs[(date->year / 100) * 2], 2);
+      memcpy(p + 2, &s_digit_pairs[(date->year % 100) * 2], 2);
+      p += 4;
+    }
+  else
+    {
+      p = format_int(p, date->year, 4);
+    }
+  *p++ = '-';
+  // month + 1 can't overflow for printf either: it's done in int.
+  p = format_2(p, (int)((unsigned int)date->month + 1), '-');
+  p = format_2(p, date->mday, (flags & CDC_FORMAT_RFC3339) ? 'T' : ' ');
+  p = format_2(p, date->hour, ':');
+  p = format_2(p, date->minute, ':');
+  p = format_2(p, date->second, '.');
+
+  if (date->ns >= 0 && date->ns < ONE_BILLION)
+    {
+      long int ns = date->ns;
+
+      *p++ = (char)('0' + (ns / 100000000));
+      ns %= 100000000;
+      memcpy(p, &s_digit_pairs[(ns / 1000000) * 2], 2);
+      memcpy(p + 2, &s_digit_pairs[((ns / 10000) % 100) * 2], 2);
+      memcpy(p + 4, &s_digit_pairs[((ns / 100) % 100) * 2], 2);
+      memcpy(p + 6, &s_digit_pairs[(ns % 100) * 2], 2);
+      p += 8;
+    }
+  else
+    {
+      p = format_int(p, date->ns, 9);
     }
 
-  return buf;
+  if (flags & CDC_FORMAT_RFC3339)
+    {
+      int system = (int)date->system;
+
+      if (system == CDC_SYSTEM_UTC)
+	{
+	  *p++ = 'Z';
+	}
+      else if (system >= CDC_SYSTEM_UTCPLUS_BASE && 
+	       system <= (CDC_SYSTEM_UTCPLUS_BASE + 1440))
+	{
+	  int mins = UTCPLUS_SYSTEM_TO_MINUTES(system);
+
+	  *p++ = (mins >= 0) ? '+' : '-';
+	  if (mins < 0) { mins = -mins; }
+	  p = format_2(p, mins / 60, ':');
+	  memcpy(p, &s_digit_pairs[(mins % 60) * 2], 2);
+	  p += 2;
+	}
+      else
+	{
+	  // RFC 3339 only has offsets from UTC.
+	  return CDC_ERR_BAD_SYSTEM;
+	}
+    }
+  else
+    {
+      *p++ = ' ';
+      p += describe_system(p, (int)date->system);
+    }
+
+  len = (int)(p - tmp);
+  if (n > 0)
+    {
+      int out = (len < n) ? len : n - 1;
+
+      memcpy(buf, tmp, out);
+      buf[out] = '\0';
+    }
+  return len;
 }
 
-int cdc_undescribe_system(unsigned int *out, const char *in_sys)
+int cdc_calendar_sprintf(char *buf,
+			      int n,
+			      const cdc_calendar_t *date)
+{
+  return cdc_calendar_format(buf, n, date, 0);
+}
+
+/* Calendar time parsing. We take what cdc_calendar_sprintf() writes
+ * (which may have signed or over-wide fields if the time wasn't 
+ * normalised) and RFC 3339: 
+ *
+ *   [+-]YYYY-MM-DD(T| )hh:mm:ss[.fff..](Z|+hh:mm|-hh:mm| SYSTEM)
+ *
+ * A fraction with a sign is how cdc_calendar_sprintf() writes a 
+ * negative ns, and is read as a count of ns; otherwise it's a 
+ * decimal fraction of a second, and digits past the ninth are 
+ * dropped.
+ */
+
+//! Widest year cdc_calendar_sprintf() can write (INT_MIN).
+#define SCAN_YEAR_WIDTH 11
+
+// isdigit() and isspace() depend on the locale; we don't want to.
+#define SCAN_IS_DIGIT(c) ((unsigned char)((c) - '0') < 10)
+#define SCAN_IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/** Scan a signed decimal of at most width characters (sign 
+ *  included), as scanf("%<width>d") would.
+ */
+static int scan_int(const char **io_p, const char *end, int width, 
+		    int64_t *out)
+{
+  const char *p = *io_p;
+  const char *limit = (end - p > width) ? p + width : end;
+  int64_t v = 0;
+  int neg = 0;
+
+  if (p < limit && (*p == '-' || *p == '+')) 
+    { 
+      neg = (*p == '-');
+      ++p; 
+    }
+  if (p == limit || !SCAN_IS_DIGIT(*p)) 
+    { 
+      return CDC_ERR_CANNOT_CONVERT; 
+    }
+  while (p < limit && SCAN_IS_DIGIT(*p))
+    {
+      v = (v * 10) + (*p - '0');
+      ++p;
+    }
+
+  (*out) = neg ? -v : v;
+  (*io_p) = p;
+  return 0;
+}
+
+/** Scan an int field and the separator after it (if sep isn't 0) */
+static int scan_field(const char **io_p, const char *end, int width, 
+		      char sep, int *out)
+{
+  int64_t v;
+  int rv;
+
+  rv = scan_int(io_p, end, width, &v);
+  if (rv) { return rv; }
+  if (v < INT_MIN || v > INT_MAX) { return CDC_ERR_CANNOT_CONVERT; }
+
+  if (sep)
+    {
+      if ((*io_p) == end || **io_p != sep) { return CDC_ERR_CANNOT_CONVERT; }
+      ++(*io_p);
+    }
+  (*out) = (int)v;
+  return 0;
+}
+
+/** Scan the fraction after the '.' */
+static int scan_fraction(const char **io_p, const char *end, long int *ns)
+{
+  const char *p = *io_p;
+  long int v = 0;
+  int digits = 0;
+
+  if (p < end && *p == '-')
+    {
+      // %09ld of a negative ns.
+      int64_t sv;
+      int rv = scan_int(io_p, end, 9, &sv);
+
+      (*ns) = (long int)sv;
+      return rv;
+    }
+
+  while (p < end && SCAN_IS_DIGIT(*p))
+    {
+      if (digits < 9) 
+	{
+	  v = (v * 10) + (*p - '0');
+	  ++digits;
+	}
+      ++p;
+    }
+  if (p == *io_p) { return CDC_ERR_CANNOT_CONVERT; }
+
+  for (; digits < 9; ++digits) { v *= 10; }
+  (*ns) = v;
+  (*io_p) = p;
+  return 0;
+}
+
+/** Scan hhmm or hh:mm into a UTC-plus system */
+static int scan_utcplus(const char **io_p, const char *end, int neg,
+			unsigned int *out_sys)
 {
-    int tainted = 0;
-    int out_sys = 0;
+  int hrs, mins;
+  int rv;
 
-    // Find out where in_sys ends.
-    const char *sys_endp = in_sys;
-    while (*sys_endp != '\0' && 
-           !isspace(*sys_endp)) 
+  if (end - (*io_p) < 2 || !SCAN_IS_DIGIT((*io_p)[0]) ||
+      !SCAN_IS_DIGIT((*io_p)[1]))
     {
-        ++sys_endp;
+      return CDC_ERR_BAD_SYSTEM;
     }
-    if (sys_endp == in_sys) { return CDC_ERR_BAD_SYSTEM; }
-    if (sys_endp[-1] == '*')
+  rv = scan_field(io_p, end, 2, 0, &hrs);
+  if (rv) { return CDC_ERR_BAD_SYSTEM; }
+  if ((*io_p) < end && **io_p == ':') { ++(*io_p); }
+  if (end - (*io_p) < 2 || !SCAN_IS_DIGIT((*io_p)[0]) ||
+      !SCAN_IS_DIGIT((*io_p)[1]))
     {
-        // A modifier!
-        ++tainted;
+      return CDC_ERR_BAD_SYSTEM;
     }
-        
-    if (!strncmp(in_sys, "TAI", 3))
+  rv = scan_field(io_p, end, 2, 0, &mins);
+  if (rv) { return CDC_ERR_BAD_SYSTEM; }
+
+  mins += hrs * 60;
+  if (mins > 720) { return CDC_ERR_BAD_SYSTEM; }
+
+  (*out_sys) = CDC_SYSTEM_UTCPLUS_ZERO + (neg ? -mins : mins);
+  return 0;
+}
+
+/** The system named by the len characters at tok, as described by 
+ *  cdc_describe_system().
+ */
+static int system_from_token(unsigned int *out, const char *tok, 
+			     size_t len)
+{
+  static const struct 
+  {
+    const char *name;
+    size_t len;
+    unsigned int system;
+  } names[] = 
+      {
+	{ "TAI", 3, CDC_SYSTEM_GREGORIAN_TAI },
+	{ "UTC", 3, CDC_SYSTEM_UTC },
+	{ "UK", 2, CDC_SYSTEM_UKCT },
+	{ "OFF", 3, CDC_SYSTEM_OFFSET },
+	{ "REBASED", 7, CDC_SYSTEM_REBASED & ~CDC_SYSTEM_TAINTED },
+	{ "UNK", 3, CDC_SYSTEM_UNKNOWN },
+	{ "UNKNOWN", 7, CDC_SYSTEM_UNKNOWN },
+      };
+  unsigned int out_sys = 0;
+  int tainted = 0;
+  size_t i;
+
+  if (len && tok[len - 1] == '*')
     {
-        out_sys = CDC_SYSTEM_GREGORIAN_TAI;
+      // A modifier!
+      ++tainted;
+      --len;
     }
-    else if (!strncmp(in_sys, "UTC+", 4) || !strncmp(in_sys, "UTC-", 4))
+  if (!len) { return CDC_ERR_BAD_SYSTEM; }
+
+  if (len > 3 && !memcmp(tok, "UTC", 3) && (tok[3] == '+' || tok[3] == '-'))
     {
-        int rv;
-        int hrs, mins;
-        int mul = (in_sys[3] == '-' ? -1 : 1);
-        rv = sscanf(&in_sys[4], "%02d%02d", &hrs, &mins);
+      const char *p = tok + 4;
+      int rv;
 
-        if (rv != 2) { return CDC_ERR_BAD_SYSTEM; }
-        out_sys =(CDC_SYSTEM_UTCPLUS_ZERO + 
-             (mul * ((hrs * 60) + mins)));
+      rv = scan_utcplus(&p, tok + len, (tok[3] == '-'), &out_sys);
+      if (rv) { return rv; }
+      if (p != tok + len) { return CDC_ERR_BAD_SYSTEM; }
+    }
+  else
+    {
+      for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+	{
+	  if (names[i].len == len && !memcmp(tok, names[i].name, len))
+	    {
+	      break;
+	    }
+	}
+      if (i == sizeof(names) / sizeof(names[0])) { return CDC_ERR_BAD_SYSTEM; }
+      out_sys = names[i].system;
     }
-    else if (!strncmp(in_sys, "UTC", 3))
+
+  if (tainted) { out_sys |= CDC_SYSTEM_TAINTED; }
+  (*out) = out_sys;
+  return 0;
+}
+
+/** Scan what follows the time: Z, +hh:mm or a space and a system. */
+static int scan_zone(const char **io_p, const char *end, 
+		     unsigned int *out_sys)
+{
+  const char *p = *io_p;
+  int rv;
+
+  if (p == end) { return CDC_ERR_BAD_SYSTEM; }
+  if (*p == 'Z' || *p == 'z')
     {
-        out_sys = CDC_SYSTEM_UTC;
+      (*out_sys) = CDC_SYSTEM_UTC;
+      ++p;
     }
-    else if (!strncmp(in_sys, "UK", 3))
+  else if (*p == '+' || *p == '-')
     {
-        out_sys = CDC_SYSTEM_UKCT;
+      int neg = (*p == '-');
+
+      ++p;
+      rv = scan_utcplus(&p, end, neg, out_sys);
+      if (rv) { return rv; }
+      // RFC 3339: -00:00 is UTC, with the local offset unknown.
+      if (neg && (*out_sys) == CDC_SYSTEM_UTCPLUS_ZERO) 
+	{
+	  (*out_sys) = CDC_SYSTEM_UTC;
+	}
     }
-    else if (!strncmp(in_sys, "UNK", 3) || !strncmp(in_sys, "UNKNOWN", 7))
+  else if (SCAN_IS_SPACE(*p))
     {
-        out_sys = CDC_SYSTEM_UNKNOWN;
+      const char *tok;
+
+      while (p < end && SCAN_IS_SPACE(*p)) { ++p; }
+      tok = p;
+      while (p < end && !SCAN_IS_SPACE(*p)) { ++p; }
+
+      rv = system_from_token(out_sys, tok, p - tok);
+      if (rv) { return rv; }
     }
-    else
+  else
     {
-        return CDC_ERR_BAD_SYSTEM;
+      return CDC_ERR_CANNOT_CONVERT;
     }
 
-    if (tainted) { out_sys |= CDC_SYSTEM_TAINTED; }
-    (*out) = out_sys;
-    return 0;
+  (*io_p) = p;
+  return 0;
+}
+
+int cdc_calendar_scan(cdc_calendar_t *date,
+		      const char *buf,
+		      int n,
+		      int *consumed)
+{
+  const char *p = buf;
+  const char *end;
+  const char *nul;
+  cdc_calendar_t cal;
+  int64_t year;
+  int rv;
+
+  if (n < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+  nul = (const char *)memchr(buf, '\0', n);
+  end = nul ? nul : buf + n;
+
+  memset(&cal, '\0', sizeof(cdc_calendar_t));
+  while (p < end && SCAN_IS_SPACE(*p)) { ++p; }
+
+  rv = scan_int(&p, end, SCAN_YEAR_WIDTH, &year);
+  if (rv) { return rv; }
+  if (year < INT_MIN || year > INT_MAX) { return CDC_ERR_CANNOT_CONVERT; }
+  cal.year = (int)year;
+  if (p == end || *p != '-') { return CDC_ERR_CANNOT_CONVERT; }
+  ++p;
+
+  rv = scan_field(&p, end, 2, '-', &cal.month);
+  if (!rv) { rv = scan_field(&p, end, 2, 0, &cal.mday); }
+  if (rv) { return rv; }
+  --cal.month;
+
+  if (p == end || (*p != ' ' && *p != 'T' && *p != 't')) 
+    { 
+      return CDC_ERR_CANNOT_CONVERT; 
+    }
+  ++p;
+
+  rv = scan_field(&p, end, 2, ':', &cal.hour);
+  if (!rv) { rv = scan_field(&p, end, 2, ':', &cal.minute); }
+  if (!rv) { rv = scan_field(&p, end, 2, 0, &cal.second); }
+  if (rv) { return rv; }
+
+  if (p < end && (*p == '.' || *p == ','))
+    {
+      ++p;
+      rv = scan_fraction(&p, end, &cal.ns);
+      if (rv) { return rv; }
+    }
+
+  rv = scan_zone(&p, end, &cal.system);
+  if (rv) { return rv; }
+
+  memcpy(date, &cal, sizeof(cdc_calendar_t));
+  if (consumed) { (*consumed) = (int)(p - buf); }
+  return 0;
+}
+
+int cdc_calendar_parse(cdc_calendar_t *date,
+                       const char *buf,
+                       const int n)
+{
+  return cdc_calendar_scan(date, buf, n, NULL);
+}
+
+int cdc_interval_sgn(const cdc_interval_t *a)
+{
+  if (a->s > 0) { return 1; }
+  if (a->s < 0) { return -1; }
+  if (a->ns > 0) { return 1; }
+  if (a->ns < 0) { return -1; }
+  return 0;
+}
+
+
+#if defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+// No thread-local storage: use cdc_describe_system_r() if you have
+// threads.
+#define THREAD_LOCAL
+#endif
+
+const char *cdc_describe_system(const int sys)
+{
+  static THREAD_LOCAL char buf[CDC_DESCRIBE_SYSTEM_MAX];
+
+  describe_system(buf, sys);
+  return buf;
+}
+
+int cdc_describe_system_r(char *buf, int n, const int sys)
+{
+  char tmp[CDC_DESCRIBE_SYSTEM_MAX];
+  int len = describe_system(tmp, sys);
+
+  if (n > 0)
+    {
+      int out = (len < n) ? len : n - 1;
+
+      memcpy(buf, tmp, out);
+      buf[out] = '\0';
+    }
+  return len;
+}
+
+int cdc_undescribe_system(unsigned int *out, const char *in_sys)
+{
+  // Find out where in_sys ends.
+  const char *sys_endp = in_sys;
+
+  while (*sys_endp != '\0' && !SCAN_IS_SPACE(*sys_endp)) 
+    {
+      ++sys_endp;
+    }
+  return system_from_token(out, in_sys, sys_endp - in_sys);
 }
 
 
@@ -1073,6 +1895,17 @@ int cdc_zone_raise(cdc_zone_t *zone,
   return 0;
 }
 
+int cdc_zone_span(cdc_zone_t *zone,
+		  const cdc_calendar_t *cal,
+		  cdc_calendar_t *start,
+		  cdc_calendar_t *end,
+		  cdc_calendar_t *offset)
+{
+  // Zones built before span() existed won't have one.
+  if (!zone->span) { return CDC_ERR_NOT_MY_SYSTEM; }
+  return zone->span(zone, cal, start, end, offset);
+}
+
 int cdc_zone_lower_to(cdc_zone_t *zone,
 			   cdc_calendar_t *dest,
 			   cdc_zone_t **lower,
@@ -1205,1437 +2038,4780 @@ int cdc_zone_lower(cdc_zone_t *zone,
 
 
 
-/* -------------------- Generic NULL functions -------- */
-static int null_init(struct cdc_zone_struct *self, int arg_i, void *arg_n)
+/* -------------------- Batches ----------------------- */
+
+//! Longest zone chain we'll resolve for a batch. Longer ones are 
+//! converted one element at a time.
+#define ZONE_CHAIN_MAX 16
+
+/** A zone and everything under it, found once per batch rather than
+ *  once per element.
+ */
+typedef struct zone_chain_struct
 {
-  return 0;
+  //! Number of zones in the chain.
+  int nr_zones;
+
+  //! zones[0] is the top; zones[i+1] is the lower zone of zones[i].
+  cdc_zone_t *zones[ZONE_CHAIN_MAX];
+
+} zone_chain_t;
+
+/** Where the last of a run of conversions was in the leap second 
+ *  table and the BST calendar, so that the next one can start there 
+ *  and only needs to look further if it's crossed a boundary. 
+ */
+typedef struct zone_cursor_struct
+{
+  //! As for utc_index_search_utc().
+  int leap;
+
+  //! The year whose last Sundays in March and October we have, if 
+  //! bst_march is not 0.
+  int bst_year;
+  int bst_march, bst_october;
+
+} zone_cursor_t;
+
+static int utc_offset(struct cdc_zone_struct *self,
+		      cdc_calendar_t *dest,
+		      const cdc_calendar_t *src,
+		      int *cursor);
+static int utc_op(struct cdc_zone_struct *self,
+		  cdc_calendar_t *dest,
+		  const cdc_calendar_t *src,
+		  const cdc_calendar_t *offset,
+		  int op,
+		  int *cursor);
+static int utcplus_op(struct cdc_zone_struct *self,
+		      cdc_calendar_t *dest,
+		      const cdc_calendar_t *src,
+		      const cdc_calendar_t *offset,
+		      int op,
+		      zone_cursor_t *zc);
+static int ukct_offset(struct cdc_zone_struct *self,
+		       cdc_calendar_t *offset,
+		       const cdc_calendar_t *src,
+		       zone_cursor_t *zc);
+static int ukct_op(struct cdc_zone_struct *self,
+		   cdc_calendar_t *dest,
+		   const cdc_calendar_t *src,
+		   const cdc_calendar_t *offset,
+		   int op,
+		   zone_cursor_t *zc);
+
+/** z->offset(), using (and updating) zc, which may be NULL, for the 
+ *  zones that know how. 
+ */
+static int zone_cursor_offset(cdc_zone_t *z, 
+			      cdc_calendar_t *offset,
+			      const cdc_calendar_t *src,
+			      zone_cursor_t *zc)
+{
+  if (zc && z->offset == system_utc_offset)
+    {
+      return utc_offset(z, offset, src, &zc->leap);
+    }
+  if (zc && z->offset == system_ukct_offset)
+    {
+      return ukct_offset(z, offset, src, zc);
+    }
+  return z->offset(z, offset, src);
 }
 
-static int null_dispose(struct cdc_zone_struct *self)
+/** z->op(), using (and updating) zc, which may be NULL, for the zones
+ *  that know how.
+ */
+static int zone_cursor_op(cdc_zone_t *z,
+			  cdc_calendar_t *dest,
+			  const cdc_calendar_t *src,
+			  const cdc_calendar_t *offset,
+			  int op,
+			  zone_cursor_t *zc)
 {
-  return 0;
+  if (zc && z->op == system_utc_op)
+    {
+      return utc_op(z, dest, src, offset, op, &zc->leap);
+    }
+  if (zc && z->op == system_ukct_op)
+    {
+      return ukct_op(z, dest, src, offset, op, zc);
+    }
+  if (zc && z->op == system_utcplus_op)
+    {
+      return utcplus_op(z, dest, src, offset, op, zc);
+    }
+  return z->op(z, dest, src, offset, op);
 }
 
-static int chain_dispose(struct cdc_zone_struct *self)
+static int zone_chain_resolve(zone_chain_t *chain, cdc_zone_t *zone)
 {
-  cdc_zone_t *z = (cdc_zone_t *)self->handle;
-  int rv;
+  chain->nr_zones = 0;
+  while (zone)
+    {
+      cdc_zone_t *low = NULL;
+      int rv;
 
-  rv = z->dispose(z);
-  free(z);
-  return rv;
+      if (chain->nr_zones == ZONE_CHAIN_MAX) 
+	{
+	  return CDC_ERR_INVALID_ARGUMENT;
+	}
+      chain->zones[chain->nr_zones++] = zone;
+
+      rv = zone->lower_zone(zone, &low);
+      if (rv) { return rv; }
+      zone = low;
+    }
+  return 0;
 }
 
-static int system_lower_diff(struct cdc_zone_struct *self,
-			     cdc_interval_t *ivalp,
-			     const cdc_calendar_t *before,
-			     const cdc_calendar_t *after)
+/** cdc_zone_raise() on a resolved chain. 
+ *
+ * @return 0 on success, CDC_ERR_NOT_MY_SYSTEM if src isn't from a
+ *          zone in the chain (which would send cdc_zone_raise() into
+ *          an infinite recursion), or whatever cdc_zone_raise() gives
+ *          for anything else that goes wrong.
+ */
+static int chain_raise(const zone_chain_t *chain,
+		       cdc_zone_t *zone,
+		       cdc_calendar_t *dest,
+		       const cdc_calendar_t *src,
+		       zone_cursor_t *zc)
 {
-  cdc_calendar_t bl, al;
-  cdc_zone_t *z;
+  cdc_calendar_t cur, offset;
+  int i, j;
   int rv;
 
+  // cdc_zone_raise() recurses until it finds a zone whose lower zone 
+  // (or, at the bottom, itself) src belongs to, then raises back up.
+  for (j = 0; j < chain->nr_zones; ++j)
+    {
+      const cdc_zone_t *low = 
+	chain->zones[(j + 1 < chain->nr_zones) ? j + 1 : j];
+      if (low->system == src->system) { break; }
+    }
+  if (j == chain->nr_zones) { return CDC_ERR_NOT_MY_SYSTEM; }
 
-  rv = cdc_zone_lower(self, &bl, &z, before);
-  if (rv) { return rv; }
+  memcpy(&cur, src, sizeof(cdc_calendar_t));
+  for (i = j; i >= 0; --i)
+    {
+      cdc_zone_t *z = chain->zones[i];
+      cdc_calendar_t tmp;
 
-  rv = cdc_zone_lower(self, &al, &z, after);
-  if (rv) { return rv; }
+      rv = zone_cursor_offset(z, &offset, &cur, zc);
+      if (!rv)
+	{
+	  cur.system = z->system;
+	  rv = zone_cursor_op(z, &tmp, &cur, &offset, CDC_OP_ZONE_ADD, zc);
+	}
+      if (rv) 
+	{
+	  // cdc_zone_raise() retries some failures in other ways; let
+	  // it decide.
+	  return cdc_zone_raise(zone, dest, src);
+	}
+      memcpy(&cur, &tmp, sizeof(cdc_calendar_t));
+      cur.system = z->system;
+    }
 
-#if DEBUG_LOWER
-  printf("system_lower_diff[] before = %s \n", dbg_pdate(before));
-  printf("system_lower_diff[] bl     = %s \n", dbg_pdate(&bl));
+  memcpy(dest, &cur, sizeof(cdc_calendar_t));
+  return 0;
+}
 
-  printf("system_lower_diff[] after   = %s \n", dbg_pdate(after));
-  printf("system_lower_diff[] al     = %s \n", dbg_pdate(&al));
-#endif
-
-  return z->diff(z, ivalp, &bl, &al);
-}
-
-
-/* -------------------- Gregorian TAI ---------------- */
-
-static int system_gtai_diff(struct cdc_zone_struct *self,
-			    cdc_interval_t *ivalp,
-			    const cdc_calendar_t *before,
-			    const cdc_calendar_t *after)
+/** Lower cur from z to l in place, as cdc_zone_lower(). zc may be NULL. */
+static int chain_lower_one(cdc_zone_t *z, cdc_zone_t *l, cdc_calendar_t *cur,
+			   zone_cursor_t *zc)
 {
-  /** @todo
-   *  
-   *  We're using the conventional 'spinning counter' algorithm
-   *  here. This is gratuitously terrible.
-   *
-   */
-
-#if DEBUG_GTAI
-  printf("---gtai_diff()\n");
-#endif
+  cdc_calendar_t offset;
+  int rv;
 
+  rv = zone_cursor_offset(z, &offset, cur, zc);
+  if (rv) { return rv; }
 
-  if (before->system != after->system) { return CDC_ERR_SYSTEMS_DO_NOT_MATCH; }
-  if (before->system != CDC_SYSTEM_GREGORIAN_TAI) 
-    {
-      return CDC_ERR_NOT_MY_SYSTEM;
-    }
+  cur->system = l->system;
+  cdc_negate(&offset);
+  return zone_cursor_op(l, cur, cur, &offset, CDC_OP_ZONE_ADD, zc);
+}
 
-  if (before->month < 0 || before->month > 12)
-  {
-      return CDC_ERR_INVALID_ARGUMENT;
-  }
-      
+/** cdc_zone_lower_to() on a resolved chain. */
+static int chain_lower_to(const zone_chain_t *chain,
+			  cdc_calendar_t *dest,
+			  cdc_zone_t **lower,
+			  const cdc_calendar_t *src,
+			  int to_system,
+			  zone_cursor_t *zc)
+{
+  cdc_calendar_t cur;
+  int i = 0;
 
-  if (cdc_calendar_cmp(before, after) > 0)
+  memcpy(&cur, src, sizeof(cdc_calendar_t));
+  while (cur.system != (unsigned int)to_system)
     {
-      int rv;
-      rv =  system_gtai_diff(self, ivalp, after, before);
-      if (rv) { return rv; }
-      ivalp->s = -ivalp->s;
-      ivalp->ns = -ivalp->ns;
+      if (i + 1 == chain->nr_zones)
+	{
+	  if (to_system == -1) { break; }
+	  return CDC_ERR_CANNOT_CONVERT;
+	}
 
-      return rv;
+      if (cur.system == chain->zones[i]->system)
+	{
+	  int rv = chain_lower_one(chain->zones[i], chain->zones[i + 1], 
+				   &cur, zc);
+	  if (rv) { return rv; }
+	}
+      ++i;
     }
 
-  // Bring the interval onto the stack for manipulation
-  // (also helps gcc to optimise this code)
-  
-  cdc_interval_t ival;
-  memcpy(&ival, ivalp, sizeof(cdc_interval_t));
-
-
-#if DEBUG_GTAI
-  printf("init: s = %"PRIu64" ns = %ld \n", 
-	 ival.s, ival.ns);
-#endif
+  memcpy(dest, &cur, sizeof(cdc_calendar_t));
+  if (lower) { (*lower) = chain->zones[i]; }
+  return 0;
+}
 
-  {
-    int cur = before->month;
-    int curday = before->mday;
-    int last = after->month;
-    int lastday = after->mday;
-    int is_leap = is_gregorian_leap_year(before->year);
-    int curyear = before->year;
-    int lastyear = after->year;
-
-    /*
-    curdays = gregorian_months[cur] + 
-      ((is_leap && cur == CDC_FEBRUARY) ? 1 : 0);
-     */
-
-    while (1)
-      {
+static int utc_to_instant(cdc_instant_t *out,
+			  const cdc_calendar_t *src,
+			  int *cursor);
 
-#if DEBUG_GTAI
-          printf("-> d cur = %d curday = %d [ y = %d, leap = %d ]\n", cur, curday, curyear, is_leap);
-#endif
+//! Years beyond which utc_to_instant() might overflow where lowering 
+//! wouldn't (or vice versa).
+#define BATCH_YEAR_MAX (1 << 30)
 
-	// Advance by a day each time, until we hit 'after'.
-	if (cur == last && curday == lastday && curyear == lastyear) 
-	  {
-	    // There!
-	    break;
-	  }
+/** cdc_zone_to_instant() on a resolved chain. When we get to UTC, we
+ *  go straight to an instant using the leap table cursor.
+ */
+static int chain_to_instant(const zone_chain_t *chain,
+			    cdc_instant_t *out,
+			    const cdc_calendar_t *src,
+			    zone_cursor_t *zc)
+{
+  cdc_calendar_t cur;
+  int i = 0;
 
-	// Otherwise .. 
-	ival.s += SECONDS_PER_DAY;
-	++curday;
+  memcpy(&cur, src, sizeof(cdc_calendar_t));
+  while (cur.system != CDC_SYSTEM_GREGORIAN_TAI)
+    {
+      if (i + 1 == chain->nr_zones) { return CDC_ERR_CANNOT_CONVERT; }
 
+      if (cur.system == chain->zones[i]->system)
 	{
-	  int daysin = gregorian_months[cur] + 
-	    ((is_leap && cur == CDC_FEBRUARY) ? 1 : 0);
-
-	  if (curday > daysin)
-	  {
-	    curday = 1;
-	    ++cur;
-	  }
-	}
+	  cdc_zone_t *z = chain->zones[i];
+	  cdc_zone_t *l = chain->zones[i + 1];
+	  int rv;
 
-	{
-	  if (cur >= 12)
+	  if (z->offset == system_utc_offset && l->op == system_gtai_op &&
+	      l->system == CDC_SYSTEM_GREGORIAN_TAI &&
+	      cur.year > -BATCH_YEAR_MAX && cur.year < BATCH_YEAR_MAX)
 	    {
-	      cur = 0;
-	      ++curyear;
-              is_leap = is_gregorian_leap_year(curyear);
+	      return utc_to_instant(out, &cur, &zc->leap);
 	    }
-	}	      
-      }
-  }
-
-#if DEBUG_GTAI
-  printf("ival.s = %"PRIu64"\n", ival.s);
-#endif
 
-  {
-    int hrdiff = after->hour - before->hour;
+	  rv = chain_lower_one(z, l, &cur, zc);
+	  if (rv) { return rv; }
+	}
+      ++i;
+    }
 
-#if DEBUG_GTAI
-    printf("hrdiff = %d \n", hrdiff);
-#endif
+  instant_from_tai(out, &cur);
+  return 0;
+}
 
-    ival.s += SECONDS_PER_HOUR * hrdiff;
+/** Record the result of converting element i of a batch. */
+#define BATCH_RESULT(rv, errs, i, first_rv)		\
+  {							\
+    if (errs) { (errs)[i] = (rv); }			\
+    if ((rv) && !(first_rv)) { (first_rv) = (rv); }	\
   }
 
-  {
-    int mdiff = after->minute - before->minute;
-
-#if DEBUG_GTAI
-    printf("mdiff = %d \n", mdiff);
-#endif
-
-    ival.s += SECONDS_PER_MINUTE *mdiff;
-  }
-#if DEBUG_GTAI
-  printf("sdiff = %d \n", (after->second -before->second));
-#endif
+int cdc_zone_raise_batch(cdc_zone_t *zone,
+			 cdc_calendar_t *dest,
+			 const cdc_calendar_t *src,
+			 int n,
+			 int *errs)
+{
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-  ival.s += (after->second - before->second);
-  ival.ns = (after->ns - before->ns);
-  if (ival.ns < 0)
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  for (i = 0; i < n; ++i)
     {
-      --ival.s;
-      ival.ns += ONE_BILLION;
+      int rv = resolved ? chain_raise(&chain, zone, &dest[i], &src[i], &zc) :
+	cdc_zone_raise(zone, &dest[i], &src[i]);
+      BATCH_RESULT(rv, errs, i, first_rv);
     }
-  
-  memcpy(ivalp, &ival, sizeof(cdc_interval_t));
-#if DEBUG_GTAI
-  printf("---end gtai_diff()\n");
-#endif
+  return first_rv;
+}
 
+int cdc_zone_lower_to_batch(cdc_zone_t *zone,
+			    cdc_calendar_t *dest,
+			    cdc_zone_t **lzone,
+			    const cdc_calendar_t *src,
+			    int n,
+			    int to_system,
+			    int *errs)
+{
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-  return 0;
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  for (i = 0; i < n; ++i)
+    {
+      cdc_zone_t *l;
+      int rv = resolved ? 
+	chain_lower_to(&chain, &dest[i], &l, &src[i], to_system, &zc) :
+	cdc_zone_lower_to(zone, &dest[i], &l, &src[i], to_system);
+      if (lzone) { lzone[i] = rv ? NULL : l; }
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
 }
 
-
-static int system_gtai_offset(struct cdc_zone_struct *self,
-				  cdc_calendar_t *offset,
-			      const cdc_calendar_t *src)
+int cdc_bounce_batch(cdc_zone_t *down_zone,
+		     cdc_zone_t *up_zone,
+		     cdc_calendar_t *dst,
+		     const cdc_calendar_t *src,
+		     int n,
+		     int *errs)
 {
-  // Particularly easy ..
-  memset(offset, '\0', sizeof(cdc_calendar_t));
+  zone_chain_t down, up;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-  return 0;
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&down, down_zone) && 
+    !zone_chain_resolve(&up, up_zone);
+  for (i = 0; i < n; ++i)
+    {
+      int rv;
+
+      if (resolved)
+	{
+	  cdc_calendar_t tmp;
+
+	  rv = chain_lower_to(&down, &tmp, NULL, &src[i], -1, &zc);
+	  if (!rv) { rv = chain_raise(&up, up_zone, &dst[i], &tmp, &zc); }
+	}
+      else
+	{
+	  rv = cdc_bounce(down_zone, up_zone, &dst[i], &src[i]);
+	}
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
 }
 
-static int system_gtai_op(struct cdc_zone_struct *self,
-			  cdc_calendar_t *dest,
-			  const cdc_calendar_t *src,
-			  const cdc_calendar_t *offset,
-			  int op)
+int cdc_diff_batch(cdc_zone_t *z,
+		   cdc_interval_t *result,
+		   const cdc_calendar_t *before,
+		   const cdc_calendar_t *after,
+		   int n,
+		   int flags,
+		   int *errs)
 {
-  // And normalise .
-  int done = 0;
-  int rv;
-
-  rv = cdc_simple_op(dest, src, offset, op);
-#if DEBUG_GTAI
-  printf("gtai_op: src                        = %s\n", dbg_pdate(src));
-  printf("gtai_op: offset                     = %s\n", dbg_pdate(offset));
-  printf("gtai_op: cdc_simple_op returns = %s\n", dbg_pdate(dest));
-#endif
+  zone_chain_t chain;
+  cdc_calendar_t fixed_before, fixed_after;
+  cdc_instant_t before_when, after_when;
+  int before_rv = 0, after_rv = 0;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int linear;
+  int i;
 
-  if (rv) { return rv; }
+  if (n <= 0) { return 0; }
+  memset(&zc, '\0', sizeof(zone_cursor_t));
 
-  // Convert any negatives to positives ..
-  while (dest->ns < 0)
+  // Take copies, in case result overlaps them.
+  if (flags & CDC_BATCH_FIXED_A)
     {
-      --dest->second;
-      dest->ns += ONE_BILLION;
+      memcpy(&fixed_before, before, sizeof(cdc_calendar_t));
+      before = &fixed_before;
     }
-  while (dest->second < 0)
+  if (flags & CDC_BATCH_FIXED_B)
     {
-      --dest->minute;
-      dest->second += SECONDS_PER_MINUTE;
+      memcpy(&fixed_after, after, sizeof(cdc_calendar_t));
+      after = &fixed_after;
     }
 
-  while (dest->minute < 0)
-    {
-      --dest->hour;
-      dest->minute += MINUTES_PER_HOUR;
-    }
+  linear = zone_has_linear_diff(z) && !zone_chain_resolve(&chain, z);
 
-  while (dest->hour < 0)
+  // Fixed operands only need converting once.
+  if (linear && (flags & CDC_BATCH_FIXED_A) && before->system == z->system)
     {
-      --dest->mday;
-      dest->hour += HOURS_PER_DAY;
+      before_rv = chain_to_instant(&chain, &before_when, before, &zc);
     }
-
-  while (dest->month < 0)
+  if (linear && (flags & CDC_BATCH_FIXED_B) && after->system == z->system)
     {
-      --dest->year;
-      dest->month += 12;
+      after_rv = chain_to_instant(&chain, &after_when, after, &zc);
     }
-  
-  while (dest->mday < 1)
+
+  for (i = 0; i < n; ++i)
     {
-      // Actually in the previous month. Ugh.
-      --dest->month;
-      if (dest->month < 0)
+      const cdc_calendar_t *b = (flags & CDC_BATCH_FIXED_A) ? before : &before[i];
+      const cdc_calendar_t *a = (flags & CDC_BATCH_FIXED_B) ? after : &after[i];
+      int rv;
+
+      if (linear && b->system == z->system && a->system == z->system)
 	{
-	  --dest->year;
-	  dest->month += 12;
+	  cdc_instant_t bw, aw;
+
+	  // As cdc_diff().
+	  memset(&result[i], '\0', sizeof(cdc_interval_t));
+	  if (z->diff == system_gtai_diff && !diff_months_valid(b, a))
+	    {
+	      rv = CDC_ERR_INVALID_ARGUMENT;
+	    }
+	  else
+	    {
+	      if (flags & CDC_BATCH_FIXED_A)
+		{
+		  rv = before_rv;
+		  memcpy(&bw, &before_when, sizeof(cdc_instant_t));
+		}
+	      else
+		{
+		  rv = chain_to_instant(&chain, &bw, b, &zc);
+		}
+	      
+	      if (!rv && (flags & CDC_BATCH_FIXED_B))
+		{
+		  rv = after_rv;
+		  memcpy(&aw, &after_when, sizeof(cdc_instant_t));
+		}
+	      else if (!rv)
+		{
+		  rv = chain_to_instant(&chain, &aw, a, &zc);
+		}
+
+	      if (!rv) { rv = cdc_instant_diff(&result[i], &bw, &aw); }
+	    }
 	}
-      
-      dest->mday += (gregorian_months[dest->month]);
-      if (dest->month == 1 &&
-	  is_gregorian_leap_year(dest->year))
+      else
 	{
-	  ++dest->mday; // Leap year correction
+	  rv = cdc_diff(z, &result[i], b, a);
 	}
+      BATCH_RESULT(rv, errs, i, first_rv);
     }
-  
-  // We can do the time independently of date.
-  dest->second += (dest->ns / ONE_BILLION);
-  dest->ns = (dest->ns % ONE_BILLION);
-
-  dest->minute += (dest->second / SECONDS_PER_MINUTE);
-  dest->second = (dest->second % SECONDS_PER_MINUTE);
+  return first_rv;
+}
 
-  dest->hour += (dest->minute / MINUTES_PER_HOUR);
-  dest->minute = (dest->minute % MINUTES_PER_HOUR);
+int cdc_zone_add_batch(cdc_zone_t *zone,
+		       cdc_calendar_t *out,
+		       const cdc_calendar_t *date,
+		       const cdc_interval_t *ival,
+		       int n,
+		       int flags,
+		       int *errs)
+{
+  cdc_calendar_t fixed_date;
+  cdc_interval_t fixed_ival;
+  cdc_instant_t fixed_when;
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int fixed_rv = 0;
+  int first_rv = 0;
+  int linear, resolved;
+  int i;
 
-#if DEBUG_GTAI
-  printf("gtai_op: dest before mday  =            %s\n",dbg_pdate(dest));
-#endif
+  if (n <= 0) { return 0; }
 
+  // Take copies, in case out overlaps them.
+  if (flags & CDC_BATCH_FIXED_A)
+    {
+      memcpy(&fixed_date, date, sizeof(cdc_calendar_t));
+      date = &fixed_date;
+    }
+  if (flags & CDC_BATCH_FIXED_B)
+    {
+      memcpy(&fixed_ival, ival, sizeof(cdc_interval_t));
+      ival = &fixed_ival;
+    }
 
-  dest->mday += (dest->hour / HOURS_PER_DAY);
-  dest->hour = (dest->hour % HOURS_PER_DAY);
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  linear = resolved && zone_has_linear_op(zone);
 
-#if DEBUG_GTAI
-  printf("gtai_op: dest after mday  =            %s\n",dbg_pdate(dest));
-#endif
+  if (linear && (flags & CDC_BATCH_FIXED_A) && date->system == zone->system)
+    {
+      fixed_rv = chain_to_instant(&chain, &fixed_when, date, &zc);
+    }
 
-  // Now the tricky part .. 
-  while (!done)
+  for (i = 0; i < n; ++i)
     {
-      // Make sure the month is valid.
-      while (dest->month > 11)
-	{
-	  ++dest->year; 
-	  dest->month -= 12;
-	}
-      
-      int nr_mday;
-      
-      // Adjust mday
-      nr_mday = (gregorian_months[dest->month]);
+      const cdc_calendar_t *d = (flags & CDC_BATCH_FIXED_A) ? date : &date[i];
+      const cdc_interval_t *iv = (flags & CDC_BATCH_FIXED_B) ? ival : &ival[i];
+      int rv;
 
-      if (dest->month == 1 && 
-	  is_gregorian_leap_year(dest->year))
+      if (linear && d->system == zone->system)
 	{
-	  ++nr_mday;
-	}
+	  // As cdc_zone_add().
+	  cdc_instant_t when;
+	  cdc_calendar_t tai;
 
-
-      if (dest->mday > nr_mday)
+	  if (flags & CDC_BATCH_FIXED_A)
+	    {
+	      rv = fixed_rv;
+	      memcpy(&when, &fixed_when, sizeof(cdc_instant_t));
+	    }
+	  else
+	    {
+	      rv = chain_to_instant(&chain, &when, d, &zc);
+	    }
+	  if (!rv) { rv = cdc_instant_add(&when, &when, iv); }
+	  if (!rv) { rv = instant_to_tai(&tai, &when); }
+	  if (!rv && zone->system == CDC_SYSTEM_GREGORIAN_TAI)
+	    {
+	      memcpy(&out[i], &tai, sizeof(cdc_calendar_t));
+	    }
+	  else if (!rv)
+	    {
+	      rv = chain_raise(&chain, zone, &out[i], &tai, &zc);
+	    }
+	}
+      else
 	{
-	  dest->mday -= nr_mday;
-	  ++dest->month;
-	  continue;
+	  // As cdc_zone_add(), but keeping our place in the leap table
+	  // and the BST calendar from one element to the next.
+	  cdc_calendar_t offset, tmp;
+
+	  rv = zone_add_offset(&offset, d, iv);
+	  if (!rv) 
+	    { 
+	      rv = zone_cursor_op(zone, &tmp, d, &offset, 
+				  CDC_OP_SIMPLE_ADD, &zc); 
+	    }
+	  if (!rv) { memcpy(&out[i], &tmp, sizeof(cdc_calendar_t)); }
 	}
-
-      // We're valid.
-      ++done;
+      BATCH_RESULT(rv, errs, i, first_rv);
     }
-
-#if DEBUG_GTAI
-  printf("gtai_op: normalised                = %s\n", dbg_pdate(dest));
-#endif
-
-
-  return 0;
-
+  return first_rv;
 }
 
-static int system_gtai_aux(struct cdc_zone_struct *self,
-			   const cdc_calendar_t *cal,
-			   cdc_calendar_aux_t *aux)
+/* -------------------- Stream converters ------------- */
+
+struct cdc_stream_converter_struct
 {
-  // There is no DST in TAI
-  aux->is_dst = 0;
+  cdc_zone_t *from_zone;
+  cdc_zone_t *to_zone;
 
-  {
-    int yday = 0;
-    int i;
-    for (i = 0; i < cal->month; ++i)
-      {
-	yday += gregorian_months[i];
-	// Leap year correction
-	if (i == 1 && is_gregorian_leap_year(cal->year)) { ++yday; }
-      }
-    yday += cal->mday;
+  //! Did both chains resolve? If not, we just cdc_bounce().
+  int resolved;
+  zone_chain_t down, up;
 
-    // We want our ydays to be zero-based.
-    aux->yday = yday -1;
-  }
+  zone_cursor_t cursor;
+};
 
-  // The century start day of week follows a 4,2,0,6 pattern. 17XX == 4 */
-  static const int cstart[] = { 4,2,0, 6};
-  static const int wday[] = { 0, 3, 3, 6, 1, 4, 6, 2, 5, 0, 3, 5 };
-  static const int leap_wday[] = { 6, 2, 3, 6, 1, 4, 6, 2, 5, 0, 3, 5 };
-  int dow;
+int cdc_stream_converter_new(cdc_stream_converter_t **out,
+			     cdc_zone_t *from_zone,
+			     cdc_zone_t *to_zone)
+{
+  cdc_stream_converter_t *conv;
 
-  // &3 is here to make sure the result is +ve.
-  int idx = ((cal->year / 100) - 17)&3;
-  int yoff = (cal->year % 100);
+  conv = (cdc_stream_converter_t *)malloc(sizeof(cdc_stream_converter_t));
+  if (!conv) { return CDC_ERR_INIT_FAILED; }
+  memset(conv, '\0', sizeof(cdc_stream_converter_t));
 
-  //printf("cstart[%d] = %d \n", 
-  //idx, cstart[idx]);
-  // printf("yoff = %d \n", cal->year%100);
+  conv->from_zone = from_zone;
+  conv->to_zone = to_zone;
+  conv->resolved = !zone_chain_resolve(&conv->down, from_zone) &&
+    !zone_chain_resolve(&conv->up, to_zone);
 
-  // This calculation actually expects mday to be 1-based.
-  dow = cstart[idx] + yoff + (yoff / 4) + 
-    (is_gregorian_leap_year(cal->year) ? leap_wday[cal->month] : 
-     wday[cal->month]) + (cal->mday) ;
-  aux->wday = (dow % 7);
+  (*out) = conv;
+  return 0;
+}
 
+int cdc_stream_converter_dispose(cdc_stream_converter_t **io_conv)
+{
+  if (!io_conv || !(*io_conv)) { return 0; }
+  free(*io_conv);
+  (*io_conv) = NULL;
   return 0;
 }
 
-static int system_gtai_epoch(struct cdc_zone_struct *self,
-			     cdc_calendar_t *cal)
+int cdc_stream_convert(cdc_stream_converter_t *conv,
+		       cdc_calendar_t *dst,
+		       const cdc_calendar_t *src)
 {
-  // The 'epoch' for TAI is, rather arbitrarily, 1 January 1958
-  cal->year = 1958;
-  cal->month = 0;
-  cal->mday = 1;
-  cal->hour = 0;
-  cal->minute = 0;
-  cal->second = 0;
-  cal->ns = 0;
-  cal->system = CDC_SYSTEM_GREGORIAN_TAI;
-  
-  return 0;
-}
+  cdc_calendar_t tmp;
+  int rv;
 
-static int system_gtai_lower_zone(struct cdc_zone_struct *self,
-				  struct cdc_zone_struct **next)
-{
-  (*next) = NULL;
-  return 0;
-}
+  if (!conv->resolved) 
+    {
+      return cdc_bounce(conv->from_zone, conv->to_zone, dst, src);
+    }
 
-/* ---------------------- UTC ---------------------- */
+  rv = chain_lower_to(&conv->down, &tmp, NULL, src, -1, &conv->cursor);
+  if (rv) { return rv; }
 
-static int system_utc_offset(struct cdc_zone_struct *self,
-			     cdc_calendar_t *dest,
-			     const cdc_calendar_t *src)
+  return chain_raise(&conv->up, conv->to_zone, dst, &tmp, &conv->cursor);
+}
+
+int cdc_stream_convert_batch(cdc_stream_converter_t *conv,
+			     cdc_calendar_t *dst,
+			     const cdc_calendar_t *src,
+			     int n,
+			     int *errs)
 {
-  const int nr_entries = sizeof(utc_lookup_table)/sizeof(utc_lookup_entry_t);
-  cdc_interval_t iv = { 0, 0 };
+  int first_rv = 0;
   int i;
-  int cmp_value;
-  int src_tai;
-  cdc_calendar_t utcsrc;
 
-  if (src->system == CDC_SYSTEM_GREGORIAN_TAI)
-    {
-      // The source is in TAI.
-      src_tai = 1;
-    }
-  else if (src->system == CDC_SYSTEM_UTC)
-    {
-      src_tai = 0;
-      memcpy(&utcsrc, src, sizeof(cdc_calendar_t));
-    }
-  else
+  for (i = 0; i < n; ++i)
     {
-      return CDC_ERR_NOT_MY_SYSTEM;
+      int rv = cdc_stream_convert(conv, &dst[i], &src[i]);
+      BATCH_RESULT(rv, errs, i, first_rv);
     }
+  return first_rv;
+}
 
+/* -------------------- Conversion plans ------------- */
 
-#if DEBUG_UTC
-  printf("cal_offset() %s \n", dbg_pdate(src));
-#endif
+/* A plan is the chain_lower_to() and chain_raise() a bounce would do,
+ * laid out as one list of steps. Each step takes the offset of one 
+ * zone and applies it with the op of another - for lowering, the 
+ * negated offset of a zone with the op of the zone below; for 
+ * raising, a zone's own offset and op - and which cursor-aware 
+ * function to use for each is picked when the plan is compiled.
+ */
 
-  
-  // First entry in the table is a sentinel.
-  for (i = 1 ;i < nr_entries; ++i)
-    {
-      utc_lookup_entry_t *current = &utc_lookup_table[i];
-      int current_leap = 0;
-      cdc_calendar_t to_cmp;
-      
-      // UTC references itself (joy!) so that if the source is TAI we need
-      // to add the current entry before comparing.
-      if (src_tai)
-	{
-	  cdc_calendar_t off;
-	  int rv;
+enum
+  {
+    PLAN_FN_OTHER,
+    PLAN_FN_UTC,
+    PLAN_FN_UTCPLUS,
+    PLAN_FN_UKCT
+  };
 
-	  memset(&off, '\0', sizeof(cdc_calendar_t));
-	  
-	  off.ns = utc_lookup_table[i].utctai.ns;
-	  off.second = utc_lookup_table[i].utctai.s;
+typedef struct plan_step_struct
+{
+  cdc_zone_t *offset_zone;
+  int offset_fn;
 
-#if DEBUG_UTC
-	  printf("src = %s\n", dbg_pdate(src));
-#endif
+  cdc_zone_t *op_zone;
+  int op_fn;
 
-	  rv = self->op(self, &utcsrc, src, &off, CDC_OP_ZONE_ADD);
-	  if (rv) { return rv; }
-#if DEBUG_UTC
-	  printf("opout = %s\n", dbg_pdate(&utcsrc));
-#endif
+  //! The system the result is in.
+  uint32_t system;
 
-	}
+  //! Lowering, so negate the offset.
+  int negate;
 
-      // We synthetically zero utcsrc.ns so that the compare function
-      // will return 0 when we are exactly on a leap second.
-      // 
-      // Also make sure that offsets work properly for leap seconds.
-      // (could also duplicate entries in the table)
-      memcpy(&to_cmp, &utcsrc, sizeof(cdc_calendar_t));
-      to_cmp.ns = 0; 
-      if (to_cmp.second == 60)
-	{
-	  // Landed on a leap second. Remember to add one later.
-	  current_leap = 1;
-	  to_cmp.second = 59;
-	}
+} plan_step_t;
 
-      cmp_value = cdc_calendar_cmp(&to_cmp, &current->when);
+struct cdc_plan_struct
+{
+  cdc_zone_t *down_zone;
+  cdc_zone_t *up_zone;
 
-#if DEBUG_UTC
-      printf("cmp[%d] = %d (%s)\n", i, cmp_value, dbg_pdate(&utcsrc));
-      printf("          current: %s \n", dbg_pdate(&current->when));
-#endif
+  //! Times in this system (down_zone's) go through the steps.
+  uint32_t src_system;
 
-      
-      // If we are before this entry, the previous entry applies
-      if (cmp_value < 0)
-	{
-	  break;
-	}
-      
-      
-      if (cmp_value == 0)
-	{
-	  // There is a leap second immediately following. The 
-	  //  value is < current, we're going forward, else we're going back.
-	  //
-	  // Also table indices below UTC_LOOKUP_MIN_LEAP_SECOND are sync points
-	  // and not leap seconds per se.
-	  //
-	  // If we landed on a leap second, there isn't one following. This is it.
-	  int is_leap_second;
+  //! steps[0] to steps[nr_lower - 1] lower; the rest raise.
+  int nr_lower;
+  int nr_steps;
+  plan_step_t steps[2 * ZONE_CHAIN_MAX];
+};
 
-	  is_leap_second = !current_leap && 
-	    (i >= UTC_LOOKUP_MIN_LEAP_SECOND) && 
-	     (cdc_interval_cmp(&utc_lookup_table[i-1].utctai, 
-				    &current->utctai) > 0);
+static int plan_offset_fn(const cdc_zone_t *z)
+{
+  if (z->offset == system_utc_offset) { return PLAN_FN_UTC; }
+  if (z->offset == system_ukct_offset) { return PLAN_FN_UKCT; }
+  return PLAN_FN_OTHER;
+}
 
-	  // If we'd hit a leap second or we were a few nanoseconds ahead, 
-	  // it's this entry that applies, not the last one.
-	  if (/* current_leap || */(!(is_leap_second) && utcsrc.ns))
-	    {
-	      iv = utc_lookup_table[i].utctai;
-	    }
-	  break;
-	}
+static int plan_op_fn(const cdc_zone_t *z)
+{
+  if (z->op == system_utc_op) { return PLAN_FN_UTC; }
+  if (z->op == system_utcplus_op) { return PLAN_FN_UTCPLUS; }
+  if (z->op == system_ukct_op) { return PLAN_FN_UKCT; }
+  return PLAN_FN_OTHER;
+}
+
+static void plan_step(plan_step_t *step, cdc_zone_t *offset_zone,
+		      cdc_zone_t *op_zone, int negate)
+{
+  step->offset_zone = offset_zone;
+  step->offset_fn = plan_offset_fn(offset_zone);
+  step->op_zone = op_zone;
+  step->op_fn = plan_op_fn(op_zone);
+  step->system = op_zone->system;
+  step->negate = negate;
+}
 
-      // If we pass this point, this table entry applies.
-      iv = utc_lookup_table[i].utctai;
+int cdc_plan_compile(cdc_plan_t **out,
+		     cdc_zone_t *down_zone,
+		     cdc_zone_t *up_zone)
+{
+  zone_chain_t down, up;
+  cdc_plan_t *plan;
+  uint32_t bottom;
+  int i, j;
+  int rv;
+
+  (*out) = NULL;
+  rv = zone_chain_resolve(&down, down_zone);
+  if (!rv) { rv = zone_chain_resolve(&up, up_zone); }
+  if (rv) { return rv; }
+
+  // Where chain_raise() would start for whatever comes out of the 
+  // bottom of down_zone's chain.
+  bottom = down.zones[down.nr_zones - 1]->system;
+  for (j = 0; j < up.nr_zones; ++j)
+    {
+      const cdc_zone_t *low = up.zones[(j + 1 < up.nr_zones) ? j + 1 : j];
+      if (low->system == bottom) { break; }
     }
-	 
-  
-  // Right. If we're going to UTC, add the correction. If to
-  // TAI, subtract it.
-  memset(dest, '\0', sizeof(cdc_calendar_t));
+  if (j == up.nr_zones) { return CDC_ERR_NOT_MY_SYSTEM; }
 
+  plan = (cdc_plan_t *)malloc(sizeof(cdc_plan_t));
+  if (!plan) { return CDC_ERR_INIT_FAILED; }
+  memset(plan, '\0', sizeof(cdc_plan_t));
 
+  plan->down_zone = down_zone;
+  plan->up_zone = up_zone;
+  plan->src_system = down_zone->system;
 
-  // If we're going to UTC and this is a -ve leap second, add one to 
-  // the number of seconds before we normalise and record that we're
-  // in the 60th second later.
-  dest->second += iv.s;
-  dest->ns += iv.ns; 
-  dest->system = CDC_SYSTEM_OFFSET;
-#if DEBUG_UTC
-  printf("utc_offset: dest = %s\n", dbg_pdate(dest));
-#endif
+  for (i = 0; i + 1 < down.nr_zones; ++i)
+    {
+      plan_step(&plan->steps[plan->nr_steps++], 
+		down.zones[i], down.zones[i + 1], 1);
+    }
+  plan->nr_lower = plan->nr_steps;
 
+  for (i = j; i >= 0; --i)
+    {
+      plan_step(&plan->steps[plan->nr_steps++], 
+		up.zones[i], up.zones[i], 0);
+    }
 
+  (*out) = plan;
   return 0;
 }
 
-static int system_utc_op(struct cdc_zone_struct *self,
-			 cdc_calendar_t *dest,
-			 const cdc_calendar_t *src,
-			 const cdc_calendar_t *offset,
-			 int op)
+int cdc_plan_dispose(cdc_plan_t **io_plan)
 {
-  cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
-  int rv ;
+  if (!io_plan || !(*io_plan)) { return 0; }
+  free(*io_plan);
+  (*io_plan) = NULL;
+  return 0;
+}
 
-  // Right. To perform a fieldwise add on a UTC time, we:
-  //
-  //  - Work out the offset between src and TAI. 
-  //  - Add src-1s to offset in TAI -> tdest.
-  //  - Work out the offset betwen tdest and TAI
-  //  - If a leap second follows,  this is that leap second.
-  //  - If a leap second doesn't follow, add 1s and go again.
-  //  - Either way, add the offset between src and dest to 
-  //      the result in TAI.
-  //
-  // @todo There must be a better way .. 
+/** One step of a plan, converting cur in place. */
+static int plan_run_step(const plan_step_t *step, cdc_calendar_t *cur,
+			 zone_cursor_t *zc)
+{
+  cdc_calendar_t offset, tmp;
+  int rv;
 
-  // OK. First off, work out the offset for the source.
-  cdc_calendar_t src_diff, dst_diff;
-  int complex = 0;
-  cdc_calendar_t dst_value, tmp;
-  int do_ls = 1;
+  switch (step->offset_fn)
+    {
+    case PLAN_FN_UTC:
+      rv = utc_offset(step->offset_zone, &offset, cur, &zc->leap);
+      break;
+    case PLAN_FN_UKCT:
+      rv = ukct_offset(step->offset_zone, &offset, cur, zc);
+      break;
+    default:
+      rv = step->offset_zone->offset(step->offset_zone, &offset, cur);
+      break;
+    }
+  if (rv) { return rv; }
 
-  //if (src->system != CDC_SYSTEM_UTC)
-  // {
-  //   return CDC_ERR_NOT_MY_SYSTEM;
-  // }
+  cur->system = step->system;
+  if (step->negate) { cdc_negate(&offset); }
 
-  if (op == CDC_OP_COMPLEX_ADD)
+  switch (step->op_fn)
     {
-      op = CDC_OP_SIMPLE_ADD;
-      ++complex;
+    case PLAN_FN_UTC:
+      rv = utc_op(step->op_zone, &tmp, cur, &offset, CDC_OP_ZONE_ADD, 
+		  &zc->leap);
+      break;
+    case PLAN_FN_UTCPLUS:
+      rv = utcplus_op(step->op_zone, &tmp, cur, &offset, CDC_OP_ZONE_ADD,
+		      zc);
+      break;
+    case PLAN_FN_UKCT:
+      rv = ukct_op(step->op_zone, &tmp, cur, &offset, CDC_OP_ZONE_ADD, zc);
+      break;
+    default:
+      rv = step->op_zone->op(step->op_zone, &tmp, cur, &offset, 
+			     CDC_OP_ZONE_ADD);
+      break;
     }
+  if (rv) { return rv; }
 
-  if (op == CDC_OP_ZONE_ADD)
+  memcpy(cur, &tmp, sizeof(cdc_calendar_t));
+  cur->system = step->system;
+  return 0;
+}
+
+static int plan_run(const cdc_plan_t *plan,
+		    cdc_calendar_t *dst,
+		    const cdc_calendar_t *src,
+		    zone_cursor_t *zc)
+{
+  cdc_calendar_t cur, lowered;
+  int i;
+  int rv;
+
+  if (src->system != plan->src_system)
     {
-      // This is a zone addition and therefore particularly easy.
-      rv = gtai->op(gtai, &tmp, src, offset, CDC_OP_ZONE_ADD);
-#if DEBUG_UTC
-      printf("utc_zone_op (for zone addition) rv = %d result = %s\n", rv, dbg_pdate(&tmp));
-#endif
+      return cdc_bounce(plan->down_zone, plan->up_zone, dst, src);
+    }
 
+  memcpy(&cur, src, sizeof(cdc_calendar_t));
+  for (i = 0; i < plan->nr_lower; ++i)
+    {
+      rv = plan_run_step(&plan->steps[i], &cur, zc);
       if (rv) { return rv; }
     }
-  else
-    {
-      rv = self->offset(self, &src_diff, src);
-      if (rv < 0) { return rv; }
-            
-      rv = gtai->op(gtai, &dst_value, src, offset, op);
-      if (rv < 0) { return rv; }
-      
-      // Now the destination offset.
-      rv = self->offset(self, &dst_diff, &dst_value);
-      if (rv < 0) { return rv; }
 
-#if DEBUG_UTC
-      printf("utc_op:  src_diff         = %s \n", dbg_pdate(&src_diff));
-      printf("utc_op:  dst_value        = %s \n", dbg_pdate(&dst_value));
-      printf("utc_op:  dst_diff         = %s \n", dbg_pdate(&dst_diff));
-#endif
-      
-      // If source and destination diffs are the same, we can just return the result.
-      if (!cdc_calendar_cmp(&src_diff, &dst_diff))
-	{
-	  memcpy(dest, &dst_value, sizeof(cdc_calendar_t));
-	  return 0;
-	}
-      
-      // Otherwise, the actual offset is (dst - src) + offset, knocked down by 
-      // offset
-      rv = cdc_simple_op(&dst_diff, &dst_diff, &src_diff, CDC_OP_SUBTRACT);
-      if (rv) { return rv; }
-      if (complex)
+  memcpy(&lowered, &cur, sizeof(cdc_calendar_t));
+  for (; i < plan->nr_steps; ++i)
+    {
+      rv = plan_run_step(&plan->steps[i], &cur, zc);
+      if (rv) 
 	{
-	  do_knockdown(&dst_diff, offset, &do_ls);
+	  // As chain_raise(): cdc_zone_raise() retries some failures in
+	  // other ways.
+	  return cdc_zone_raise(plan->up_zone, dst, &lowered);
 	}
-      
-      rv = gtai->op(gtai, &tmp, &dst_value, &dst_diff, op);
-      if (rv < 0) { return rv; }
-#if DEBUG_UTC
-      printf("-- utc_zone_op: Came up with %s \n", dbg_pdate(&tmp));
-#endif
-
     }
-  
-  // By definition, tmp is now either a leap second or not. Note that we 
-  // didn't know if it was a leap second in the previous step because the
-  // leap seconds between two widely spaced dates will bring dates calculated
-  // as e.g. 1980-01-01 00:00:02 down to 23:59:59 .
-  //
-  if (do_ls)
-  {
-    int i;
-    const int nr_entries = sizeof(utc_lookup_table)/sizeof(utc_lookup_entry_t);
-    cdc_calendar_t one_second, r;
-    long int saved_ns;
-
-    memset(&one_second, '\0', sizeof(cdc_calendar_t));
-
-    // For a zone addition, there is no destination value and we've therefore
-    // ended up on 'the wrong side' of a leap second.
-    if (op == CDC_OP_ZONE_ADD)
-      {
-	one_second.second = -1; 
-      }
-    else
-      {
-	one_second.second = 0;
-      }
 
-    rv = gtai->op(gtai, &r, &tmp, &one_second, CDC_OP_SIMPLE_ADD);
-    if (rv) { return rv; }
+  memcpy(dst, &cur, sizeof(cdc_calendar_t));
+  return 0;
+}
 
-    saved_ns = r.ns; r.ns = 0;
+int cdc_plan_apply(const cdc_plan_t *plan,
+		   cdc_calendar_t *dst,
+		   const cdc_calendar_t *src)
+{
+  zone_cursor_t zc;
 
-#if DEBUG_UTC
-    printf("Searching for leap second after: %s \n", dbg_pdate(&r));
-#endif
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  return plan_run(plan, dst, src, &zc);
+}
 
-    
-    for (i = UTC_LOOKUP_MIN_LEAP_SECOND; i < nr_entries; ++i)
-      {
-	utc_lookup_entry_t *current = &utc_lookup_table[i];
-	int cmp_value;
+int cdc_plan_apply_batch(const cdc_plan_t *plan,
+			 cdc_calendar_t *dst,
+			 const cdc_calendar_t *src,
+			 int n,
+			 int *errs)
+{
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int i;
 
-	cmp_value = cdc_calendar_cmp(&r, &current->when);
-#if DEBUG_UTC
-	printf("i = %d, cmp = %d \n", i, cmp_value);
-#endif
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  for (i = 0; i < n; ++i)
+    {
+      int rv = plan_run(plan, &dst[i], &src[i], &zc);
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
+}
 
-	if (!cmp_value)
-	  {
-	    // This is the leap second just after the calculated time.
-	    ++r.second;
-	    r.ns = saved_ns; // Restore nanoseconds.
-	    memcpy(dest, &r, sizeof(cdc_calendar_t));
-#if DEBUG_UTC
-	    printf("result was leap second : %s\n", 
-		   dbg_pdate(dest));
-#endif
+/* -------------------- Calendar columns -------------- */
 
-	    return 0;
-	  }
-	if (cmp_value < 0)
-	  {
-	    // tmp < current->when - never going to happen now
-	    break;
-	  }
-      }
-  }
+//! How many times we widen to ints at once for the column kernels.
+#define COLUMNS_BLOCK 256
 
-  // Not a leap second.
-  memcpy(dest, &tmp, sizeof(cdc_calendar_t));
-#if DEBUG_UTC
-  printf("result was not leap second: %s \n", 
-	 dbg_pdate(dest));
-#endif
+#define COLUMN_FITS_INT8(v) ((v) >= -128 && (v) <= 127)
+#define COLUMN_FITS_INT32(v) ((v) >= -2147483647L - 1 && (v) <= 2147483647L)
 
+int cdc_calendar_columns_new(cdc_calendar_columns_t **out, int capacity)
+{
+  cdc_calendar_columns_t *cols;
+  char *p;
+
+  if (capacity < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+
+  // One allocation: the structure, then the 32-bit columns, then the 
+  // 8-bit ones.
+  p = (char *)malloc(sizeof(cdc_calendar_columns_t) + 
+		     (size_t)capacity * (2 * sizeof(int32_t) + 
+					 5 * sizeof(int8_t)));
+  if (!p) { return CDC_ERR_INIT_FAILED; }
+
+  cols = (cdc_calendar_columns_t *)p;
+  memset(cols, '\0', sizeof(cdc_calendar_columns_t));
+  cols->capacity = capacity;
+  p += sizeof(cdc_calendar_columns_t);
+  cols->year = (int32_t *)p; p += capacity * sizeof(int32_t);
+  cols->ns = (int32_t *)p; p += capacity * sizeof(int32_t);
+  cols->month = (int8_t *)p; p += capacity;
+  cols->mday = (int8_t *)p; p += capacity;
+  cols->hour = (int8_t *)p; p += capacity;
+  cols->minute = (int8_t *)p; p += capacity;
+  cols->second = (int8_t *)p;
+
+  (*out) = cols;
   return 0;
 }
 
-static int system_utc_aux(struct cdc_zone_struct *self,
-			  const cdc_calendar_t *calc,
-			  cdc_calendar_aux_t *aux)
+int cdc_calendar_columns_dispose(cdc_calendar_columns_t **io_cols)
 {
-  // Same as for the underlying calendar.
-  cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
+  if (!io_cols || !(*io_cols)) { return 0; }
+  free(*io_cols);
+  (*io_cols) = NULL;
+  return 0;
+}
 
-  return gtai->aux(gtai, calc, aux);
+/** Element i of cols as a calendar time */
+static void columns_get(const cdc_calendar_columns_t *cols, int i,
+			cdc_calendar_t *cal)
+{
+  memset(cal, '\0', sizeof(cdc_calendar_t));
+  cal->year = cols->year[i];
+  cal->month = cols->month[i];
+  cal->mday = cols->mday[i];
+  cal->hour = cols->hour[i];
+  cal->minute = cols->minute[i];
+  cal->second = cols->second[i];
+  cal->ns = cols->ns[i];
+  cal->system = cols->system;
 }
 
-static int system_utc_epoch(struct cdc_zone_struct *self,
-			    cdc_calendar_t *aux)
+/** Store cal as element i of cols, if it'll go. */
+static int columns_put(cdc_calendar_columns_t *cols, int i,
+		       const cdc_calendar_t *cal)
 {
-  // cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
+  if (cal->system != cols->system) { return CDC_ERR_SYSTEMS_DO_NOT_MATCH; }
+  if (!COLUMN_FITS_INT8(cal->month) || !COLUMN_FITS_INT8(cal->mday) ||
+      !COLUMN_FITS_INT8(cal->hour) || !COLUMN_FITS_INT8(cal->minute) ||
+      !COLUMN_FITS_INT8(cal->second) || !COLUMN_FITS_INT32(cal->ns))
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
 
-  // The UTC epoch is 'properly' in 1961, but 1972 has the advantage
-  // that it was when the UTC and TAI seconds harmonised.
-  static const cdc_calendar_t epoch = 
-    { 1972, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC };
-      
-  memcpy(aux, &epoch, sizeof(cdc_calendar_t));
+  cols->year[i] = cal->year;
+  cols->month[i] = (int8_t)cal->month;
+  cols->mday[i] = (int8_t)cal->mday;
+  cols->hour[i] = (int8_t)cal->hour;
+  cols->minute[i] = (int8_t)cal->minute;
+  cols->second[i] = (int8_t)cal->second;
+  cols->ns[i] = (int32_t)cal->ns;
   return 0;
 }
 
-static int utc_init(struct cdc_zone_struct *self,
-		    int arg_i, void *arg_n)
+int cdc_calendar_columns_from_array(cdc_calendar_columns_t *cols,
+				    const cdc_calendar_t *src,
+				    int n)
 {
-  self->handle = (void *)arg_n;
-  return 0;
-}
+  int i;
 
+  if (n < 0 || n > cols->capacity) { return CDC_ERR_INVALID_ARGUMENT; }
 
-static int system_utc_lower_zone(struct cdc_zone_struct *self,
-				 struct cdc_zone_struct **next)
-{
-  (*next) = (struct cdc_zone_struct *)(self->handle);
+  if (n) { cols->system = src[0].system; }
+  for (i = 0; i < n; ++i)
+    {
+      int rv = columns_put(cols, i, &src[i]);
+      if (rv) { return rv; }
+    }
+  cols->n = n;
   return 0;
 }
 
-/* -------------------------------- UTC Plus --------------------------- */
-
-
-
-static int utc_plus_init(struct cdc_zone_struct *self, int arg_i, void *arg_n)
+int cdc_calendar_columns_to_array(cdc_calendar_t *dst,
+				  const cdc_calendar_columns_t *cols)
 {
-  self->handle = (void *)arg_n;
+  int i;
+
+  for (i = 0; i < cols->n; ++i)
+    {
+      columns_get(cols, i, &dst[i]);
+    }
   return 0;
 }
 
-static int system_utcplus_offset(struct cdc_zone_struct *self,
-				 cdc_calendar_t *dest,
-				 const cdc_calendar_t *src)
+/** Set dest up for the results of a batch of n from src, which may 
+ *  be dest: we take a copy of src's header first so we can still 
+ *  read it.
+ */
+static int columns_begin(cdc_calendar_columns_t *dest,
+			 cdc_calendar_columns_t *in,
+			 const cdc_calendar_columns_t *src,
+			 uint32_t system)
 {
-  // This is a straightforward offset from UTC. Leap seconds therefore
-  // occur at times other than 23:59:59 .. 
-  int mins = UTCPLUS_SYSTEM_TO_MINUTES(self->system);
+  memcpy(in, src, sizeof(cdc_calendar_columns_t));
+  if (in->n > dest->capacity) { return CDC_ERR_INVALID_ARGUMENT; }
 
-  memset(dest, '\0', sizeof(cdc_calendar_t));
-  dest->hour = (mins/60);
-  dest->minute = (mins % 60);
-  
+  dest->n = in->n;
+  dest->system = system;
   return 0;
 }
 
-static int system_utcplus_aux(struct cdc_zone_struct *self,
-			      const cdc_calendar_t *calc,
-			      cdc_calendar_aux_t *aux)
+int cdc_zone_raise_columns(cdc_zone_t *zone,
+			   cdc_calendar_columns_t *dest,
+			   const cdc_calendar_columns_t *src,
+			   int *errs)
 {
+  cdc_calendar_columns_t in;
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-  // Works exactly the same way as UTC does.
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-
-  return utc->aux(utc, calc, aux);
-}
+  first_rv = columns_begin(dest, &in, src, zone->system);
+  if (first_rv) { return first_rv; }
 
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  for (i = 0; i < in.n; ++i)
+    {
+      cdc_calendar_t cal, out;
+      int rv;
 
+      columns_get(&in, i, &cal);
+      rv = resolved ? chain_raise(&chain, zone, &out, &cal, &zc) :
+	cdc_zone_raise(zone, &out, &cal);
+      if (!rv) { rv = columns_put(dest, i, &out); }
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
+}
 
-static int system_utcplus_op(struct cdc_zone_struct *self,
-			     cdc_calendar_t *dest,
-			     const cdc_calendar_t *src,
-			     const cdc_calendar_t *offset,
-			     int op)
+int cdc_zone_lower_to_columns(cdc_zone_t *zone,
+			      cdc_calendar_columns_t *dest,
+			      const cdc_calendar_columns_t *src,
+			      int to_system,
+			      int *errs)
 {
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-  
-  // This is actually pretty civilised. For all operations, we first
-  // subtract the relevant number of hours and minutes. Then we perform
-  // the operation. Then we add the hours and minutes again. Because
-  // these are offset additions, they don't change the leap second 
-  // indicator and because they are strictly reversible, leap seconds
-  // always end up 'where they were generated' in UTC times.
-  
-  cdc_calendar_t adj, diff, tgt, srcx;
-  int rv;
-  int mins = UTCPLUS_SYSTEM_TO_MINUTES(self->system);
-
-  memset(&diff, '\0', sizeof(cdc_calendar_t));
-  diff.hour  = -(mins/ 60);
-  diff.minute = -(mins % 60);
-
-  memcpy(&srcx, src, sizeof(cdc_calendar_t));
-  srcx.system = utc->system;
+  cdc_calendar_columns_t in;
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  uint32_t system = (uint32_t)to_system;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-#if DEBUG_UTCPLUS
-  printf("utcplus_op: src = %s\n", dbg_pdate(src));
-#endif
+  resolved = !zone_chain_resolve(&chain, zone);
+  if (to_system == -1)
+    {
+      cdc_zone_t *z = zone;
 
-  rv = utc->op(utc, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD);
-  if (rv) { return rv; }
-  
-#if DEBUG_UTCPLUS
-  printf("utcplus_op: adj = %s \n", dbg_pdate(&adj));
-#endif
+      if (resolved) 
+	{ 
+	  z = chain.zones[chain.nr_zones - 1]; 
+	}
+      else
+	{
+	  cdc_zone_t *low = NULL;
 
+	  while (!z->lower_zone(z, &low) && low) { z = low; }
+	}
+      system = z->system;
+    }
 
-  // Now perform whatever operation was originally required.
-  rv = utc->op(utc, &tgt, &adj, offset, op);
-  if (rv) { return rv; }
+  first_rv = columns_begin(dest, &in, src, system);
+  if (first_rv) { return first_rv; }
 
-  // And adjust back.
-  
-  diff.hour = (mins/60);
-  diff.minute = (mins%60);
-  
-  {
-    int ls = 0;
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  for (i = 0; i < in.n; ++i)
+    {
+      cdc_calendar_t cal, out;
+      cdc_zone_t *l;
+      int rv;
 
-    if (tgt.second == 60)
-      {
-	// Leap second! Pull it around . 
-	ls =1;
-	--tgt.second;
-      }
-    
+      columns_get(&in, i, &cal);
+      rv = resolved ? 
+	chain_lower_to(&chain, &out, NULL, &cal, to_system, &zc) :
+	cdc_zone_lower_to(zone, &out, &l, &cal, to_system);
+      if (!rv) { rv = columns_put(dest, i, &out); }
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
+}
 
-#if DEBUG_UTCPLUS
-    printf("utcplus_op: tgt = %s \n", dbg_pdate(&tgt));
-#endif
+int cdc_bounce_columns(cdc_zone_t *down_zone,
+		       cdc_zone_t *up_zone,
+		       cdc_calendar_columns_t *dest,
+		       const cdc_calendar_columns_t *src,
+		       int *errs)
+{
+  cdc_calendar_columns_t in;
+  zone_chain_t down, up;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-    rv = utc->op(utc, dest, &tgt, &diff, CDC_OP_COMPLEX_ADD);
-    if (rv) { return rv; }
-    
-    if (ls) { ++dest->second; }
-  }
-  dest->system = self->system;
+  first_rv = columns_begin(dest, &in, src, up_zone->system);
+  if (first_rv) { return first_rv; }
 
-#if DEBUG_UTCPLUS
-  printf("utcplus: dest = %s\n", dbg_pdate(dest));
-#endif
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&down, down_zone) && 
+    !zone_chain_resolve(&up, up_zone);
+  for (i = 0; i < in.n; ++i)
+    {
+      cdc_calendar_t cal, out;
+      int rv;
 
+      columns_get(&in, i, &cal);
+      if (resolved)
+	{
+	  cdc_calendar_t tmp;
 
-  return 0;
+	  rv = chain_lower_to(&down, &tmp, NULL, &cal, -1, &zc);
+	  if (!rv) { rv = chain_raise(&up, up_zone, &out, &tmp, &zc); }
+	}
+      else
+	{
+	  rv = cdc_bounce(down_zone, up_zone, &out, &cal);
+	}
+      if (!rv) { rv = columns_put(dest, i, &out); }
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
 }
 
-int system_utcplus_epoch(struct cdc_zone_struct *self,
-			 cdc_calendar_t *aux)
+int cdc_zone_columns_to_instants(cdc_zone_t *zone,
+				 cdc_instant_t *out,
+				 const cdc_calendar_columns_t *src,
+				 int *errs)
 {
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-  return utc->epoch(self, aux);
-}
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int i;
 
-int system_utcplus_lower_zone(struct cdc_zone_struct *self,
-			      struct cdc_zone_struct **next)
-{
-  (*next) = (struct cdc_zone_struct *)(self->handle);
-  return 0;
-}
+  if (src->system == CDC_SYSTEM_GREGORIAN_TAI)
+    {
+      // Already TAI, so there's nothing to lower: widen a block at a 
+      // time for the kernel.
+      int year[COLUMNS_BLOCK], month[COLUMNS_BLOCK], mday[COLUMNS_BLOCK];
+      int hour[COLUMNS_BLOCK], minute[COLUMNS_BLOCK], second[COLUMNS_BLOCK];
+      long int ns[COLUMNS_BLOCK], out_ns[COLUMNS_BLOCK];
+      int64_t s[COLUMNS_BLOCK];
+      int lo;
+
+      for (lo = 0; lo < src->n; lo += COLUMNS_BLOCK)
+	{
+	  int nr = (src->n - lo < COLUMNS_BLOCK) ? src->n - lo : COLUMNS_BLOCK;
+	  int j;
+
+	  for (j = 0; j < nr; ++j)
+	    {
+	      year[j] = src->year[lo + j];
+	      month[j] = src->month[lo + j];
+	      mday[j] = src->mday[lo + j];
+	      hour[j] = src->hour[lo + j];
+	      minute[j] = src->minute[lo + j];
+	      second[j] = src->second[lo + j];
+	      ns[j] = src->ns[lo + j];
+	    }
+	  cdc_tai_columns_to_instants(s, out_ns, year, month, mday, hour,
+				      minute, second, ns, nr);
+	  for (j = 0; j < nr; ++j)
+	    {
+	      out[lo + j].s = s[j];
+	      out[lo + j].ns = out_ns[j];
+	      if (errs) { errs[lo + j] = 0; }
+	    }
+	}
+      return 0;
+    }
 
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  for (i = 0; i < src->n; ++i)
+    {
+      cdc_calendar_t cal;
+      int rv;
 
+      columns_get(src, i, &cal);
+      rv = resolved ? chain_to_instant(&chain, &out[i], &cal, &zc) :
+	cdc_zone_to_instant(zone, &out[i], &cal);
+      BATCH_RESULT(rv, errs, i, first_rv);
+    }
+  return first_rv;
+}
 
-#if DEBUG_ANY
-static const char *dbg_pdate(const cdc_calendar_t *cal)
+int cdc_zone_columns_from_instants(cdc_zone_t *zone,
+				   cdc_calendar_columns_t *dest,
+				   const cdc_instant_t *src,
+				   int n,
+				   int *errs)
 {
-  static char buf[128];
-  cdc_calendar_sprintf(buf, 128, cal);
-  return buf;
-}
-#endif
+  int year[COLUMNS_BLOCK], month[COLUMNS_BLOCK], mday[COLUMNS_BLOCK];
+  int hour[COLUMNS_BLOCK], minute[COLUMNS_BLOCK], second[COLUMNS_BLOCK];
+  long int ns[COLUMNS_BLOCK], out_ns[COLUMNS_BLOCK];
+  int64_t s[COLUMNS_BLOCK];
+  zone_chain_t chain;
+  zone_cursor_t zc;
+  int first_rv = 0;
+  int resolved;
+  int lo;
+
+  if (n < 0 || n > dest->capacity) { return CDC_ERR_INVALID_ARGUMENT; }
+  dest->n = n;
+  dest->system = zone->system;
 
-/* ---------------- British Summer Time ------------------- */
+  memset(&zc, '\0', sizeof(zone_cursor_t));
+  resolved = !zone_chain_resolve(&chain, zone);
+  for (lo = 0; lo < n; lo += COLUMNS_BLOCK)
+    {
+      int nr = (n - lo < COLUMNS_BLOCK) ? n - lo : COLUMNS_BLOCK;
+      int block_rv;
+      int j;
 
+      for (j = 0; j < nr; ++j)
+	{
+	  s[j] = src[lo + j].s;
+	  ns[j] = src[lo + j].ns;
+	}
+      block_rv = cdc_tai_columns_from_instants(year, month, mday, hour,
+					       minute, second, out_ns, 
+					       s, ns, nr);
+      if (!block_rv && zone->system == CDC_SYSTEM_GREGORIAN_TAI)
+	{
+	  // Normalised TAI fields always fit.
+	  for (j = 0; j < nr; ++j)
+	    {
+	      dest->year[lo + j] = year[j];
+	      dest->month[lo + j] = (int8_t)month[j];
+	      dest->mday[lo + j] = (int8_t)mday[j];
+	      dest->hour[lo + j] = (int8_t)hour[j];
+	      dest->minute[lo + j] = (int8_t)minute[j];
+	      dest->second[lo + j] = (int8_t)second[j];
+	      dest->ns[lo + j] = (int32_t)out_ns[j];
+	      if (errs) { errs[lo + j] = 0; }
+	    }
+	  continue;
+	}
 
-/* BST: Applied to any other time zone.
- *
- * From <http://www.direct.gov.uk/en/Governmentcitizensandrights/LivingintheUK/DG_073741>
- *
- *  - In spring, the clocks go forward 1h at 0100 GMT on the last Sunday in March.
- *  - In autumn, the clocks go back 1h at 0200 BST on the last Sunday in October.
- */
+      for (j = 0; j < nr; ++j)
+	{
+	  cdc_calendar_t tai, out;
+	  int rv = 0;
 
-static int is_bst(struct cdc_zone_struct *z, const  cdc_calendar_t *cal);
+	  if (block_rv)
+	    {
+	      // Something in this block is out of range; find out what.
+	      rv = instant_to_tai(&tai, &src[lo + j]);
+	    }
+	  else
+	    {
+	      memset(&tai, '\0', sizeof(cdc_calendar_t));
+	      tai.year = year[j]; tai.month = month[j]; tai.mday = mday[j];
+	      tai.hour = hour[j]; tai.minute = minute[j]; 
+	      tai.second = second[j]; tai.ns = out_ns[j];
+	      tai.system = CDC_SYSTEM_GREGORIAN_TAI;
+	    }
 
+	  if (!rv)
+	    {
+	      if (zone->system == CDC_SYSTEM_GREGORIAN_TAI)
+		{
+		  memcpy(&out, &tai, sizeof(cdc_calendar_t));
+		}
+	      else
+		{
+		  rv = resolved ? chain_raise(&chain, zone, &out, &tai, &zc) :
+		    cdc_zone_raise(zone, &out, &tai);
+		}
+	    }
+	  if (!rv) { rv = columns_put(dest, lo + j, &out); }
+	  BATCH_RESULT(rv, errs, lo + j, first_rv);
+	}
+    }
+  return first_rv;
+}
 
-static int ukct_init(struct cdc_zone_struct *self,
-	     int iarg, void *parg)
+/* -------------------- Generic NULL functions -------- */
+static int null_init(struct cdc_zone_struct *self, int arg_i, void *arg_n)
 {
-  self->handle = parg;
   return 0;
 }
 
+static int null_dispose(struct cdc_zone_struct *self)
+{
+  return 0;
+}
 
-static int system_ukct_offset(struct cdc_zone_struct *self,
-			     cdc_calendar_t *offset,
-			     const cdc_calendar_t *src)
+/** Set cal to the start of 'year' (INT_MIN or INT_MAX, for an 
+ *  unbounded end of a span) in 'system'.
+ */
+static void span_unbounded(cdc_calendar_t *cal, int year, uint32_t system)
 {
-  // Is it after the last Sunday in march?
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-  int bst = is_bst(utc, src);
-  if (bst < 0) { return bst; }
-  
+  memset(cal, '\0', sizeof(cdc_calendar_t));
+  cal->year = year;
+  cal->mday = 1;
+  cal->system = system;
+}
 
-#if DEBUG_BST
-  printf("system_ukct_offset:  %s is_bst? %d \n",
-	 dbg_pdate(src), bst);
-#endif
+static int const_offset_span(struct cdc_zone_struct *self,
+			     const cdc_calendar_t *cal,
+			     cdc_calendar_t *start,
+			     cdc_calendar_t *end,
+			     cdc_calendar_t *offset)
+{
+  uint32_t system = cal->system;
+  int rv;
 
-  memset(offset, '\0', sizeof(cdc_calendar_t));
-      
-  if (bst)
-    {
-      // One hour ahead
-      offset->hour = 1;
-    }
+  rv = self->offset(self, offset, cal);
+  if (rv) { return rv; }
+
+  span_unbounded(start, INT_MIN, system);
+  span_unbounded(end, INT_MAX, system);
   return 0;
 }
 
-static int system_ukct_op(struct cdc_zone_struct *self,
-			 cdc_calendar_t *dest,
-			 const cdc_calendar_t *src,
-			 const cdc_calendar_t *offset,
-			 int op)
+static int chain_dispose(struct cdc_zone_struct *self)
 {
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-  cdc_calendar_t adj, diff, tgt, srcx;
+  cdc_zone_t *z = (cdc_zone_t *)self->handle;
   int rv;
 
-#if DEBUG_BST
-  printf("ukct_op: src = %s \n", dbg_pdate(src));
-#endif
+  rv = z->dispose(z);
+  free(z);
+  return rv;
+}
 
-  if (op == CDC_OP_ZONE_ADD)
-      // Then we shouldn't be worrying about zone offsets.
-      // Indeed we might be adding one ourselves...
-      memset(&diff, 0, sizeof(diff));
-  else {
-      rv = self->offset(self, &diff, src);
+static int system_lower_diff(struct cdc_zone_struct *self,
+			     cdc_interval_t *ivalp,
+			     const cdc_calendar_t *before,
+			     const cdc_calendar_t *after)
+{
+  cdc_calendar_t bl, al;
+  cdc_zone_t *z;
+  int rv;
+
+
+  rv = cdc_zone_lower(self, &bl, &z, before);
+  if (rv) { return rv; }
+
+  rv = cdc_zone_lower(self, &al, &z, after);
+  if (rv) { return rv; }
+
+#if DEBUG_LOWER
+  printf("system_lower_diff[] before = %s \n", dbg_pdate(before));
+  printf("system_lower_diff[] bl     = %s \n", dbg_pdate(&bl));
+
+  printf("system_lower_diff[] after   = %s \n", dbg_pdate(after));
+  printf("system_lower_diff[] al     = %s \n", dbg_pdate(&al));
+#endif
+
+  return z->diff(z, ivalp, &bl, &al);
+}
+
+
+/* -------------------- Gregorian TAI ---------------- */
+
+static int system_gtai_diff(struct cdc_zone_struct *self,
+			    cdc_interval_t *ivalp,
+			    const cdc_calendar_t *before,
+			    const cdc_calendar_t *after)
+{
+#if DEBUG_GTAI
+  printf("---gtai_diff()\n");
+#endif
+
+
+  if (before->system != after->system) { return CDC_ERR_SYSTEMS_DO_NOT_MATCH; }
+  if (before->system != CDC_SYSTEM_GREGORIAN_TAI) 
+    {
+      return CDC_ERR_NOT_MY_SYSTEM;
+    }
+
+  if (!diff_months_valid(before, after))
+  {
+      return CDC_ERR_INVALID_ARGUMENT;
+  }
+      
+
+  if (cdc_calendar_cmp(before, after) > 0)
+    {
+      int rv;
+      rv =  system_gtai_diff(self, ivalp, after, before);
       if (rv) { return rv; }
+      ivalp->s = -ivalp->s;
+      ivalp->ns = -ivalp->ns;
+
+      return rv;
+    }
+
+  // Bring the interval onto the stack for manipulation
+  // (also helps gcc to optimise this code)
+  
+  cdc_interval_t ival;
+  memcpy(&ival, ivalp, sizeof(cdc_interval_t));
+
+
+#if DEBUG_GTAI
+  printf("init: s = %"PRIu64" ns = %ld \n", 
+	 ival.s, ival.ns);
+#endif
+
+  // Whole days between the two dates, in closed form.
+  ival.s += SECONDS_PER_DAY * 
+    (days_from_civil(after->year, after->month, after->mday) - 
+     days_from_civil(before->year, before->month, before->mday));
+
+#if DEBUG_GTAI
+  printf("ival.s = %"PRIu64"\n", ival.s);
+#endif
+
+  {
+    int hrdiff = after->hour - before->hour;
+
+#if DEBUG_GTAI
+    printf("hrdiff = %d \n", hrdiff);
+#endif
+
+    ival.s += SECONDS_PER_HOUR * hrdiff;
   }
 
-  // We're actually going backward here, so ..
-  cdc_negate(&diff);
+  {
+    int mdiff = after->minute - before->minute;
 
-  memcpy(&srcx, src, sizeof(cdc_calendar_t));
-  srcx.system = utc->system;
+#if DEBUG_GTAI
+    printf("mdiff = %d \n", mdiff);
+#endif
+
+    ival.s += SECONDS_PER_MINUTE *mdiff;
+  }
+#if DEBUG_GTAI
+  printf("sdiff = %d \n", (after->second -before->second));
+#endif
+
+  ival.s += (after->second - before->second);
+  ival.ns = (after->ns - before->ns);
+  if (ival.ns < 0)
+    {
+      --ival.s;
+      ival.ns += ONE_BILLION;
+    }
   
-#if DEBUG_BST
-  printf("ukct_op: initial src offset = %s \n", dbg_pdate(&diff));
+  memcpy(ivalp, &ival, sizeof(cdc_interval_t));
+#if DEBUG_GTAI
+  printf("---end gtai_diff()\n");
+#endif
+
+
+  return 0;
+}
+
+
+static int system_gtai_offset(struct cdc_zone_struct *self,
+				  cdc_calendar_t *offset,
+			      const cdc_calendar_t *src)
+{
+  // Particularly easy ..
+  memset(offset, '\0', sizeof(cdc_calendar_t));
+
+  return 0;
+}
+
+static int system_gtai_op(struct cdc_zone_struct *self,
+			  cdc_calendar_t *dest,
+			  const cdc_calendar_t *src,
+			  const cdc_calendar_t *offset,
+			  int op)
+{
+  // And normalise .
+  int rv;
+
+  rv = cdc_simple_op(dest, src, offset, op);
+#if DEBUG_GTAI
+  printf("gtai_op: src                        = %s\n", dbg_pdate(src));
+  printf("gtai_op: offset                     = %s\n", dbg_pdate(offset));
+  printf("gtai_op: cdc_simple_op returns = %s\n", dbg_pdate(dest));
 #endif
 
+  if (rv) { return rv; }
 
-  rv = utc->op(utc, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD);
+  rv = gtai_normalise(dest);
   if (rv) { return rv; }
 
-#if DEBUG_BST
-  printf("ukct_op: adj = %s \n", dbg_pdate(&adj));
+#if DEBUG_GTAI
+  printf("gtai_op: normalised                = %s\n", dbg_pdate(dest));
 #endif
 
-  // Now we're in UTC.
-  adj.system = utc->system;
 
-#if DEBUG_BST
-  printf("ukct_op: -------- before utc->op ---- \n");
-#endif
+  return 0;
+
+}
+
+static int system_gtai_aux(struct cdc_zone_struct *self,
+			   const cdc_calendar_t *cal,
+			   cdc_calendar_aux_t *aux)
+{
+  // There is no DST in TAI
+  aux->is_dst = 0;
+
+  {
+    int yday = 0;
+    int i;
+    for (i = 0; i < cal->month; ++i)
+      {
+	yday += gregorian_months[i];
+	// Leap year correction
+	if (i == 1 && is_gregorian_leap_year(cal->year)) { ++yday; }
+      }
+    yday += cal->mday;
+
+    // We want our ydays to be zero-based.
+    aux->yday = yday -1;
+  }
+
+  // The century start day of week follows a 4,2,0,6 pattern. 17XX == 4 */
+  static const int cstart[] = { 4,2,0, 6};
+  static const int wday[] = { 0, 3, 3, 6, 1, 4, 6, 2, 5, 0, 3, 5 };
+  static const int leap_wday[] = { 6, 2, 3, 6, 1, 4, 6, 2, 5, 0, 3, 5 };
+  int dow;
+
+  // &3 is here to make sure the result is +ve.
+  int idx = ((cal->year / 100) - 17)&3;
+  int yoff = (cal->year % 100);
+
+  //printf("cstart[%d] = %d \n", 
+  //idx, cstart[idx]);
+  // printf("yoff = %d \n", cal->year%100);
+
+  // This calculation actually expects mday to be 1-based.
+  dow = cstart[idx] + yoff + (yoff / 4) + 
+    (is_gregorian_leap_year(cal->year) ? leap_wday[cal->month] : 
+     wday[cal->month]) + (cal->mday) ;
+  aux->wday = (dow % 7);
+
+  return 0;
+}
+
+static int system_gtai_epoch(struct cdc_zone_struct *self,
+			     cdc_calendar_t *cal)
+{
+  // The 'epoch' for TAI is, rather arbitrarily, 1 January 1958
+  cal->year = 1958;
+  cal->month = 0;
+  cal->mday = 1;
+  cal->hour = 0;
+  cal->minute = 0;
+  cal->second = 0;
+  cal->ns = 0;
+  cal->system = CDC_SYSTEM_GREGORIAN_TAI;
+  
+  return 0;
+}
+
+static int system_gtai_lower_zone(struct cdc_zone_struct *self,
+				  struct cdc_zone_struct **next)
+{
+  (*next) = NULL;
+  return 0;
+}
+
+/* ---------------------- UTC ---------------------- */
+
+#define UTC_LOOKUP_NR_ENTRIES \
+  ((int)(sizeof(utc_lookup_table)/sizeof(utc_lookup_entry_t)))
+
+/** A leap second table (utc_lookup_table, or one loaded with 
+ *  cdc_utc_load_leap_table()), compiled into linear keys so that we 
+ *  can binary search it without any calendar arithmetic.
+ */
+typedef struct utc_leap_index_struct
+{
+  //! Number of entries, including the sentinel at index 0.
+  int nr_entries;
+
+  //! The table this index was compiled from.
+  const utc_lookup_entry_t *entries;
+
+  //! entries[i].when, as UTC seconds since 1958-01-01 00:00:00.
+  int64_t *utc_when;
+
+  /** The TAI instant one second after entries[i].when; TAI times from
+   *  here on are offset by entries[i].utctai.
+   */
+  cdc_instant_t *tai_after;
+
+  //! Is entries[i] a (positive) leap second?
+  unsigned char *is_leap;
+
+  //! The file this index was loaded from; NULL for the built-in table.
+  const char *path;
+
+  //! Next on the list of retired indices.
+  struct utc_leap_index_struct *next_retired;
+
+} utc_leap_index_t;
+
+static int64_t s_utc_when[UTC_LOOKUP_NR_ENTRIES];
+static cdc_instant_t s_utc_tai_after[UTC_LOOKUP_NR_ENTRIES];
+static unsigned char s_utc_is_leap[UTC_LOOKUP_NR_ENTRIES];
+
+static utc_leap_index_t s_utc_builtin = 
+  {
+    0,
+    utc_lookup_table,
+    s_utc_when,
+    s_utc_tai_after,
+    s_utc_is_leap,
+    NULL,
+    NULL
+  };
+
+/* The leap second index is swapped RCU-style: readers take one
+ *  acquire load of s_utc_current per operation and use what they got
+ *  throughout, and writers publish a complete new index with a single
+ *  exchange. Since we can't tell when the last reader of an old index 
+ *  has finished with it, old indices are never freed; they're kept on 
+ *  s_utc_retired so that they're at least reachable. They're a few kB 
+ *  each and reloads are rare.
+ */
+#if defined(__GNUC__)
+#define ATOMIC_LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define ATOMIC_EXCHANGE(p, v)      __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define ATOMIC_CAS(p, e, v) \
+  __atomic_compare_exchange_n((p), (e), (v), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+// No atomics: single-threaded use only.
+#define ATOMIC_LOAD_ACQUIRE(p)     (*(p))
+#define ATOMIC_STORE_RELEASE(p, v) (*(p) = (v))
+#define ATOMIC_EXCHANGE(p, v)      atomic_exchange_idx((p), (v))
+#define ATOMIC_CAS(p, e, v) \
+  ((*(p) == *(e)) ? (*(p) = (v), 1) : (*(e) = *(p), 0))
+static inline utc_leap_index_t *atomic_exchange_idx(utc_leap_index_t **p, 
+						    utc_leap_index_t *v)
+{
+  utc_leap_index_t *old = *p; *p = v; return old;
+}
+#endif
+
+/* A thread waiting for another to finish filling something in gives
+ *  up the CPU each time round: on a loaded machine, the thread it's 
+ *  waiting for may be the one it's keeping off it.
+ */
+#if defined(__GNUC__) && !defined(_WIN32)
+#define ATOMIC_YIELD() sched_yield()
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ATOMIC_YIELD() __builtin_ia32_pause()
+#else
+// No atomics, so no other threads to wait for.
+#define ATOMIC_YIELD()
+#endif
+
+//! The index in use. NULL until the first UTC conversion.
+static utc_leap_index_t *s_utc_current = NULL;
+
+//! Indices which have been replaced, but may still have readers.
+static utc_leap_index_t *s_utc_retired = NULL;
+
+//! The built-in index (compiled and ready to use) or NULL.
+static utc_leap_index_t *s_utc_builtin_ready = NULL;
+
+//! Set by whichever thread gets to compile the built-in index.
+static utc_leap_index_t *s_utc_builtin_owner = NULL;
+
+/** UTC calendar time -> whole seconds since 1958-01-01 00:00:00, as 
+ *  if UTC were TAI. Leap seconds come out the same as the second after.
+ */
+static int64_t utc_seconds(const cdc_calendar_t *cal)
+{
+  return (SECONDS_PER_DAY * days_from_civil(cal->year, cal->month, cal->mday)) + 
+    ((int64_t)cal->hour * SECONDS_PER_HOUR) + 
+    ((int64_t)cal->minute * SECONDS_PER_MINUTE) + cal->second;
+}
+
+static void utc_index_compile(utc_leap_index_t *idx)
+{
+  int i;
+
+  for (i = 0; i < idx->nr_entries; ++i)
+    {
+      const utc_lookup_entry_t *e = &idx->entries[i];
+      cdc_instant_t when;
+      cdc_interval_t after;
+
+      idx->utc_when[i] = utc_seconds(&e->when);
+
+      // TAI = UTC - utctai, and we want the second after.
+      when.s = idx->utc_when[i]; when.ns = 0;
+      after.s = 1 - e->utctai.s; after.ns = -e->utctai.ns;
+      cdc_instant_add(&idx->tai_after[i], &when, &after);
+
+      idx->is_leap[i] = (i >= UTC_LOOKUP_MIN_LEAP_SECOND) &&
+	(cdc_interval_cmp(&idx->entries[i-1].utctai, &e->utctai) > 0);
+    }
+}
+
+/** Compile the built-in index, once. Threads which lose the race to 
+ *  do it wait for the winner, which only happens once per process.
+ */
+static utc_leap_index_t *utc_index_builtin(void)
+{
+  utc_leap_index_t *expected = NULL;
+
+  if (ATOMIC_LOAD_ACQUIRE(&s_utc_builtin_ready)) { return &s_utc_builtin; }
+
+  if (ATOMIC_CAS(&s_utc_builtin_owner, &expected, &s_utc_builtin))
+    {
+      s_utc_builtin.nr_entries = UTC_LOOKUP_NR_ENTRIES;
+      utc_index_compile(&s_utc_builtin);
+      ATOMIC_STORE_RELEASE(&s_utc_builtin_ready, &s_utc_builtin);
+    }
+  else
+    {
+      while (!ATOMIC_LOAD_ACQUIRE(&s_utc_builtin_ready)) { }
+    }
+  
+  return &s_utc_builtin;
+}
+
+/** The index to use for one conversion: call this once and use the 
+ *  result throughout, since a reload may replace it at any time.
+ */
+static const utc_leap_index_t *utc_index(void)
+{
+  utc_leap_index_t *idx = ATOMIC_LOAD_ACQUIRE(&s_utc_current);
+  utc_leap_index_t *expected = NULL;
+
+  if (idx) { return idx; }
+
+  // First use. If someone's loaded a table in the meantime, the CAS 
+  // fails and leaves theirs in place.
+  idx = utc_index_builtin();
+  if (!ATOMIC_CAS(&s_utc_current, &expected, idx))
+    {
+      idx = expected;
+    }
+  return idx;
+}
+
+/** Make 'idx' the index in use, retiring the old one. */
+static void utc_index_publish(utc_leap_index_t *idx)
+{
+  utc_leap_index_t *old = ATOMIC_EXCHANGE(&s_utc_current, idx);
+
+  if (old && old != &s_utc_builtin)
+    {
+      utc_leap_index_t *head = ATOMIC_LOAD_ACQUIRE(&s_utc_retired);
+
+      do
+	{
+	  old->next_retired = head;
+	}
+      while (!ATOMIC_CAS(&s_utc_retired, &head, old));
+    }
+}
+
+/** Do two indices describe the same table? */
+static int utc_index_same(const utc_leap_index_t *a, 
+			  const utc_leap_index_t *b)
+{
+  if (a->nr_entries != b->nr_entries) { return 0; }
+  if ((a->path == NULL) != (b->path == NULL)) { return 0; }
+  if (a->path && strcmp(a->path, b->path)) { return 0; }
+  return !memcmp(a->entries, b->entries, 
+		 a->nr_entries * sizeof(utc_lookup_entry_t));
+}
+
+/** Allocate an index, and a table for it to index, in one block so 
+ *  that a single free() disposes of both.
+ */
+static utc_leap_index_t *utc_index_new(int nr_entries,
+				       const utc_lookup_entry_t *entries,
+				       const char *path)
+{
+  utc_leap_index_t *idx;
+  utc_lookup_entry_t *e;
+  char *p;
+
+  // Everything but is_leap and path is a multiple of 8 bytes long, 
+  // so alignment takes care of itself.
+  p = (char *)malloc(sizeof(utc_leap_index_t) + 
+		     (nr_entries * (sizeof(utc_lookup_entry_t) + 
+				    sizeof(int64_t) + 
+				    sizeof(cdc_instant_t) + 1)) + 
+		     strlen(path) + 1);
+  if (!p) { return NULL; }
+
+  idx = (utc_leap_index_t *)p;
+  p += sizeof(utc_leap_index_t);
+  e = (utc_lookup_entry_t *)p;
+  p += nr_entries * sizeof(utc_lookup_entry_t);
+  idx->utc_when = (int64_t *)p;
+  p += nr_entries * sizeof(int64_t);
+  idx->tai_after = (cdc_instant_t *)p;
+  p += nr_entries * sizeof(cdc_instant_t);
+  idx->is_leap = (unsigned char *)p;
+  p += nr_entries;
+  strcpy(p, path);
+  idx->path = p;
+  idx->next_retired = NULL;
+
+  memcpy(e, entries, nr_entries * sizeof(utc_lookup_entry_t));
+  idx->entries = e;
+  idx->nr_entries = nr_entries;
+  utc_index_compile(idx);
+  return idx;
+}
+
+// Seconds from the NTP epoch (1900-01-01) to the TAI epoch (1958-01-01).
+#define NTP_TO_TAI_EPOCH INT64_C(1830297600)
+
+int cdc_utc_load_leap_table(const char *path)
+{
+  FILE *fp;
+  char line[256];
+  utc_lookup_entry_t *entries;
+  utc_leap_index_t *idx;
+  int nr_entries = UTC_LOOKUP_MIN_LEAP_SECOND;
+  int max_entries = 64;
+  int nr_lines = 0;
+  int continued = 0;
+  int64_t last_when = 0;
+  long last_dtai = 0;
+  int rv = 0;
+
+  if (!path)
+    {
+      // Back to the built-in table.
+      utc_index_publish(utc_index_builtin());
+      return 0;
+    }
+
+  fp = fopen(path, "r");
+  if (!fp) { return CDC_ERR_NO_SUCH_FILE; }
+
+  entries = (utc_lookup_entry_t *)malloc(max_entries * sizeof(utc_lookup_entry_t));
+  if (!entries) { fclose(fp); return CDC_ERR_INIT_FAILED; }
+
+  // The sentinel and the pre-1972 sync points don't appear in the 
+  // file, so they come from the built-in table.
+  memcpy(entries, utc_lookup_table, 
+	 UTC_LOOKUP_MIN_LEAP_SECOND * sizeof(utc_lookup_entry_t));
+
+  while (fgets(line, sizeof(line), fp))
+    {
+      long long ntp;
+      long dtai;
+      int64_t when;
+      utc_lookup_entry_t *e;
+      int skip = continued;
+
+      // Skip the tails of lines too long for our buffer: only comments 
+      // are ever that long.
+      continued = (strchr(line, '\n') == NULL);
+      if (skip) { continue; }
+
+      // Comments (including the #$ update time, #@ expiry and #h hash)
+      if (line[0] == '#') { continue; }
+      if (sscanf(line, "%lld %ld", &ntp, &dtai) != 2)
+	{
+	  // Blank lines are fine; anything else isn't.
+	  const char *c = line;
+	  while (isspace((unsigned char)*c)) { ++c; }
+	  if (*c) { rv = CDC_ERR_BAD_FORMAT; break; }
+	  continue;
+	}
+
+      // Each line is the UTC midnight at which TAI - UTC becomes dtai.
+      when = (int64_t)ntp - NTP_TO_TAI_EPOCH;
+      if (floor_mod(when, SECONDS_PER_DAY) || 
+	  (nr_lines && when <= last_when) ||
+	  (!nr_lines && when <= (SECONDS_PER_DAY * 
+				 days_from_civil(1961, CDC_JANUARY, 1))))
+	{
+	  rv = CDC_ERR_BAD_FORMAT;
+	  break;
+	}
+
+      if (!nr_lines)
+	{
+	  // The first line is where leap seconds start - replace the 
+	  // last built-in sync point with it.
+	  cdc_instant_t at;
+
+	  e = &entries[nr_entries - 1];
+	  memset(e, '\0', sizeof(utc_lookup_entry_t));
+	  at.s = when; at.ns = 0;
+	  rv = instant_to_tai(&e->when, &at);
+	}
+      else
+	{
+	  // Leap seconds, which we record as the second before them.
+	  cdc_instant_t before;
+
+	  // There has never been a -ve leap second and we can't 
+	  // represent one (or two leap seconds at once).
+	  if (dtai != last_dtai + 1)
+	    {
+	      rv = CDC_ERR_BAD_FORMAT;
+	      break;
+	    }
+
+	  if (nr_entries == max_entries)
+	    {
+	      utc_lookup_entry_t *n;
+
+	      max_entries *= 2;
+	      n = (utc_lookup_entry_t *)realloc(entries, 
+						max_entries * sizeof(utc_lookup_entry_t));
+	      if (!n) { rv = CDC_ERR_INIT_FAILED; break; }
+	      entries = n;
+	    }
+
+	  e = &entries[nr_entries++];
+	  memset(e, '\0', sizeof(utc_lookup_entry_t));
+	  before.s = when - 1; before.ns = 0;
+	  rv = instant_to_tai(&e->when, &before);
+	}
+      if (rv) { break; }
+
+      // instant_to_tai() gave us TAI; these are UTC times.
+      e->when.system = CDC_SYSTEM_UTC;
+      e->utctai.s = -dtai;
+      e->utctai.ns = 0;
+
+      ++nr_lines;
+      last_when = when;
+      last_dtai = dtai;
+    }
+
+  if (!rv && ferror(fp)) { rv = CDC_ERR_NO_SUCH_FILE; }
+  fclose(fp);
+
+  // No data at all is as wrong as a malformed line.
+  if (!rv && !nr_lines) 
+    { 
+      rv = CDC_ERR_BAD_FORMAT;
+    }
+  
+  if (!rv)
+    {
+      idx = utc_index_new(nr_entries, entries, path);
+      if (!idx) { rv = CDC_ERR_INIT_FAILED; }
+    }
+  free(entries);
+  if (rv) { return rv; }
+
+  // Periodic reloads mostly find nothing has changed: don't retire 
+  // (and so leak) an index for nothing.
+  if (utc_index_same(idx, utc_index()))
+    {
+      free(idx);
+      return 0;
+    }
+
+  utc_index_publish(idx);
+  return 0;
+}
+
+int cdc_utc_reload_leap_table(void)
+{
+  const utc_leap_index_t *idx = utc_index();
+
+  // Retired indices are never freed, so idx->path stays valid even
+  // if someone else reloads under our feet.
+  if (!idx->path) { return 0; }
+  return cdc_utc_load_leap_table(idx->path);
+}
+
+/** Find the first entry in idx (after the sentinel) whose UTC key is
+ *  >= key, or idx->nr_entries if there isn't one.
+ *
+ *  If cursor is not NULL, it's the answer from last time, which we try
+ *  first, and it gets this answer. Neighbouring times in a batch are 
+ *  mostly between the same pair of entries.
+ */
+static int utc_index_search_utc(const utc_leap_index_t *idx, int64_t key,
+				int *cursor)
+{
+  int lo = 1, hi = idx->nr_entries;
+
+  if (cursor)
+    {
+      int c = (*cursor);
+      if (c >= lo && c <= hi && 
+	  (c == hi || idx->utc_when[c] >= key) &&
+	  (c == lo || idx->utc_when[c - 1] < key))
+	{
+	  return c;
+	}
+    }
+
+  while (lo < hi)
+    {
+      int mid = lo + ((hi - lo) / 2);
+      if (idx->utc_when[mid] < key) { lo = mid + 1; } else { hi = mid; }
+    }
+
+  if (cursor) { (*cursor) = lo; }
+  return lo;
+}
+
+/** Find the first entry in idx (after the sentinel) whose TAI key is
+ *  > key, or idx->nr_entries if there isn't one. cursor is as for 
+ *  utc_index_search_utc().
+ */
+static int utc_index_search_tai(const utc_leap_index_t *idx, 
+				const cdc_instant_t *key,
+				int *cursor)
+{
+  int lo = 1, hi = idx->nr_entries;
+
+  if (cursor)
+    {
+      int c = (*cursor);
+      if (c >= lo && c <= hi && 
+	  (c == hi || cdc_instant_cmp(&idx->tai_after[c], key) > 0) &&
+	  (c == lo || cdc_instant_cmp(&idx->tai_after[c - 1], key) <= 0))
+	{
+	  return c;
+	}
+    }
+
+  while (lo < hi)
+    {
+      int mid = lo + ((hi - lo) / 2);
+      if (cdc_instant_cmp(&idx->tai_after[mid], key) <= 0) 
+	{ 
+	  lo = mid + 1; 
+	} 
+      else 
+	{ 
+	  hi = mid; 
+	}
+    }
+
+  if (cursor) { (*cursor) = lo; }
+  return lo;
+}
+
+/** Find the index of the entry in idx whose utctai applies to src,
+ *  which may be in UTC or TAI. cursor (which may be NULL) is as for 
+ *  utc_index_search_utc().
+ *
+ * @return 0 on success, CDC_ERR_NOT_MY_SYSTEM if src is in neither.
+ */
+static int utc_index_lookup(const utc_leap_index_t *idx,
+			    int *entry,
+			    const cdc_calendar_t *src,
+			    int *cursor)
+{
+  int i;
+
+  if (src->system == CDC_SYSTEM_GREGORIAN_TAI)
+    {
+      // The source is in TAI: the last entry we're at least a second
+      // past applies.
+      cdc_instant_t t;
+
+      instant_from_tai(&t, src);
+      i = utc_index_search_tai(idx, &t, cursor);
+      (*entry) = i - 1;
+    }
+  else if (src->system == CDC_SYSTEM_UTC)
+    {
+      // Compare whole seconds, so that we land exactly on an entry
+      // when we're in the second it describes. A leap second is 
+      // compared as the second before it.
+      int current_leap = (src->second == 60);
+      int64_t key = utc_seconds(src) - current_leap;
+
+      i = utc_index_search_utc(idx, key, cursor);
+      (*entry) = i - 1;
+
+      if (i < idx->nr_entries && idx->utc_when[i] == key)
+	{
+	  // There is a leap second immediately following. The 
+	  //  value is < current, we're going forward, else we're going back.
+	  //
+	  // Entries below UTC_LOOKUP_MIN_LEAP_SECOND are sync points
+	  // and not leap seconds per se.
+	  //
+	  // If we landed on a leap second, there isn't one following. This is it.
+	  int is_leap_second = !current_leap && idx->is_leap[i];
+
+	  // If we'd hit a leap second or we were a few nanoseconds ahead, 
+	  // it's this entry that applies, not the last one.
+	  if (!is_leap_second && src->ns)
+	    {
+	      (*entry) = i;
+	    }
+	}
+    }
+  else
+    {
+      return CDC_ERR_NOT_MY_SYSTEM;
+    }
+
+#if DEBUG_UTC
+  printf("utc_index_lookup() %s -> entry %d \n", dbg_pdate(src), (*entry));
+#endif
+
+  return 0;
+}
+
+/** If r (which must be normalised, with ns = 0) is the second just
+ *  before a leap second, return the index of that leap second's
+ *  entry; otherwise return 0.
+ */
+static int utc_index_find_leap(const utc_leap_index_t *idx,
+			       const cdc_calendar_t *r,
+			       int *cursor)
+{
+  int64_t key;
+  int i;
+
+  if (r->system != CDC_SYSTEM_UTC) { return 0; }
+
+  key = utc_seconds(r);
+  i = utc_index_search_utc(idx, key, cursor);
+  if (i < UTC_LOOKUP_MIN_LEAP_SECOND || i >= idx->nr_entries ||
+      idx->utc_when[i] != key)
+    {
+      return 0;
+    }
+  return i;
+}
+
+static void utc_offset_from_entry(cdc_calendar_t *dest,
+				  const utc_leap_index_t *idx,
+				  int entry)
+{
+  // Right. If we're going to UTC, add the correction. If to
+  // TAI, subtract it.
+  memset(dest, '\0', sizeof(cdc_calendar_t));
+
+  dest->second = (int)idx->entries[entry].utctai.s;
+  dest->ns = idx->entries[entry].utctai.ns; 
+  dest->system = CDC_SYSTEM_OFFSET;
+#if DEBUG_UTC
+  printf("utc_offset: dest = %s\n", dbg_pdate(dest));
+#endif
+}
+
+static int system_utc_offset(struct cdc_zone_struct *self,
+			     cdc_calendar_t *dest,
+			     const cdc_calendar_t *src)
+{
+  return utc_offset(self, dest, src, NULL);
+}
+
+/** system_utc_offset(), with a leap table cursor (which may be NULL)
+ *  as for utc_index_search_utc().
+ */
+static int utc_offset(struct cdc_zone_struct *self,
+		      cdc_calendar_t *dest,
+		      const cdc_calendar_t *src,
+		      int *cursor)
+{
+  const utc_leap_index_t *idx = utc_index();
+  int entry;
+  int rv;
+
+  rv = utc_index_lookup(idx, &entry, src, cursor);
+  if (rv) { return rv; }
+
+  utc_offset_from_entry(dest, idx, entry);
+  return 0;
+}
+
+/** Lower a UTC time straight to an instant, as lowering it to TAI 
+ *  and calling instant_from_tai() would (a TAI zone add is linear in
+ *  the fields). cursor is as for utc_index_search_utc().
+ */
+static int utc_to_instant(cdc_instant_t *out,
+			  const cdc_calendar_t *src,
+			  int *cursor)
+{
+  const utc_leap_index_t *idx = utc_index();
+  cdc_interval_t utctai;
+  int entry;
+  int rv;
+
+  rv = utc_index_lookup(idx, &entry, src, cursor);
+  if (rv) { return rv; }
+
+  instant_from_tai(out, src);
+  utctai.s = -idx->entries[entry].utctai.s;
+  utctai.ns = -idx->entries[entry].utctai.ns;
+  return cdc_instant_add(out, out, &utctai);
+}
+
+static int system_utc_op(struct cdc_zone_struct *self,
+			 cdc_calendar_t *dest,
+			 const cdc_calendar_t *src,
+			 const cdc_calendar_t *offset,
+			 int op)
+{
+  return utc_op(self, dest, src, offset, op, NULL);
+}
+
+/** system_utc_op(), with a leap table cursor (which may be NULL) as 
+ *  for utc_index_search_utc().
+ */
+static int utc_op(struct cdc_zone_struct *self,
+		  cdc_calendar_t *dest,
+		  const cdc_calendar_t *src,
+		  const cdc_calendar_t *offset,
+		  int op,
+		  int *cursor)
+{
+  cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
+  const utc_leap_index_t *idx = utc_index();
+  int rv ;
+
+  // Right. To perform a fieldwise add on a UTC time, we:
+  //
+  //  - Add src to offset in TAI -> tdest.
+  //  - If no leap second (or sync point) lies between src and tdest,
+  //      that's the answer.
+  //  - Otherwise, add the difference between the offsets for src and
+  //      tdest to tdest, in TAI.
+  //  - If the result is just before a leap second, it's that leap 
+  //      second.
+
+  // OK. First off, work out the offset for the source.
+  cdc_calendar_t src_diff, dst_diff;
+  int complex = 0;
+  cdc_calendar_t dst_value, tmp;
+  int do_ls = 1;
+
+  if (op == CDC_OP_COMPLEX_ADD)
+    {
+      op = CDC_OP_SIMPLE_ADD;
+      ++complex;
+    }
+
+  if (op == CDC_OP_ZONE_ADD)
+    {
+      // This is a zone addition and therefore particularly easy.
+      rv = gtai->op(gtai, &tmp, src, offset, CDC_OP_ZONE_ADD);
+#if DEBUG_UTC
+      printf("utc_zone_op (for zone addition) rv = %d result = %s\n", rv, dbg_pdate(&tmp));
+#endif
+
+      if (rv) { return rv; }
+    }
+  else
+    {
+      int src_entry, dst_entry;
+
+      rv = utc_index_lookup(idx, &src_entry, src, cursor);
+      if (rv < 0) { return rv; }
+            
+      rv = gtai->op(gtai, &dst_value, src, offset, op);
+      if (rv < 0) { return rv; }
+      
+      // Now the destination.
+      rv = utc_index_lookup(idx, &dst_entry, &dst_value, cursor);
+      if (rv < 0) { return rv; }
+
+      // If there's no leap second between source and destination, 
+      // we can just return the result.
+      if (src_entry == dst_entry)
+	{
+	  memcpy(dest, &dst_value, sizeof(cdc_calendar_t));
+	  return 0;
+	}
+
+      utc_offset_from_entry(&src_diff, idx, src_entry);
+      utc_offset_from_entry(&dst_diff, idx, dst_entry);
+
+#if DEBUG_UTC
+      printf("utc_op:  src_diff         = %s \n", dbg_pdate(&src_diff));
+      printf("utc_op:  dst_value        = %s \n", dbg_pdate(&dst_value));
+      printf("utc_op:  dst_diff         = %s \n", dbg_pdate(&dst_diff));
+#endif
+      
+      // Otherwise, the actual offset is (dst - src) + offset, knocked down by 
+      // offset
+      rv = cdc_simple_op(&dst_diff, &dst_diff, &src_diff, CDC_OP_SUBTRACT);
+      if (rv) { return rv; }
+      if (complex)
+	{
+	  do_knockdown(&dst_diff, offset, &do_ls);
+	}
+      
+      rv = gtai->op(gtai, &tmp, &dst_value, &dst_diff, op);
+      if (rv < 0) { return rv; }
+#if DEBUG_UTC
+      printf("-- utc_zone_op: Came up with %s \n", dbg_pdate(&tmp));
+#endif
+
+    }
+  
+  // By definition, tmp is now either a leap second or not. Note that we 
+  // didn't know if it was a leap second in the previous step because the
+  // leap seconds between two widely spaced dates will bring dates calculated
+  // as e.g. 1980-01-01 00:00:02 down to 23:59:59 .
+  //
+  if (do_ls)
+  {
+    cdc_calendar_t one_second, r;
+    long int saved_ns;
+
+    memset(&one_second, '\0', sizeof(cdc_calendar_t));
+
+    // For a zone addition, there is no destination value and we've therefore
+    // ended up on 'the wrong side' of a leap second.
+    if (op == CDC_OP_ZONE_ADD)
+      {
+	one_second.second = -1; 
+      }
+    else
+      {
+	one_second.second = 0;
+      }
+
+    rv = gtai->op(gtai, &r, &tmp, &one_second, CDC_OP_SIMPLE_ADD);
+    if (rv) { return rv; }
+
+    saved_ns = r.ns; r.ns = 0;
+
+#if DEBUG_UTC
+    printf("Searching for leap second after: %s \n", dbg_pdate(&r));
+#endif
+
+    if (utc_index_find_leap(idx, &r, cursor))
+      {
+	// This is the leap second just after the calculated time.
+	++r.second;
+	r.ns = saved_ns; // Restore nanoseconds.
+	memcpy(dest, &r, sizeof(cdc_calendar_t));
+#if DEBUG_UTC
+	printf("result was leap second : %s\n", 
+	       dbg_pdate(dest));
+#endif
+
+	return 0;
+      }
+  }
+
+  // Not a leap second.
+  memcpy(dest, &tmp, sizeof(cdc_calendar_t));
+#if DEBUG_UTC
+  printf("result was not leap second: %s \n", 
+	 dbg_pdate(dest));
+#endif
+
+  return 0;
+}
+
+static int system_utc_aux(struct cdc_zone_struct *self,
+			  const cdc_calendar_t *calc,
+			  cdc_calendar_aux_t *aux)
+{
+  // Same as for the underlying calendar.
+  cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
+
+  return gtai->aux(gtai, calc, aux);
+}
+
+static int system_utc_epoch(struct cdc_zone_struct *self,
+			    cdc_calendar_t *aux)
+{
+  // cdc_zone_t *gtai = (cdc_zone_t *)self->handle;
+
+  // The UTC epoch is 'properly' in 1961, but 1972 has the advantage
+  // that it was when the UTC and TAI seconds harmonised.
+  static const cdc_calendar_t epoch = 
+    { 1972, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC };
+      
+  memcpy(aux, &epoch, sizeof(cdc_calendar_t));
+  return 0;
+}
+
+static int utc_init(struct cdc_zone_struct *self,
+		    int arg_i, void *arg_n)
+{
+  self->handle = (void *)arg_n;
+  return 0;
+}
+
+
+static int system_utc_lower_zone(struct cdc_zone_struct *self,
+				 struct cdc_zone_struct **next)
+{
+  (*next) = (struct cdc_zone_struct *)(self->handle);
+  return 0;
+}
+
+/** The UTC time at which the offset for entry i of idx starts to 
+ *  apply: just after its 'when', or for a leap second, just after 
+ *  23:59:60.0 (see utc_index_lookup()).
+ */
+static void utc_span_edge(cdc_calendar_t *cal, const utc_leap_index_t *idx, 
+			  int i)
+{
+  memcpy(cal, &idx->entries[i].when, sizeof(cdc_calendar_t));
+  if (idx->is_leap[i]) { cal->second = 60; }
+  cal->ns = 1;
+  cal->system = CDC_SYSTEM_UTC;
+  cal->flags = 0;
+}
+
+static int system_utc_span(struct cdc_zone_struct *self,
+			   const cdc_calendar_t *cal,
+			   cdc_calendar_t *start,
+			   cdc_calendar_t *end,
+			   cdc_calendar_t *offset)
+{
+  const utc_leap_index_t *idx = utc_index();
+  int entry;
+  int rv;
+
+  rv = utc_index_lookup(idx, &entry, cal, NULL);
+  if (rv) { return rv; }
+  utc_offset_from_entry(offset, idx, entry);
+
+  if (cal->system == CDC_SYSTEM_GREGORIAN_TAI)
+    {
+      // Here, things are simple.
+      if (entry < 1) 
+	{ 
+	  span_unbounded(start, INT_MIN, cal->system);
+	}
+      else
+	{
+	  instant_to_tai(start, &idx->tai_after[entry]);
+	}
+
+      if (entry + 1 >= idx->nr_entries)
+	{
+	  span_unbounded(end, INT_MAX, cal->system);
+	}
+      else
+	{
+	  instant_to_tai(end, &idx->tai_after[entry + 1]);
+	}
+      return 0;
+    }
+
+  if (entry < 1) 
+    { 
+      span_unbounded(start, INT_MIN, cal->system); 
+    }
+  else
+    {
+      utc_span_edge(start, idx, entry);
+    }
+
+  if (entry + 1 >= idx->nr_entries)
+    {
+      span_unbounded(end, INT_MAX, cal->system);
+    }
+  else
+    {
+      utc_span_edge(end, idx, entry + 1);
+    }
+  return 0;
+}
+
+/* -------------------------------- UTC Plus --------------------------- */
+
+static int utc_plus_init(struct cdc_zone_struct *self, int arg_i, void *arg_n)
+{
+  self->handle = (void *)arg_n;
+  return 0;
+}
+
+static int system_utcplus_offset(struct cdc_zone_struct *self,
+				 cdc_calendar_t *dest,
+				 const cdc_calendar_t *src)
+{
+  // This is a straightforward offset from UTC. Leap seconds therefore
+  // occur at times other than 23:59:59 .. 
+  int mins = UTCPLUS_SYSTEM_TO_MINUTES(self->system);
+
+  memset(dest, '\0', sizeof(cdc_calendar_t));
+  dest->hour = (mins/60);
+  dest->minute = (mins % 60);
+  
+  return 0;
+}
+
+static int system_utcplus_aux(struct cdc_zone_struct *self,
+			      const cdc_calendar_t *calc,
+			      cdc_calendar_aux_t *aux)
+{
+
+  // Works exactly the same way as UTC does.
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+
+  return utc->aux(utc, calc, aux);
+}
+
+
+
+static int system_utcplus_op(struct cdc_zone_struct *self,
+			     cdc_calendar_t *dest,
+			     const cdc_calendar_t *src,
+			     const cdc_calendar_t *offset,
+			     int op)
+{
+  return utcplus_op(self, dest, src, offset, op, NULL);
+}
+
+/** system_utcplus_op(), passing zc (which may be NULL) on to UTC. */
+static int utcplus_op(struct cdc_zone_struct *self,
+		      cdc_calendar_t *dest,
+		      const cdc_calendar_t *src,
+		      const cdc_calendar_t *offset,
+		      int op,
+		      zone_cursor_t *zc)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  
+  // This is actually pretty civilised. For all operations, we first
+  // subtract the relevant number of hours and minutes. Then we perform
+  // the operation. Then we add the hours and minutes again. Because
+  // these are offset additions, they don't change the leap second 
+  // indicator and because they are strictly reversible, leap seconds
+  // always end up 'where they were generated' in UTC times.
+  
+  cdc_calendar_t adj, diff, tgt, srcx;
+  int rv;
+  int mins = UTCPLUS_SYSTEM_TO_MINUTES(self->system);
+
+  memset(&diff, '\0', sizeof(cdc_calendar_t));
+  diff.hour  = -(mins/ 60);
+  diff.minute = -(mins % 60);
+
+  memcpy(&srcx, src, sizeof(cdc_calendar_t));
+  srcx.system = utc->system;
+
+#if DEBUG_UTCPLUS
+  printf("utcplus_op: src = %s\n", dbg_pdate(src));
+#endif
+
+  rv = zone_cursor_op(utc, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD, zc);
+  if (rv) { return rv; }
+  
+#if DEBUG_UTCPLUS
+  printf("utcplus_op: adj = %s \n", dbg_pdate(&adj));
+#endif
+
+
+  // Now perform whatever operation was originally required.
+  rv = zone_cursor_op(utc, &tgt, &adj, offset, op, zc);
+  if (rv) { return rv; }
+
+  // And adjust back.
+  
+  diff.hour = (mins/60);
+  diff.minute = (mins%60);
+  
+  {
+    int ls = 0;
+
+    if (tgt.second == 60)
+      {
+	// Leap second! Pull it around . 
+	ls =1;
+	--tgt.second;
+      }
+    
+
+#if DEBUG_UTCPLUS
+    printf("utcplus_op: tgt = %s \n", dbg_pdate(&tgt));
+#endif
+
+    rv = zone_cursor_op(utc, dest, &tgt, &diff, CDC_OP_COMPLEX_ADD, zc);
+    if (rv) { return rv; }
+    
+    if (ls) { ++dest->second; }
+  }
+  dest->system = self->system;
+
+#if DEBUG_UTCPLUS
+  printf("utcplus: dest = %s\n", dbg_pdate(dest));
+#endif
+
+
+  return 0;
+}
+
+int system_utcplus_epoch(struct cdc_zone_struct *self,
+			 cdc_calendar_t *aux)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  return utc->epoch(self, aux);
+}
+
+int system_utcplus_lower_zone(struct cdc_zone_struct *self,
+			      struct cdc_zone_struct **next)
+{
+  (*next) = (struct cdc_zone_struct *)(self->handle);
+  return 0;
+}
+
+
+
+#if DEBUG_ANY
+static const char *dbg_pdate(const cdc_calendar_t *cal)
+{
+  static char buf[128];
+  cdc_calendar_sprintf(buf, 128, cal);
+  return buf;
+}
+#endif
+
+/* ---------------- British Summer Time ------------------- */
+
+
+/* BST: Applied to any other time zone.
+ *
+ * From <http://www.direct.gov.uk/en/Governmentcitizensandrights/LivingintheUK/DG_073741>
+ *
+ *  - In spring, the clocks go forward 1h at 0100 GMT on the last Sunday in March.
+ *  - In autumn, the clocks go back 1h at 0200 BST on the last Sunday in October.
+ */
+
+static int is_bst(struct cdc_zone_struct *z, const  cdc_calendar_t *cal,
+		  zone_cursor_t *zc);
+
+/** The last Sundays of March and October, cached per year. Each slot 
+ *  packs the year with both days of the month so that it's read and 
+ *  written in one go: a slot which doesn't hold the year we want is 
+ *  just a miss.
+ */
+#define BST_CACHE_SIZE 64
+
+#define BST_PACK(year, march, october) \
+  ((((uint64_t)(uint32_t)(year)) << 32) | ((uint64_t)(march) << 16) | \
+   ((uint64_t)(october) << 8) | 1)
+#define BST_YEAR(slot)    ((int)(uint32_t)((slot) >> 32))
+#define BST_MARCH(slot)   ((int)(((slot) >> 16) & 0xff))
+#define BST_OCTOBER(slot) ((int)(((slot) >> 8) & 0xff))
+
+static uint64_t s_bst_cache[BST_CACHE_SIZE];
+
+/** Does 'zone' get its days of the week from system_gtai_aux()? If 
+ *  so, we know which days are Sundays without asking it.
+ */
+static int zone_has_gtai_aux(cdc_zone_t *zone)
+{
+  while (zone)
+    {
+      if (zone->aux == system_gtai_aux) { return 1; }
+      if (zone->aux != system_utc_aux && 
+	  zone->aux != system_utcplus_aux) { return 0; }
+      // Both of which keep the zone below them in their handle.
+      zone = (cdc_zone_t *)zone->handle;
+    }
+  return 0;
+}
+
+/** Find the days of the month of the last Sundays in March and 
+ *  October of 'year'.
+ *
+ * @return 0 on success, < 0 if you'll have to work it out the hard way.
+ */
+static int bst_last_sundays(int *march, int *october, int year)
+{
+  uint64_t *slot = &s_bst_cache[year & (BST_CACHE_SIZE - 1)];
+  uint64_t packed = ATOMIC_LOAD_ACQUIRE(slot);
+  cdc_calendar_t cal;
+  cdc_calendar_aux_t aux;
+
+  if (!packed || BST_YEAR(packed) != year)
+    {
+      memset(&cal, '\0', sizeof(cdc_calendar_t));
+      cal.year = year; cal.mday = 25;
+
+      // system_gtai_aux()'s weekdays go -ve for some years, and then 
+      // is_bst() does odd things which we'd rather not copy.
+      cal.month = CDC_MARCH;
+      system_gtai_aux(NULL, &cal, &aux);
+      if (aux.wday < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+      cal.month = CDC_OCTOBER;
+      system_gtai_aux(NULL, &cal, &aux);
+      if (aux.wday < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+
+      // Both months have 31 days; the last Sunday is 31 - wday(31st).
+      cal.mday = 31;
+      cal.month = CDC_MARCH;
+      system_gtai_aux(NULL, &cal, &aux);
+      packed = aux.wday;
+      cal.month = CDC_OCTOBER;
+      system_gtai_aux(NULL, &cal, &aux);
+      packed = BST_PACK(year, 31 - (int)packed, 31 - aux.wday);
+
+      ATOMIC_STORE_RELEASE(slot, packed);
+    }
+  
+  (*march) = BST_MARCH(packed);
+  (*october) = BST_OCTOBER(packed);
+  return 0;
+}
+
+
+static int ukct_init(struct cdc_zone_struct *self,
+	     int iarg, void *parg)
+{
+  self->handle = parg;
+  return 0;
+}
+
+
+static int system_ukct_offset(struct cdc_zone_struct *self,
+			     cdc_calendar_t *offset,
+			     const cdc_calendar_t *src)
+{
+  return ukct_offset(self, offset, src, NULL);
+}
+
+/** system_ukct_offset(), using (and updating) zc if it's not NULL. */
+static int ukct_offset(struct cdc_zone_struct *self,
+		       cdc_calendar_t *offset,
+		       const cdc_calendar_t *src,
+		       zone_cursor_t *zc)
+{
+  // Is it after the last Sunday in march?
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  int bst = is_bst(utc, src, zc);
+  if (bst < 0) { return bst; }
+  
+
+#if DEBUG_BST
+  printf("system_ukct_offset:  %s is_bst? %d \n",
+	 dbg_pdate(src), bst);
+#endif
+
+  memset(offset, '\0', sizeof(cdc_calendar_t));
+      
+  if (bst)
+    {
+      // One hour ahead
+      offset->hour = 1;
+    }
+  return 0;
+}
+
+/** Apply a UK offset 'diff' (as from system_ukct_offset(), possibly 
+ *  negated) to 'cal' in place, if that's the same as a complex add 
+ *  of it in 'utc'. It is when cal is normalised and stays well clear
+ *  of midnight, since leap seconds and UTC sync points all happen at
+ *  midnight and everything else is just hour arithmetic.
+ *
+ * @return 1 if we did it, 0 if you'll have to ask utc->op().
+ */
+static int ukct_shift(const cdc_zone_t *utc, cdc_calendar_t *cal,
+		      const cdc_calendar_t *diff)
+{
+  int hour = cal->hour + diff->hour;
+  int mdays;
+
+  if (utc->op != system_utc_op) { return 0; }
+  if (diff->year || diff->month || diff->mday || diff->minute || 
+      diff->second || diff->ns) { return 0; }
+
+  if (cal->month < CDC_JANUARY || cal->month > CDC_DECEMBER) { return 0; }
+  mdays = gregorian_months[cal->month] + 
+    ((cal->month == CDC_FEBRUARY && is_gregorian_leap_year(cal->year)) ? 1 : 0);
+
+  if (cal->mday < 1 || cal->mday > mdays ||
+      cal->hour < 1 || cal->hour >= HOURS_PER_DAY - 1 ||
+      hour < 1 || hour >= HOURS_PER_DAY - 1 ||
+      cal->minute < 0 || cal->minute >= MINUTES_PER_HOUR || 
+      cal->second < 0 || cal->second >= SECONDS_PER_MINUTE ||
+      cal->ns < 0 || cal->ns >= ONE_BILLION)
+    {
+      return 0;
+    }
+
+  cal->hour = hour;
+  return 1;
+}
+
+static int system_ukct_op(struct cdc_zone_struct *self,
+			 cdc_calendar_t *dest,
+			 const cdc_calendar_t *src,
+			 const cdc_calendar_t *offset,
+			 int op)
+{
+  return ukct_op(self, dest, src, offset, op, NULL);
+}
+
+/** system_ukct_op(), using (and updating) zc if it's not NULL. */
+static int ukct_op(struct cdc_zone_struct *self,
+		   cdc_calendar_t *dest,
+		   const cdc_calendar_t *src,
+		   const cdc_calendar_t *offset,
+		   int op,
+		   zone_cursor_t *zc)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  cdc_calendar_t adj, diff, tgt, srcx;
+  int rv;
+
+#if DEBUG_BST
+  printf("ukct_op: src = %s \n", dbg_pdate(src));
+#endif
+
+  if (op == CDC_OP_ZONE_ADD)
+      // Then we shouldn't be worrying about zone offsets.
+      // Indeed we might be adding one ourselves...
+      memset(&diff, 0, sizeof(diff));
+  else {
+      rv = ukct_offset(self, &diff, src, zc);
+      if (rv) { return rv; }
+  }
+
+  // We're actually going backward here, so ..
+  cdc_negate(&diff);
+
+  memcpy(&srcx, src, sizeof(cdc_calendar_t));
+  srcx.system = utc->system;
+  
+#if DEBUG_BST
+  printf("ukct_op: initial src offset = %s \n", dbg_pdate(&diff));
+#endif
+
+
+  // Most of the time, we can just move the hour.
+  memcpy(&adj, &srcx, sizeof(cdc_calendar_t));
+  if (!ukct_shift(utc, &adj, &diff))
+    {
+      rv = zone_cursor_op(utc, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD, zc);
+      if (rv) { return rv; }
+    }
+
+#if DEBUG_BST
+  printf("ukct_op: adj = %s \n", dbg_pdate(&adj));
+#endif
+
+  // Now we're in UTC.
+  adj.system = utc->system;
+
+#if DEBUG_BST
+  printf("ukct_op: -------- before utc->op ---- \n");
+#endif
+
+
+  rv = zone_cursor_op(utc, &tgt, &adj, offset, op, zc);
+  if (rv) { return rv; }
+
+#if DEBUG_BST
+  printf("ukct_op: ------- after utc->op ----\n");
+#endif
+  
+  if (op != CDC_OP_ZONE_ADD) {
+      rv = ukct_offset(self, &diff, &tgt, zc);
+      if (rv) { return rv; }
+  }
+#if DEBUG_BST
+  printf("ukct_op: initial tgt = %s \n", dbg_pdate(&tgt));
+  printf("ukct_op: initial tgt offset = %s \n", dbg_pdate(&diff));
+#endif
+
+  // Luckily we need not think about this too hard as leap seconds
+  // never happen at the same time as BST transitions.
+  
+  {
+    int ls = 0;
+    if (tgt.second == 60) { ls = 1; --tgt.second; }
+    
+    memcpy(dest, &tgt, sizeof(cdc_calendar_t));
+    if (!ukct_shift(utc, dest, &diff))
+      {
+	rv = zone_cursor_op(utc, dest, &tgt, &diff, CDC_OP_COMPLEX_ADD, zc);
+	if (rv) { return rv; }
+      }
+    if (ls) { ++dest->second; }
+  }
+
+  dest->system = self->system;
+
+#if DEBUG_BST
+  printf("ukct_op: dest = %s \n", dbg_pdate(dest));
+#endif
+
+  return 0;
+}
+
+static int system_ukct_aux(struct cdc_zone_struct *self,
+			  const cdc_calendar_t *calc,
+			  cdc_calendar_aux_t *aux)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  int rv;
+
+  rv = utc->aux(utc, calc, aux);
+  if (rv) { return rv; }
+
+  // Is it DST?
+  aux->is_dst = is_bst(utc, calc, NULL);
+  return 0;
+}
+
+static int system_ukct_epoch(struct cdc_zone_struct *self,
+			    cdc_calendar_t *aux)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+
+  return utc->epoch(utc, aux);
+}
+
+static int system_ukct_lower_zone(struct cdc_zone_struct *self,
+				 struct cdc_zone_struct **next)
+{
+  (*next) = (struct cdc_zone_struct *)self->handle;
+  return 0;
+}
+
+/** Set cal to the time BST changes in 'month' of 'year', in 'system'
+ *  (which must be UTC or UKCT).
+ */
+static int ukct_span_edge(cdc_zone_t *utc, cdc_calendar_t *cal,
+			  int year, int month, uint32_t system)
+{
+  int march, october;
+
+  if (!zone_has_gtai_aux(utc) || bst_last_sundays(&march, &october, year))
+    {
+      // The hard way. Both months have 31 days.
+      cdc_calendar_aux_t aux;
+      int rv;
+
+      memset(cal, '\0', sizeof(cdc_calendar_t));
+      cal->year = year; cal->month = month; cal->mday = 31; 
+      cal->system = utc->system;
+      rv = utc->aux(utc, cal, &aux);
+      if (rv) { return rv; }
+      if (aux.wday < 0) { return CDC_ERR_UNDEFINED_DATE; }
+      march = october = 31 - aux.wday;
+    }
+
+  memset(cal, '\0', sizeof(cdc_calendar_t));
+  cal->year = year;
+  cal->month = month;
+  cal->mday = (month == CDC_MARCH) ? march : october;
+  // 0100 UTC, which is 0100 GMT in March and 0200 BST in October.
+  cal->hour = (system == CDC_SYSTEM_UTC) ? 1 : 2;
+  cal->system = system;
+  return 0;
+}
+
+static int system_ukct_span(struct cdc_zone_struct *self,
+			    const cdc_calendar_t *cal,
+			    cdc_calendar_t *start,
+			    cdc_calendar_t *end,
+			    cdc_calendar_t *offset)
+{
+  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  uint32_t system = cal->system;
+  int year = cal->year;
+  int rv;
+
+  if (system != CDC_SYSTEM_UTC && system != CDC_SYSTEM_UKCT)
+    {
+      return CDC_ERR_NOT_MY_SYSTEM;
+    }
+
+  rv = system_ukct_offset(self, offset, cal);
+  if (rv) { return rv; }
+
+  if (offset->hour)
+    {
+      // Summer: from March to October.
+      rv = ukct_span_edge(utc, start, year, CDC_MARCH, system);
+      if (!rv) { rv = ukct_span_edge(utc, end, year, CDC_OCTOBER, system); }
+    }
+  else if (cal->month >= CDC_OCTOBER)
+    {
+      // Winter, from October to next March.
+      rv = ukct_span_edge(utc, start, year, CDC_OCTOBER, system);
+      if (rv) { return rv; }
+      if (year == INT_MAX) 
+	{ 
+	  span_unbounded(end, INT_MAX, system); 
+	}
+      else
+	{
+	  rv = ukct_span_edge(utc, end, year + 1, CDC_MARCH, system);
+	}
+    }
+  else
+    {
+      // Winter, from last October to March.
+      if (year == INT_MIN) 
+	{ 
+	  span_unbounded(start, INT_MIN, system); 
+	}
+      else
+	{
+	  rv = ukct_span_edge(utc, start, year - 1, CDC_OCTOBER, system);
+	  if (rv) { return rv; }
+	}
+      rv = ukct_span_edge(utc, end, year, CDC_MARCH, system);
+    }
+  return rv;
+}
+
+
+/** zc, if not NULL, holds the last Sundays of the year we looked at
+ *  last time. 
+ */
+static int is_bst(struct cdc_zone_struct *utc, const cdc_calendar_t *cal,
+		  zone_cursor_t *zc)
+{
+  // The date actually doesn't matter so ..
+  if (cal->month < CDC_MARCH || cal->month > CDC_OCTOBER)
+    {
+      // Can't possibly be BST.
+#if DEBUG_BST
+      printf("is_bst: case A (can't be BST)\n");
+#endif
+
+      return 0;
+    }
+  if (cal->month > CDC_MARCH && cal->month < CDC_OCTOBER)
+    {
+      // Must be BST
+#if DEBUG_BST
+      printf("is_bst: case B (must be BST)\n");
+#endif
+
+      return 1;
+    }
+
+  // Otherwise ..
+  if (cal->month == CDC_MARCH || cal->month == CDC_OCTOBER)
+    {
+      int is_march = (cal->month == CDC_MARCH);
+      // Luckily, March and October both have 31 days .. 
+
+
+      if (cal->mday <= (31-7)) {
+	  // At most the 24th of the month, there are (at least) seven clear
+      // days to come - so there must be a Sunday to come.
+#if DEBUG_BST
+	  printf("  -> There must be a sunday to come.\n");
+#endif
+
+	  return !is_march;
+	}
+      
+      cdc_calendar_aux_t aux;
+      int rv;
+
+      if (cal->mday <= 31 && cal->hour >= 0 && cal->hour < 24 && 
+	  zone_has_gtai_aux(utc))
+	{
+	  int march, october;
+	  
+	  rv = 0;
+	  if (zc && zc->bst_march && zc->bst_year == cal->year)
+	    {
+	      march = zc->bst_march; 
+	      october = zc->bst_october;
+	    }
+	  else
+	    {
+	      rv = bst_last_sundays(&march, &october, cal->year);
+	      if (!rv && zc)
+		{
+		  zc->bst_year = cal->year;
+		  zc->bst_march = march; 
+		  zc->bst_october = october;
+		}
+	    }
+
+	  if (!rv)
+	    {
+	      // Hours into the month, and when BST turns on/off.
+	      int when = (cal->mday * 24) + cal->hour;
+	      int change = ((is_march ? march : october) * 24) + 
+		((cal->system == CDC_SYSTEM_UTC) ? 1 :
+		 (cal->system == CDC_SYSTEM_UKCT) ? 2 : 24);
+
+	      return is_march ? (when >= change) : (when < change);
+	    }
+	}
+
+      rv = utc->aux(utc, cal, &aux);
+      if (rv) { return rv; }
+
+      if (aux.wday == 0)
+	{
+	  // It's today!
+	  if (cal->system == CDC_SYSTEM_UTC && cal->hour >= 1)
+	    {
+#if DEBUG_BST
+	      printf("  -> After UTC 0100: BST has turned on/off.\n");
+#endif
+
+	      return is_march;
+	    }
+	  if (cal->system == CDC_SYSTEM_UKCT && cal->hour >= 2)
+	    {
+#if DEBUG_BST
+	      printf("  -> After BST 0200: BST has turned on/off.\n");
+#endif
+	      return is_march;
+	    }
+
+#if DEBUG_BST
+	  printf("On Sunday, but before BST switch.\n");
+#endif
+
+	  // Otherwise, the switch point occurs after this.
+	  return !is_march;
+	}
+
+#if DEBUG_BST
+      printf("is_bst: aux.wday = %d cal->mday = %d \n", 
+	     aux.wday, cal->mday);
+#endif
+
+      // Is there going to be a Sunday?
+      // How many days until the next Sunday, and how many are left this month?
+      if ((7-aux.wday) <= (31-cal->mday))
+	{
+	  // Yes.
+#if DEBUG_BST
+	  printf("   -> There will be a sunday after this.\n");
+#endif
+
+	  return !is_march;
+	}
+	  
+      // Otherwise, no
+#if DEBUG_BST
+      printf("  -> We're after last sunday in March/October.\n");
+#endif
+
+      return is_march;  
+    }
+
+
+  return CDC_ERR_INTERNAL_ERROR;
+}
+
+/* --------------------------- rebased ------------------------ */
+
+int cdc_rebased_new(cdc_zone_t **ozone,
+			 const cdc_calendar_t *offset,
+			 cdc_zone_t *based_on)
+{
+  int rv;
+  cdc_rebased_handle_t *hndl =
+    (cdc_rebased_handle_t *)malloc(sizeof(cdc_rebased_handle_t));
+  memset(hndl, '\0', sizeof(cdc_rebased_handle_t));
+
+  memcpy(&hndl->offset, offset, sizeof(cdc_calendar_t));
+  hndl->lower = based_on;
+
+  rv = cdc_zone_new(CDC_SYSTEM_REBASED,
+			 ozone,
+			 0,
+			 (void *)hndl);
+  if (rv)
+    {
+      free(hndl);
+      return rv;
+    }
+  
+  return 0;
+}
+
+static int system_rebased_init(struct cdc_zone_struct *self,
+			       int argi,
+			       void *argn)
+{
+  self->handle = (void *)argn;
+  return 0;
+}
+
+static int system_rebased_dispose(cdc_zone_t *self)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+  // Don't free h->lower: may be needed elsewhere
+
+  free(h);
+  return 0;
+}
+
+static int system_rebased_offset(struct cdc_zone_struct *self,
+				 cdc_calendar_t *offset,
+				 const cdc_calendar_t *src)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+
+  memcpy(offset, &h->offset, sizeof(cdc_calendar_t));
+  return 0;
+}
+
+static int system_rebased_aux(struct cdc_zone_struct *self,
+			      const cdc_calendar_t *calc,
+			      cdc_calendar_aux_t *aux)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+  
+  return h->lower->aux(h->lower, calc, aux);
+}
+
+static int system_rebased_op(struct cdc_zone_struct *self,
+			     cdc_calendar_t *dest,
+			     const cdc_calendar_t *src,
+			     const cdc_calendar_t *offset,
+			     int op)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+  cdc_calendar_t adj, diff, tgt, srcx;
+  int rv;
+
+  memcpy(&diff, &h->offset, sizeof(cdc_calendar_t));
+  cdc_negate(&diff);
+  
+  memcpy(&srcx, src, sizeof(cdc_calendar_t));
+  srcx.system = h->lower->system;
+
+  // Adjust into lower.
+ 
+  rv = h->lower->op(h->lower, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD);
+  if (rv) { return rv; }
+
+#if DEBUG_REBASED
+  printf("rebase_op:  src         = %s\n", dbg_pdate(&srcx));
+  printf("            diff        = %s\n", dbg_pdate(&diff));
+  printf("            adj         = %s\n", dbg_pdate(&adj));
+#endif
+
+  rv = h->lower->op(h->lower, &tgt, &adj, offset, op);
+  if (rv) { return rv; }
+
+#if DEBUG_REBASED
+  printf("rebase_op[2]: offset   = %s\n", dbg_pdate(offset));
+  printf("rebase_op[2]: tgt      = %s\n", dbg_pdate(&tgt));
+#endif
+  
+  {
+    int ls = 0;
+    if (tgt.second == 60) { ls =1; --tgt.second; }
+    
+    rv = h->lower->op(h->lower, dest, &tgt, &h->offset, CDC_OP_COMPLEX_ADD);
+    if (rv) { return rv; }
+    if (ls) { ++dest->second; }
+  }
+
+  dest->system = self->system;
+#if DEBUG_REBASED
+  printf("rebase_op[3]:   dest =  %s \n", dbg_pdate(dest));
+#endif
+
+  return 0;
+}
+
+static int system_rebased_epoch(struct cdc_zone_struct *self,
+				cdc_calendar_t *aux)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+
+  return h->lower->epoch(h->lower, aux);
+}
+
+static int system_rebased_lower_zone(struct cdc_zone_struct *self,
+				  struct cdc_zone_struct **next)
+{
+  cdc_rebased_handle_t *h = 
+    (cdc_rebased_handle_t *)self->handle;
+
+  (*next) = h->lower;
+  return 0;
+}
+
+
+static void do_knockdown(cdc_calendar_t *io_diff, const cdc_calendar_t *offset, int *do_ls)  
+{
+  // If we've suppressed knockdown, do nothing.
+  if (offset->flags & CDC_FLAG_AS_IF_NS) { return; }
+
+  int go = !!offset->year;
+  // Year offsets always happen
+  if (go) { io_diff->month = 0; }
+  go = go || !!offset->month;
+  if (go) { io_diff->mday = 0; }
+  go = go || !!offset->hour; 
+  if (go) { io_diff->hour = 0; }
+  go = go || !!offset->minute;
+  if (go) { io_diff->second = 0; (*do_ls) = 0; } 
+  go = go || !!offset->second;
+  if (go) { io_diff->ns = 0; }
+}
+
+static void cdc_negate(cdc_calendar_t *cal)
+{
+  cal->year = -cal->year;
+  cal->month = -cal->month;
+  cal->mday = -cal->mday;
+  cal->hour = -cal->hour;
+  cal->minute = -cal->minute;
+  cal->second = -cal->second;
+  cal->ns  = -cal->ns;
+}
+
+ 
+int cdc_simple_op(cdc_calendar_t *result,
+			       const cdc_calendar_t *a,
+			       const cdc_calendar_t *b,
+			       int op)
+{
+  switch (op)
+    {
+    case CDC_OP_SIMPLE_ADD:
+    case CDC_OP_COMPLEX_ADD:
+    case CDC_OP_ZONE_ADD:
+      result->year = a->year + b->year;
+      result->month = a->month + b->month;
+      result->mday = a->mday + b->mday;
+      result->hour = a->hour + b->hour;
+      result->minute = a->minute + b->minute;
+      result->second = a->second + b->second;
+      result->ns = a->ns + b->ns;
+      break;
+    case CDC_OP_SUBTRACT:
+      result->year = a->year - b->year;
+      result->month = a->month - b->month;
+      result->mday = a->mday - b->mday;
+      result->hour = a->hour - b->hour;
+      result->minute = a->minute - b->minute;
+      result->second = a->second - b->second;
+      result->ns = a->ns - b->ns;
+      break;
+    default:
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
+
+  result->system = a->system;
+  return 0;
+}
+
+int cdc_diff(cdc_zone_t *z,
+		  cdc_interval_t *result,
+		  const cdc_calendar_t *before,
+		  const cdc_calendar_t *after)
+{
+  memset(result, '\0', sizeof(cdc_interval_t));
+
+  if (before->system == z->system && after->system == z->system &&
+      zone_has_linear_diff(z))
+    {
+      cdc_instant_t b, a;
+      int rv;
+
+      if (z->diff == system_gtai_diff && !diff_months_valid(before, after))
+	{
+	  return CDC_ERR_INVALID_ARGUMENT;
+	}
+
+      rv = cdc_zone_to_instant(z, &b, before);
+      if (rv) { return rv; }
+      rv = cdc_zone_to_instant(z, &a, after);
+      if (rv) { return rv; }
+
+      return cdc_instant_diff(result, &b, &a);
+    }
+
+  return z->diff(z, result, before, after);
+}
+
+int cdc_rebased_tai(struct cdc_zone_struct **dst,
+			 struct cdc_zone_struct *human_zone,
+			 const cdc_calendar_t *human_time,
+			 const cdc_calendar_t *machine_time)
+{
+  int rv;
+  cdc_calendar_t c1;
+  cdc_interval_t iv;
+  cdc_zone_t *lzone;
+
+#if DEBUG_REBASED
+  printf("> rebased_tai()\n");
+#endif
+
+  rv = cdc_zone_lower_to(human_zone, &c1, &lzone, human_time, machine_time->system);
+  if (rv) { return rv; }
+
+  // Otherwise ..
+  rv = cdc_diff(lzone, &iv, &c1, machine_time);
+  if (rv) { return rv; }
+
+  cdc_calendar_t offset;
+
+  memset(&offset, '\0', sizeof(cdc_calendar_t));
+  offset.second = iv.s;
+  offset.ns = iv.ns;
+  offset.flags |= CDC_FLAG_AS_IF_NS;
+  offset.system = CDC_SYSTEM_OFFSET;
+  
+  rv = cdc_rebased_new(dst, &offset, lzone);
+  return rv;
+}
+
+// WARNING: This is a semi-clone of ZoneHandleT::FromSystem() in cdcpp.
+// If you change this, you must make a matching change in the other.
+int cdc_zone_from_system(cdc_zone_t **zone_o, uint32_t inSystem)
+{
+    if (inSystem >= CDC_SYSTEM_UTCPLUS_BASE) {
+        int offset = inSystem - CDC_SYSTEM_UTCPLUS_ZERO;
+        return cdc_utcplus_new(zone_o, offset);
+    }
+    switch (inSystem) {
+        case CDC_SYSTEM_GREGORIAN_TAI:
+            return cdc_tai_new(zone_o);
+        case CDC_SYSTEM_UTC:
+            return cdc_utc_new(zone_o);
+        case CDC_SYSTEM_UKCT:
+            return cdc_ukct_new(zone_o);
+        // More cases go here.
+        default:
+            return CDC_ERR_BAD_SYSTEM;
+    }
+}
+
+
+/* ---------------------- Shared zones -------------------- */
+
+/* The built-in zones keep nothing in them but a pointer to the zone
+ * below, so one chain of each can serve the whole process. TAI, UTC 
+ * and UKCT are set up at compile time; there are too many UTC-plus 
+ * zones for that, so each is filled in the first time it's asked for
+ * and then never touched again.
+ */
+
+static cdc_zone_t s_shared_gtai = 
+  {
+    NULL,
+    CDC_SYSTEM_GREGORIAN_TAI,
+    null_init,
+    null_dispose,
+    system_gtai_diff,
+    system_gtai_offset,
+    system_gtai_op,
+    system_gtai_aux,
+    system_gtai_epoch,
+    system_gtai_lower_zone,
+    const_offset_span,
+    CDC_ZONE_FLAG_SHARED
+  };
+
+static cdc_zone_t s_shared_utc = 
+  {
+    &s_shared_gtai,
+    CDC_SYSTEM_UTC,
+    utc_init,
+    null_dispose,
+    system_lower_diff,
+    system_utc_offset,
+    system_utc_op,
+    system_utc_aux,
+    system_utc_epoch,
+    system_utc_lower_zone,
+    system_utc_span,
+    CDC_ZONE_FLAG_SHARED
+  };
+
+static cdc_zone_t s_shared_ukct = 
+  {
+    &s_shared_utc,
+    CDC_SYSTEM_UKCT,
+    ukct_init,
+    null_dispose,
+    system_lower_diff,
+    system_ukct_offset,
+    system_ukct_op,
+    system_ukct_aux,
+    system_ukct_epoch,
+    system_ukct_lower_zone,
+    system_ukct_span,
+    CDC_ZONE_FLAG_SHARED
+  };
+
+#define SHARED_UTCPLUS_NR (60*24 + 1)
+
+static cdc_zone_t s_shared_utcplus[SHARED_UTCPLUS_NR];
+
+//! Each slot's zone, once it's ready to use.
+static cdc_zone_t *s_shared_utcplus_ready[SHARED_UTCPLUS_NR];
+
+//! Set by whichever thread gets to fill each slot in.
+static cdc_zone_t *s_shared_utcplus_owner[SHARED_UTCPLUS_NR];
+
+static cdc_zone_t *shared_utcplus(int idx)
+{
+  cdc_zone_t *z = &s_shared_utcplus[idx];
+  cdc_zone_t *expected = NULL;
+
+  if (ATOMIC_LOAD_ACQUIRE(&s_shared_utcplus_ready[idx])) { return z; }
+
+  if (ATOMIC_CAS(&s_shared_utcplus_owner[idx], &expected, z))
+    {
+      memcpy(z, &s_system_utcplus, sizeof(cdc_zone_t));
+      z->system = CDC_SYSTEM_UTCPLUS_BASE + idx;
+      z->handle = &s_shared_utc;
+      z->flags = CDC_ZONE_FLAG_SHARED;
+      ATOMIC_STORE_RELEASE(&s_shared_utcplus_ready[idx], z);
+    }
+  else
+    {
+      while (!ATOMIC_LOAD_ACQUIRE(&s_shared_utcplus_ready[idx]))
+	{
+	  ATOMIC_YIELD();
+	}
+    }
+
+  return z;
+}
+
+int cdc_zone_get_shared(cdc_zone_t **zone_o, uint32_t inSystem)
+{
+  if (inSystem >= CDC_SYSTEM_UTCPLUS_BASE && 
+      inSystem < CDC_SYSTEM_UTCPLUS_BASE + SHARED_UTCPLUS_NR)
+    {
+      (*zone_o) = shared_utcplus(inSystem - CDC_SYSTEM_UTCPLUS_BASE);
+      return 0;
+    }
+
+  switch (inSystem)
+    {
+    case CDC_SYSTEM_GREGORIAN_TAI:
+      (*zone_o) = &s_shared_gtai;
+      return 0;
+    case CDC_SYSTEM_UTC:
+      (*zone_o) = &s_shared_utc;
+      return 0;
+    case CDC_SYSTEM_UKCT:
+      (*zone_o) = &s_shared_ukct;
+      return 0;
+    default:
+      (*zone_o) = NULL;
+      return CDC_ERR_BAD_SYSTEM;
+    }
+}
+
+
+/* ---------------------- Zone registry -------------------- */
+
+/* Zones by name and by system, in open-addressed tables which are 
+ * only ever added to and never more than half full. Readers don't 
+ * lock: each entry is filled in before the slot pointing at it is
+ * published, and never changes after that. Writers take 
+ * s_registry_lock, a spin lock which yields while it waits; adding
+ * is expected to be rare (once per name) and quick.
+ *
+ * The built-in zones aren't registered up front. A name which turns
+ * out to be a built-in system is added the first time it's looked 
+ * up, if it's the name cdc_describe_system() would give, so that the
+ * next lookup is a single probe.
+ */
+
+#define REGISTRY_SLOT_BITS   13
+#define REGISTRY_NR_SLOTS    (1 << REGISTRY_SLOT_BITS)
+#define REGISTRY_MAX_ENTRIES (REGISTRY_NR_SLOTS / 2)
+#define REGISTRY_SLOT(hash)  ((hash) >> (32 - REGISTRY_SLOT_BITS))
+#define REGISTRY_NEXT(slot)  (((slot) + 1) & (REGISTRY_NR_SLOTS - 1))
+
+typedef struct registry_entry_struct
+{
+  uint32_t hash;
+  int len;
+  char name[CDC_REGISTRY_NAME_MAX];
+  uint32_t system;
+  cdc_zone_t *zone;
+} registry_entry_t;
+
+static registry_entry_t s_registry_entries[REGISTRY_MAX_ENTRIES];
+static int s_registry_nr_entries = 0;
+
+static registry_entry_t *s_registry_by_name[REGISTRY_NR_SLOTS];
+static registry_entry_t *s_registry_by_system[REGISTRY_NR_SLOTS];
+
+//! 1 while someone is adding to the registry.
+static int s_registry_lock = 0;
+
+//! FNV-1a
+static uint32_t registry_hash_name(const char *name, int len)
+{
+  uint32_t hash = 2166136261U;
+  int i;
+
+  for (i = 0; i < len; ++i)
+    {
+      hash = (hash ^ (unsigned char)name[i]) * 16777619U;
+    }
+  return hash;
+}
+
+//! Fibonacci hashing; REGISTRY_SLOT() takes the top bits.
+static uint32_t registry_hash_system(uint32_t system)
+{
+  return system * 2654435769U;
+}
+
+/** @return The length of name, or -1 if it's too long to have been
+ *           registered.
+ */
+static int registry_name_len(const char *name)
+{
+  int len;
+
+  for (len = 0; len < CDC_REGISTRY_NAME_MAX; ++len)
+    {
+      if (!name[len]) { return len; }
+    }
+  return -1;
+}
+
+static registry_entry_t *registry_find_name(const char *name, int len,
+					    uint32_t hash)
+{
+  uint32_t slot = REGISTRY_SLOT(hash);
+  registry_entry_t *e;
+
+  while ((e = ATOMIC_LOAD_ACQUIRE(&s_registry_by_name[slot])) != NULL)
+    {
+      if (e->hash == hash && e->len == len && !memcmp(e->name, name, len))
+	{
+	  return e;
+	}
+      slot = REGISTRY_NEXT(slot);
+    }
+  return NULL;
+}
+
+static registry_entry_t *registry_find_system(uint32_t system)
+{
+  uint32_t slot = REGISTRY_SLOT(registry_hash_system(system));
+  registry_entry_t *e;
+
+  while ((e = ATOMIC_LOAD_ACQUIRE(&s_registry_by_system[slot])) != NULL)
+    {
+      if (e->system == system) { return e; }
+      slot = REGISTRY_NEXT(slot);
+    }
+  return NULL;
+}
+
+/** Add zone under name. It also goes in the table of systems if it's
+ *  the first zone added for its system and isn't a shared zone (which
+ *  cdc_zone_get_shared() finds faster).
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if the name is 
+ *          already taken, CDC_ERR_INIT_FAILED if the registry is full.
+ */
+static int registry_add(const char *name, int len, uint32_t hash,
+			cdc_zone_t *zone)
+{
+  registry_entry_t *e;
+  uint32_t slot;
+  int unlocked = 0;
+  int rv = 0;
+
+  while (!ATOMIC_CAS(&s_registry_lock, &unlocked, 1)) 
+    { 
+      unlocked = 0; 
+      ATOMIC_YIELD();
+    }
+
+  if (registry_find_name(name, len, hash))
+    {
+      rv = CDC_ERR_INVALID_ARGUMENT;
+    }
+  else if (s_registry_nr_entries == REGISTRY_MAX_ENTRIES)
+    {
+      rv = CDC_ERR_INIT_FAILED;
+    }
+  else
+    {
+      e = &s_registry_entries[s_registry_nr_entries++];
+      e->hash = hash;
+      e->len = len;
+      memcpy(e->name, name, len);
+      e->system = zone->system;
+      e->zone = zone;
+
+      slot = REGISTRY_SLOT(hash);
+      while (s_registry_by_name[slot]) { slot = REGISTRY_NEXT(slot); }
+      ATOMIC_STORE_RELEASE(&s_registry_by_name[slot], e);
+
+      if (!(zone->flags & CDC_ZONE_FLAG_SHARED) && 
+	  !registry_find_system(zone->system))
+	{
+	  slot = REGISTRY_SLOT(registry_hash_system(zone->system));
+	  while (s_registry_by_system[slot]) { slot = REGISTRY_NEXT(slot); }
+	  ATOMIC_STORE_RELEASE(&s_registry_by_system[slot], e);
+	}
+    }
+
+  ATOMIC_STORE_RELEASE(&s_registry_lock, 0);
+  return rv;
+}
 
+int cdc_registry_register(const char *name, cdc_zone_t *zone)
+{
+  cdc_zone_t *builtin;
+  unsigned int sys;
+  int len;
 
-  rv = utc->op(utc, &tgt, &adj, offset, op);
-  if (rv) { return rv; }
+  if (!name || !zone) { return CDC_ERR_INVALID_ARGUMENT; }
+  len = registry_name_len(name);
+  if (len <= 0) { return CDC_ERR_INVALID_ARGUMENT; }
 
-#if DEBUG_BST
-  printf("ukct_op: ------- after utc->op ----\n");
-#endif
-  
-  if (op != CDC_OP_ZONE_ADD) {
-      rv = self->offset(self, &diff, &tgt);
-      if (rv) { return rv; }
-  }
-#if DEBUG_BST
-  printf("ukct_op: initial tgt = %s \n", dbg_pdate(&tgt));
-  printf("ukct_op: initial tgt offset = %s \n", dbg_pdate(&diff));
-#endif
+  // Built-in names always mean the built-in zones.
+  if (!system_from_token(&sys, name, len) && 
+      !cdc_zone_get_shared(&builtin, sys))
+    {
+      return CDC_ERR_INVALID_ARGUMENT;
+    }
 
-  // Luckily we need not think about this too hard as leap seconds
-  // never happen at the same time as BST transitions.
-  
-  {
-    int ls = 0;
-    if (tgt.second == 60) { ls = 1; --tgt.second; }
-    
-    rv = utc->op(utc, dest, &tgt, &diff, CDC_OP_COMPLEX_ADD);
-    if (rv) { return rv; }
-    if (ls) { ++dest->second; }
-  }
+  return registry_add(name, len, registry_hash_name(name, len), zone);
+}
 
-  dest->system = self->system;
+int cdc_registry_lookup_name(cdc_zone_t **zone_o, const char *name)
+{
+  registry_entry_t *e;
+  char canonical[CDC_DESCRIBE_SYSTEM_MAX];
+  unsigned int sys;
+  uint32_t hash;
+  int len;
+
+  (*zone_o) = NULL;
+  if (!name) { return CDC_ERR_NO_SUCH_SYSTEM; }
+  len = registry_name_len(name);
+  if (len <= 0) { return CDC_ERR_NO_SUCH_SYSTEM; }
+
+  hash = registry_hash_name(name, len);
+  e = registry_find_name(name, len, hash);
+  if (e)
+    {
+      (*zone_o) = e->zone;
+      return 0;
+    }
 
-#if DEBUG_BST
-  printf("ukct_op: dest = %s \n", dbg_pdate(dest));
-#endif
+  if (system_from_token(&sys, name, len) || 
+      cdc_zone_get_shared(zone_o, sys))
+    {
+      return CDC_ERR_NO_SUCH_SYSTEM;
+    }
 
+  // Don't let other spellings of the same thing fill the table up.
+  if (describe_system(canonical, sys) == len && 
+      !memcmp(canonical, name, len))
+    {
+      // If someone else got there first, that's fine.
+      (void)registry_add(name, len, hash, (*zone_o));
+    }
   return 0;
 }
 
-static int system_ukct_aux(struct cdc_zone_struct *self,
-			  const cdc_calendar_t *calc,
-			  cdc_calendar_aux_t *aux)
+int cdc_registry_lookup_system(cdc_zone_t **zone_o, uint32_t inSystem)
 {
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
-  int rv;
+  registry_entry_t *e;
 
-  rv = utc->aux(utc, calc, aux);
-  if (rv) { return rv; }
+  if (!cdc_zone_get_shared(zone_o, inSystem)) { return 0; }
 
-  // Is it DST?
-  aux->is_dst = is_bst(utc, calc);
+  e = registry_find_system(inSystem);
+  if (!e) { return CDC_ERR_NO_SUCH_SYSTEM; }
+  (*zone_o) = e->zone;
   return 0;
 }
 
-static int system_ukct_epoch(struct cdc_zone_struct *self,
-			    cdc_calendar_t *aux)
+
+/* ---------------------- Arenas -------------------- */
+
+/* An arena is a list of blocks from malloc(), handed out from the 
+ * front. Resetting it just goes back to the first block, so once it's
+ * grown as big as it needs to be, making zones in it never calls 
+ * malloc() at all.
+ */
+
+//! Everything we put in an arena is aligned to this.
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+#define ARENA_DEFAULT_BLOCK 65536
+
+//! Room for the biggest thing we make in an arena: a rebased zone 
+//! and its handle.
+#define ARENA_MIN_BLOCK (ARENA_ROUND(sizeof(cdc_zone_t)) + \
+			 ARENA_ROUND(sizeof(cdc_rebased_handle_t)))
+
+typedef struct arena_block_struct
 {
-  cdc_zone_t *utc = (cdc_zone_t *)self->handle;
+  struct arena_block_struct *next;
 
-  return utc->epoch(utc, aux);
-}
+  //! Bytes of data after the header, and how many are in use.
+  size_t size, used;
 
-static int system_ukct_lower_zone(struct cdc_zone_struct *self,
-				 struct cdc_zone_struct **next)
+} arena_block_t;
+
+#define ARENA_BLOCK_DATA(b) ((char *)(b) + ARENA_ROUND(sizeof(arena_block_t)))
+
+struct cdc_arena_struct
 {
-  (*next) = (struct cdc_zone_struct *)self->handle;
-  return 0;
-}
+  size_t block_size;
+
+  arena_block_t *head;
 
+  //! The block we're allocating from; blocks after it are free.
+  arena_block_t *current;
+};
 
-static int is_bst(struct cdc_zone_struct *utc, const cdc_calendar_t *cal)
+static void *arena_alloc(cdc_arena_t *arena, size_t n)
 {
-  // The date actually doesn't matter so ..
-  if (cal->month < CDC_MARCH || cal->month > CDC_OCTOBER)
-    {
-      // Can't possibly be BST.
-#if DEBUG_BST
-      printf("is_bst: case A (can't be BST)\n");
-#endif
+  arena_block_t *b = arena->current;
 
-      return 0;
-    }
-  if (cal->month > CDC_MARCH && cal->month < CDC_OCTOBER)
-    {
-      // Must be BST
-#if DEBUG_BST
-      printf("is_bst: case B (must be BST)\n");
-#endif
+  n = ARENA_ROUND(n);
+  if (n > arena->block_size) { return NULL; }
 
-      return 1;
+  while (!b || b->used + n > b->size)
+    {
+      if (b && b->next)
+	{
+	  b = b->next;
+	  b->used = 0;
+	}
+      else
+	{
+	  arena_block_t *nb = (arena_block_t *)
+	    malloc(ARENA_ROUND(sizeof(arena_block_t)) + arena->block_size);
+
+	  if (!nb) { return NULL; }
+	  nb->next = NULL;
+	  nb->size = arena->block_size;
+	  nb->used = 0;
+	  if (b) { b->next = nb; } else { arena->head = nb; }
+	  b = nb;
+	}
+      arena->current = b;
     }
 
-  // Otherwise ..
-  if (cal->month == CDC_MARCH || cal->month == CDC_OCTOBER)
+  b->used += n;
+  return ARENA_BLOCK_DATA(b) + b->used - n;
+}
+
+/** Give back p, n bytes from arena_alloc(), if nothing has been 
+ *  allocated since. Otherwise it stays used until the next reset.
+ */
+static void arena_unalloc(cdc_arena_t *arena, void *p, size_t n)
+{
+  arena_block_t *b = arena->current;
+
+  n = ARENA_ROUND(n);
+  if (b && b->used >= n && (char *)p == ARENA_BLOCK_DATA(b) + b->used - n)
     {
-      int is_march = (cal->month == CDC_MARCH);
-      // Luckily, March and October both have 31 days .. 
+      b->used -= n;
+    }
+}
 
+int cdc_arena_new(cdc_arena_t **out, int block_size)
+{
+  cdc_arena_t *arena;
+  size_t size = (size_t)block_size;
 
-      if (cal->mday <= (31-7)) {
-	  // At most the 24th of the month, there are (at least) seven clear
-      // days to come - so there must be a Sunday to come.
-#if DEBUG_BST
-	  printf("  -> There must be a sunday to come.\n");
-#endif
+  if (block_size < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+  arena = (cdc_arena_t *)malloc(sizeof(cdc_arena_t));
+  if (!arena) { return CDC_ERR_INIT_FAILED; }
 
-	  return !is_march;
-	}
-      
-      cdc_calendar_aux_t aux;
-      int rv;
+  if (!size) { size = ARENA_DEFAULT_BLOCK; }
+  if (size < ARENA_MIN_BLOCK) { size = ARENA_MIN_BLOCK; }
+  arena->block_size = ARENA_ROUND(size);
+  arena->head = NULL;
+  arena->current = NULL;
 
-      rv = utc->aux(utc, cal, &aux);
-      if (rv) { return rv; }
+  (*out) = arena;
+  return 0;
+}
 
-      if (aux.wday == 0)
-	{
-	  // It's today!
-	  if (cal->system == CDC_SYSTEM_UTC && cal->hour >= 1)
-	    {
-#if DEBUG_BST
-	      printf("  -> After UTC 0100: BST has turned on/off.\n");
-#endif
+int cdc_arena_reset(cdc_arena_t *arena)
+{
+  arena->current = arena->head;
+  if (arena->head) { arena->head->used = 0; }
+  return 0;
+}
 
-	      return is_march;
-	    }
-	  if (cal->system == CDC_SYSTEM_UKCT && cal->hour >= 2)
-	    {
-#if DEBUG_BST
-	      printf("  -> After BST 0200: BST has turned on/off.\n");
-#endif
-	      return is_march;
-	    }
+int cdc_arena_dispose(cdc_arena_t **io_arena)
+{
+  arena_block_t *b;
 
-#if DEBUG_BST
-	  printf("On Sunday, but before BST switch.\n");
-#endif
+  if (!io_arena || !(*io_arena)) { return 0; }
 
-	  // Otherwise, the switch point occurs after this.
-	  return !is_march;
-	}
+  b = (*io_arena)->head;
+  while (b)
+    {
+      arena_block_t *next = b->next;
+      free(b);
+      b = next;
+    }
+  free(*io_arena);
+  (*io_arena) = NULL;
+  return 0;
+}
 
-#if DEBUG_BST
-      printf("is_bst: aux.wday = %d cal->mday = %d \n", 
-	     aux.wday, cal->mday);
-#endif
+int cdc_arena_zone_new(cdc_arena_t *arena,
+		       int system,
+		       cdc_zone_t **out_zone,
+		       int arg_i,
+		       void *arg_n)
+{
+  cdc_zone_t *prototype = zone_prototype(system);
+  cdc_zone_t *z;
 
-      // Is there going to be a Sunday?
-      // How many days until the next Sunday, and how many are left this month?
-      if ((7-aux.wday) <= (31-cal->mday))
-	{
-	  // Yes.
-#if DEBUG_BST
-	  printf("   -> There will be a sunday after this.\n");
-#endif
+  (*out_zone) = NULL;
+  if (prototype == NULL) { return CDC_ERR_NO_SUCH_SYSTEM; }
 
-	  return !is_march;
-	}
-	  
-      // Otherwise, no
-#if DEBUG_BST
-      printf("  -> We're after last sunday in March/October.\n");
-#endif
+  z = (cdc_zone_t *)arena_alloc(arena, sizeof(cdc_zone_t));
+  if (!z) { return CDC_ERR_INIT_FAILED; }
 
-      return is_march;  
+  memcpy(z, prototype, sizeof(cdc_zone_t));
+  z->system = system;
+  z->flags |= CDC_ZONE_FLAG_ARENA;
+  if (z->init(z, arg_i, arg_n)) 
+    { 
+      arena_unalloc(arena, z, sizeof(cdc_zone_t));
+      return CDC_ERR_INIT_FAILED; 
     }
 
-
-  return CDC_ERR_INTERNAL_ERROR;
+  (*out_zone) = z;
+  return 0;
 }
 
-/* --------------------------- rebased ------------------------ */
-
-int cdc_rebased_new(cdc_zone_t **ozone,
-			 const cdc_calendar_t *offset,
-			 cdc_zone_t *based_on)
+int cdc_arena_rebased_new(cdc_arena_t *arena,
+			  cdc_zone_t **ozone,
+			  const cdc_calendar_t *offset,
+			  cdc_zone_t *based_on)
 {
+  cdc_rebased_handle_t *hndl;
   int rv;
-  cdc_rebased_handle_t *hndl =
-    (cdc_rebased_handle_t *)malloc(sizeof(cdc_rebased_handle_t));
-  memset(hndl, '\0', sizeof(cdc_rebased_handle_t));
+
+  (*ozone) = NULL;
+  hndl = (cdc_rebased_handle_t *)
+    arena_alloc(arena, sizeof(cdc_rebased_handle_t));
+  if (!hndl) { return CDC_ERR_INIT_FAILED; }
 
   memcpy(&hndl->offset, offset, sizeof(cdc_calendar_t));
   hndl->lower = based_on;
 
-  rv = cdc_zone_new(CDC_SYSTEM_REBASED,
-			 ozone,
-			 0,
-			 (void *)hndl);
-  if (rv)
+  rv = cdc_arena_zone_new(arena, CDC_SYSTEM_REBASED, ozone, 0, 
+			  (void *)hndl);
+  if (rv) { arena_unalloc(arena, hndl, sizeof(cdc_rebased_handle_t)); }
+  return rv;
+}
+
+
+/* ---------------------- Column kernels -------------------- */
+
+/* Calendar fields <-> instants for columns of TAI times. The vector
+ * versions do days_from_civil() and civil_from_days() in double 
+ * lanes: every intermediate is an integer well under 2^53, so it's 
+ * exact, and floor(a / b) of a correctly rounded quotient is right 
+ * because no quotient we take is within an ulp of an integer it 
+ * isn't equal to. Blocks with a field out of range go one at a time.
+ */
+
+//! Largest |year|, |mday|, |hour| .. the vector kernels will take.
+#define KERNEL_FIELD_MAX (1 << 24)
+
+//! Largest |s| the vector kernels will take (about 17 million years).
+#define KERNEL_SECONDS_MAX (INT64_C(1) << 49)
+
+//! 1.5 * 2^52: adding it to a double in +/-2^51 leaves the integer 
+//! part in the low bits of the mantissa.
+#define KERNEL_MAGIC 6755399441055744.0
+
+static void columns_to_instants_scalar(int64_t *s,
+				       long int *out_ns,
+				       const int *year,
+				       const int *month,
+				       const int *mday,
+				       const int *hour,
+				       const int *minute,
+				       const int *second,
+				       const long int *ns,
+				       int lo, int hi)
+{
+  int i;
+
+  for (i = lo; i < hi; ++i)
     {
-      free(hndl);
-      return rv;
+      cdc_calendar_t cal;
+      cdc_instant_t t;
+
+      cal.year = year[i]; cal.month = month[i]; cal.mday = mday[i];
+      cal.hour = hour[i]; cal.minute = minute[i]; cal.second = second[i];
+      cal.ns = ns[i];
+      instant_from_tai(&t, &cal);
+      s[i] = t.s;
+      out_ns[i] = t.ns;
     }
-  
-  return 0;
 }
 
-static int system_rebased_init(struct cdc_zone_struct *self,
-			       int argi,
-			       void *argn)
+static int columns_from_instants_scalar(int *year,
+					int *month,
+					int *mday,
+					int *hour,
+					int *minute,
+					int *second,
+					long int *out_ns,
+					const int64_t *s,
+					const long int *ns,
+					int lo, int hi)
 {
-  self->handle = (void *)argn;
-  return 0;
+  int first_rv = 0;
+  int i;
+
+  for (i = lo; i < hi; ++i)
+    {
+      cdc_calendar_t cal;
+      cdc_instant_t t;
+      int rv;
+
+      memset(&cal, '\0', sizeof(cdc_calendar_t));
+      t.s = s[i]; t.ns = ns[i];
+      rv = instant_to_tai(&cal, &t);
+      if (rv && !first_rv) { first_rv = rv; }
+
+      year[i] = cal.year; month[i] = cal.month; mday[i] = cal.mday;
+      hour[i] = cal.hour; minute[i] = cal.minute; second[i] = cal.second;
+      out_ns[i] = cal.ns;
+    }
+  return first_rv;
 }
 
-static int system_rebased_dispose(cdc_zone_t *self)
+#if CDC_X86_KERNELS
+
+#define KERNEL_FLOOR_DIV_SSE(a, b) _mm_floor_pd(_mm_div_pd((a), (b)))
+#define KERNEL_IN_RANGE_SSE(x, lo, hi) \
+  _mm_and_pd(_mm_cmpge_pd((x), (lo)), _mm_cmple_pd((x), (hi)))
+
+__attribute__((target("sse4.1")))
+static void columns_to_instants_sse41(int64_t *s,
+				      long int *out_ns,
+				      const int *year,
+				      const int *month,
+				      const int *mday,
+				      const int *hour,
+				      const int *minute,
+				      const int *second,
+				      const long int *ns,
+				      int n)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
-  // Don't free h->lower: may be needed elsewhere
+  const __m128d one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+  const __m128d twelve = _mm_set1_pd(12.0);
+  const __m128d eleven = _mm_set1_pd(11.0), zero = _mm_setzero_pd();
+  const __m128d fmax = _mm_set1_pd(KERNEL_FIELD_MAX);
+  const __m128d fmin = _mm_set1_pd(-KERNEL_FIELD_MAX);
+  const __m128d magic = _mm_set1_pd(KERNEL_MAGIC);
+  int i;
 
-  free(h);
-  return 0;
+  for (i = 0; i + 2 <= n; i += 2)
+    {
+      __m128d y, mo, md, h, mi, se, ok, lt2, mp, era, yoe, doy, doe, days;
+      __m128d secs;
+
+#define LOAD2(col) _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)&(col)[i]))
+      y = LOAD2(year); mo = LOAD2(month); md = LOAD2(mday);
+      h = LOAD2(hour); mi = LOAD2(minute); se = LOAD2(second);
+#undef LOAD2
+
+      ok = _mm_and_pd(KERNEL_IN_RANGE_SSE(y, fmin, fmax),
+		      KERNEL_IN_RANGE_SSE(mo, zero, eleven));
+      ok = _mm_and_pd(ok, KERNEL_IN_RANGE_SSE(md, fmin, fmax));
+      ok = _mm_and_pd(ok, KERNEL_IN_RANGE_SSE(h, fmin, fmax));
+      ok = _mm_and_pd(ok, KERNEL_IN_RANGE_SSE(mi, fmin, fmax));
+      ok = _mm_and_pd(ok, KERNEL_IN_RANGE_SSE(se, fmin, fmax));
+      if (_mm_movemask_pd(ok) != 0x3 ||
+	  ns[i] < 0 || ns[i] >= ONE_BILLION || 
+	  ns[i + 1] < 0 || ns[i + 1] >= ONE_BILLION)
+	{
+	  columns_to_instants_scalar(s, out_ns, year, month, mday, hour,
+				     minute, second, ns, i, i + 2);
+	  continue;
+	}
+
+      // As days_from_civil().
+      lt2 = _mm_cmplt_pd(mo, two);
+      y = _mm_sub_pd(y, _mm_and_pd(lt2, one));
+      mp = _mm_add_pd(_mm_sub_pd(mo, two), _mm_and_pd(lt2, twelve));
+      era = KERNEL_FLOOR_DIV_SSE(y, _mm_set1_pd(400.0));
+      yoe = _mm_sub_pd(y, _mm_mul_pd(era, _mm_set1_pd(400.0)));
+      doy = KERNEL_FLOOR_DIV_SSE(_mm_add_pd(_mm_mul_pd(mp, _mm_set1_pd(153.0)), 
+					    two),
+				 _mm_set1_pd(5.0));
+      doy = _mm_sub_pd(_mm_add_pd(doy, md), one);
+      doe = _mm_add_pd(_mm_mul_pd(yoe, _mm_set1_pd(365.0)),
+		       KERNEL_FLOOR_DIV_SSE(yoe, _mm_set1_pd(4.0)));
+      doe = _mm_sub_pd(doe, KERNEL_FLOOR_DIV_SSE(yoe, _mm_set1_pd(100.0)));
+      doe = _mm_add_pd(doe, doy);
+      days = _mm_add_pd(_mm_mul_pd(era, _mm_set1_pd(GREGORIAN_DAYS_PER_ERA)), 
+			doe);
+      days = _mm_sub_pd(days, _mm_set1_pd(CIVIL_EPOCH_SHIFT));
+
+      secs = _mm_add_pd(_mm_mul_pd(h, _mm_set1_pd(SECONDS_PER_HOUR)),
+			_mm_mul_pd(mi, _mm_set1_pd(SECONDS_PER_MINUTE)));
+      secs = _mm_add_pd(secs, se);
+      secs = _mm_add_pd(secs, _mm_mul_pd(days, _mm_set1_pd(SECONDS_PER_DAY)));
+
+      _mm_storeu_si128((__m128i *)&s[i],
+		       _mm_sub_epi64(_mm_castpd_si128(_mm_add_pd(secs, magic)),
+				     _mm_castpd_si128(magic)));
+      out_ns[i] = ns[i];
+      out_ns[i + 1] = ns[i + 1];
+    }
+
+  columns_to_instants_scalar(s, out_ns, year, month, mday, hour,
+			     minute, second, ns, i, n);
 }
 
-static int system_rebased_offset(struct cdc_zone_struct *self,
-				 cdc_calendar_t *offset,
-				 const cdc_calendar_t *src)
+__attribute__((target("sse4.1")))
+static int columns_from_instants_sse41(int *year,
+				       int *month,
+				       int *mday,
+				       int *hour,
+				       int *minute,
+				       int *second,
+				       long int *out_ns,
+				       const int64_t *s,
+				       const long int *ns,
+				       int n)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
+  const __m128d one = _mm_set1_pd(1.0), two = _mm_set1_pd(2.0);
+  const __m128d ten = _mm_set1_pd(10.0), twelve = _mm_set1_pd(12.0);
+  const __m128d magic = _mm_set1_pd(KERNEL_MAGIC);
+  int first_rv = 0;
+  int i;
+
+  for (i = 0; i + 2 <= n; i += 2)
+    {
+      __m128d sd, d, secs, z, era, doe, yoe, doy, mp, m, y, md, h, mins;
+
+      if (s[i] <= -KERNEL_SECONDS_MAX || s[i] >= KERNEL_SECONDS_MAX ||
+	  s[i + 1] <= -KERNEL_SECONDS_MAX || s[i + 1] >= KERNEL_SECONDS_MAX ||
+	  ns[i] < 0 || ns[i] >= ONE_BILLION || 
+	  ns[i + 1] < 0 || ns[i + 1] >= ONE_BILLION)
+	{
+	  int rv = columns_from_instants_scalar(year, month, mday, hour, 
+						minute, second, out_ns, 
+						s, ns, i, i + 2);
+	  if (rv && !first_rv) { first_rv = rv; }
+	  continue;
+	}
+
+      sd = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(_mm_loadu_si128((const __m128i *)&s[i]),
+						     _mm_castpd_si128(magic))),
+		      magic);
+
+      // As civil_from_days().
+      d = KERNEL_FLOOR_DIV_SSE(sd, _mm_set1_pd(SECONDS_PER_DAY));
+      secs = _mm_sub_pd(sd, _mm_mul_pd(d, _mm_set1_pd(SECONDS_PER_DAY)));
+      z = _mm_add_pd(d, _mm_set1_pd(CIVIL_EPOCH_SHIFT));
+      era = KERNEL_FLOOR_DIV_SSE(z, _mm_set1_pd(GREGORIAN_DAYS_PER_ERA));
+      doe = _mm_sub_pd(z, _mm_mul_pd(era, _mm_set1_pd(GREGORIAN_DAYS_PER_ERA)));
+      yoe = _mm_sub_pd(doe, KERNEL_FLOOR_DIV_SSE(doe, _mm_set1_pd(1460.0)));
+      yoe = _mm_add_pd(yoe, KERNEL_FLOOR_DIV_SSE(doe, _mm_set1_pd(36524.0)));
+      yoe = _mm_sub_pd(yoe, KERNEL_FLOOR_DIV_SSE(doe, _mm_set1_pd(146096.0)));
+      yoe = KERNEL_FLOOR_DIV_SSE(yoe, _mm_set1_pd(365.0));
+      doy = _mm_add_pd(_mm_mul_pd(yoe, _mm_set1_pd(365.0)),
+		       KERNEL_FLOOR_DIV_SSE(yoe, _mm_set1_pd(4.0)));
+      doy = _mm_sub_pd(doy, KERNEL_FLOOR_DIV_SSE(yoe, _mm_set1_pd(100.0)));
+      doy = _mm_sub_pd(doe, doy);
+      mp = KERNEL_FLOOR_DIV_SSE(_mm_add_pd(_mm_mul_pd(doy, _mm_set1_pd(5.0)), two),
+				_mm_set1_pd(153.0));
+      m = _mm_sub_pd(_mm_add_pd(mp, two), 
+		     _mm_and_pd(_mm_cmpge_pd(mp, ten), twelve));
+      y = _mm_add_pd(yoe, _mm_mul_pd(era, _mm_set1_pd(400.0)));
+      y = _mm_add_pd(y, _mm_and_pd(_mm_cmplt_pd(m, two), one));
+      md = KERNEL_FLOOR_DIV_SSE(_mm_add_pd(_mm_mul_pd(mp, _mm_set1_pd(153.0)), two),
+				_mm_set1_pd(5.0));
+      md = _mm_add_pd(_mm_sub_pd(doy, md), one);
+      h = KERNEL_FLOOR_DIV_SSE(secs, _mm_set1_pd(SECONDS_PER_HOUR));
+      mins = KERNEL_FLOOR_DIV_SSE(secs, _mm_set1_pd(SECONDS_PER_MINUTE));
+
+#define STORE2(col, v) _mm_storel_epi64((__m128i *)&(col)[i], _mm_cvtpd_epi32(v))
+      STORE2(year, y); STORE2(month, m); STORE2(mday, md); STORE2(hour, h);
+      STORE2(minute, _mm_sub_pd(mins, _mm_mul_pd(h, _mm_set1_pd(MINUTES_PER_HOUR))));
+      STORE2(second, _mm_sub_pd(secs, _mm_mul_pd(mins, _mm_set1_pd(SECONDS_PER_MINUTE))));
+#undef STORE2
+      out_ns[i] = ns[i];
+      out_ns[i + 1] = ns[i + 1];
+    }
+
+  {
+    int rv = columns_from_instants_scalar(year, month, mday, hour, minute, 
+					  second, out_ns, s, ns, i, n);
+    if (rv && !first_rv) { first_rv = rv; }
+  }
+  return first_rv;
+}
 
-  memcpy(offset, &h->offset, sizeof(cdc_calendar_t));
-  return 0;
+#define KERNEL_FLOOR_DIV_AVX(a, b) _mm256_floor_pd(_mm256_div_pd((a), (b)))
+#define KERNEL_IN_RANGE_AVX(x, lo, hi) \
+  _mm256_and_pd(_mm256_cmp_pd((x), (lo), _CMP_GE_OQ), \
+		_mm256_cmp_pd((x), (hi), _CMP_LE_OQ))
+
+/** 0 if all four of v are in [0, ONE_BILLION), else not 0 */
+__attribute__((target("avx2")))
+static inline int kernel_bad_ns_avx2(__m256i v)
+{
+  __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), v),
+				_mm256_cmpgt_epi64(v, _mm256_set1_epi64x(ONE_BILLION - 1)));
+  return !_mm256_testz_si256(bad, bad);
 }
 
-static int system_rebased_aux(struct cdc_zone_struct *self,
-			      const cdc_calendar_t *calc,
-			      cdc_calendar_aux_t *aux)
+__attribute__((target("avx2")))
+static void columns_to_instants_avx2(int64_t *s,
+				     long int *out_ns,
+				     const int *year,
+				     const int *month,
+				     const int *mday,
+				     const int *hour,
+				     const int *minute,
+				     const int *second,
+				     const long int *ns,
+				     int n)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
-  
-  return h->lower->aux(h->lower, calc, aux);
+  const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0);
+  const __m256d twelve = _mm256_set1_pd(12.0);
+  const __m256d eleven = _mm256_set1_pd(11.0), zero = _mm256_setzero_pd();
+  const __m256d fmax = _mm256_set1_pd(KERNEL_FIELD_MAX);
+  const __m256d fmin = _mm256_set1_pd(-KERNEL_FIELD_MAX);
+  const __m256d magic = _mm256_set1_pd(KERNEL_MAGIC);
+  int i;
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m256d y, mo, md, h, mi, se, ok, lt2, mp, era, yoe, doy, doe, days;
+      __m256d secs;
+      __m256i nsv = _mm256_loadu_si256((const __m256i *)&ns[i]);
+
+#define LOAD4(col) _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)&(col)[i]))
+      y = LOAD4(year); mo = LOAD4(month); md = LOAD4(mday);
+      h = LOAD4(hour); mi = LOAD4(minute); se = LOAD4(second);
+#undef LOAD4
+
+      ok = _mm256_and_pd(KERNEL_IN_RANGE_AVX(y, fmin, fmax),
+			 KERNEL_IN_RANGE_AVX(mo, zero, eleven));
+      ok = _mm256_and_pd(ok, KERNEL_IN_RANGE_AVX(md, fmin, fmax));
+      ok = _mm256_and_pd(ok, KERNEL_IN_RANGE_AVX(h, fmin, fmax));
+      ok = _mm256_and_pd(ok, KERNEL_IN_RANGE_AVX(mi, fmin, fmax));
+      ok = _mm256_and_pd(ok, KERNEL_IN_RANGE_AVX(se, fmin, fmax));
+      if (_mm256_movemask_pd(ok) != 0xf || kernel_bad_ns_avx2(nsv))
+	{
+	  // gcc doesn't do this for us, and the plain C pays dearly if
+	  // we don't.
+	  _mm256_zeroupper();
+	  columns_to_instants_scalar(s, out_ns, year, month, mday, hour,
+				     minute, second, ns, i, i + 4);
+	  continue;
+	}
+
+      // As days_from_civil().
+      lt2 = _mm256_cmp_pd(mo, two, _CMP_LT_OQ);
+      y = _mm256_sub_pd(y, _mm256_and_pd(lt2, one));
+      mp = _mm256_add_pd(_mm256_sub_pd(mo, two), _mm256_and_pd(lt2, twelve));
+      era = KERNEL_FLOOR_DIV_AVX(y, _mm256_set1_pd(400.0));
+      yoe = _mm256_sub_pd(y, _mm256_mul_pd(era, _mm256_set1_pd(400.0)));
+      doy = KERNEL_FLOOR_DIV_AVX(_mm256_add_pd(_mm256_mul_pd(mp, _mm256_set1_pd(153.0)), 
+					       two),
+				 _mm256_set1_pd(5.0));
+      doy = _mm256_sub_pd(_mm256_add_pd(doy, md), one);
+      doe = _mm256_add_pd(_mm256_mul_pd(yoe, _mm256_set1_pd(365.0)),
+			  KERNEL_FLOOR_DIV_AVX(yoe, _mm256_set1_pd(4.0)));
+      doe = _mm256_sub_pd(doe, KERNEL_FLOOR_DIV_AVX(yoe, _mm256_set1_pd(100.0)));
+      doe = _mm256_add_pd(doe, doy);
+      days = _mm256_add_pd(_mm256_mul_pd(era, _mm256_set1_pd(GREGORIAN_DAYS_PER_ERA)), 
+			   doe);
+      days = _mm256_sub_pd(days, _mm256_set1_pd(CIVIL_EPOCH_SHIFT));
+
+      secs = _mm256_add_pd(_mm256_mul_pd(h, _mm256_set1_pd(SECONDS_PER_HOUR)),
+			   _mm256_mul_pd(mi, _mm256_set1_pd(SECONDS_PER_MINUTE)));
+      secs = _mm256_add_pd(secs, se);
+      secs = _mm256_add_pd(secs, _mm256_mul_pd(days, _mm256_set1_pd(SECONDS_PER_DAY)));
+
+      _mm256_storeu_si256((__m256i *)&s[i],
+			  _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(secs, magic)),
+					   _mm256_castpd_si256(magic)));
+      _mm256_storeu_si256((__m256i *)&out_ns[i], nsv);
+    }
+
+  _mm256_zeroupper();
+  columns_to_instants_scalar(s, out_ns, year, month, mday, hour,
+			     minute, second, ns, i, n);
 }
 
-static int system_rebased_op(struct cdc_zone_struct *self,
-			     cdc_calendar_t *dest,
-			     const cdc_calendar_t *src,
-			     const cdc_calendar_t *offset,
-			     int op)
+__attribute__((target("avx2")))
+static int columns_from_instants_avx2(int *year,
+				      int *month,
+				      int *mday,
+				      int *hour,
+				      int *minute,
+				      int *second,
+				      long int *out_ns,
+				      const int64_t *s,
+				      const long int *ns,
+				      int n)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
-  cdc_calendar_t adj, diff, tgt, srcx;
-  int rv;
+  const __m256d one = _mm256_set1_pd(1.0), two = _mm256_set1_pd(2.0);
+  const __m256d ten = _mm256_set1_pd(10.0), twelve = _mm256_set1_pd(12.0);
+  const __m256d magic = _mm256_set1_pd(KERNEL_MAGIC);
+  const __m256i smax = _mm256_set1_epi64x(KERNEL_SECONDS_MAX - 1);
+  const __m256i smin = _mm256_set1_epi64x(-KERNEL_SECONDS_MAX + 1);
+  int first_rv = 0;
+  int i;
 
-  memcpy(&diff, &h->offset, sizeof(cdc_calendar_t));
-  cdc_negate(&diff);
-  
-  memcpy(&srcx, src, sizeof(cdc_calendar_t));
-  srcx.system = h->lower->system;
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      __m256d sd, d, secs, z, era, doe, yoe, doy, mp, m, y, md, h, mins;
+      __m256i sv = _mm256_loadu_si256((const __m256i *)&s[i]);
+      __m256i nsv = _mm256_loadu_si256((const __m256i *)&ns[i]);
+      __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(sv, smax),
+				    _mm256_cmpgt_epi64(smin, sv));
 
-  // Adjust into lower.
- 
-  rv = h->lower->op(h->lower, &adj, &srcx, &diff, CDC_OP_COMPLEX_ADD);
-  if (rv) { return rv; }
+      if (!_mm256_testz_si256(bad, bad) || kernel_bad_ns_avx2(nsv))
+	{
+	  int rv;
 
-#if DEBUG_REBASED
-  printf("rebase_op:  src         = %s\n", dbg_pdate(&srcx));
-  printf("            diff        = %s\n", dbg_pdate(&diff));
-  printf("            adj         = %s\n", dbg_pdate(&adj));
-#endif
+	  _mm256_zeroupper();
+	  rv = columns_from_instants_scalar(year, month, mday, hour, 
+						minute, second, out_ns, 
+						s, ns, i, i + 4);
+	  if (rv && !first_rv) { first_rv = rv; }
+	  continue;
+	}
 
-  rv = h->lower->op(h->lower, &tgt, &adj, offset, op);
-  if (rv) { return rv; }
+      sd = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(sv, _mm256_castpd_si256(magic))),
+			 magic);
+
+      // As civil_from_days().
+      d = KERNEL_FLOOR_DIV_AVX(sd, _mm256_set1_pd(SECONDS_PER_DAY));
+      secs = _mm256_sub_pd(sd, _mm256_mul_pd(d, _mm256_set1_pd(SECONDS_PER_DAY)));
+      z = _mm256_add_pd(d, _mm256_set1_pd(CIVIL_EPOCH_SHIFT));
+      era = KERNEL_FLOOR_DIV_AVX(z, _mm256_set1_pd(GREGORIAN_DAYS_PER_ERA));
+      doe = _mm256_sub_pd(z, _mm256_mul_pd(era, _mm256_set1_pd(GREGORIAN_DAYS_PER_ERA)));
+      yoe = _mm256_sub_pd(doe, KERNEL_FLOOR_DIV_AVX(doe, _mm256_set1_pd(1460.0)));
+      yoe = _mm256_add_pd(yoe, KERNEL_FLOOR_DIV_AVX(doe, _mm256_set1_pd(36524.0)));
+      yoe = _mm256_sub_pd(yoe, KERNEL_FLOOR_DIV_AVX(doe, _mm256_set1_pd(146096.0)));
+      yoe = KERNEL_FLOOR_DIV_AVX(yoe, _mm256_set1_pd(365.0));
+      doy = _mm256_add_pd(_mm256_mul_pd(yoe, _mm256_set1_pd(365.0)),
+			  KERNEL_FLOOR_DIV_AVX(yoe, _mm256_set1_pd(4.0)));
+      doy = _mm256_sub_pd(doy, KERNEL_FLOOR_DIV_AVX(yoe, _mm256_set1_pd(100.0)));
+      doy = _mm256_sub_pd(doe, doy);
+      mp = KERNEL_FLOOR_DIV_AVX(_mm256_add_pd(_mm256_mul_pd(doy, _mm256_set1_pd(5.0)), two),
+				_mm256_set1_pd(153.0));
+      m = _mm256_sub_pd(_mm256_add_pd(mp, two), 
+			_mm256_and_pd(_mm256_cmp_pd(mp, ten, _CMP_GE_OQ), twelve));
+      y = _mm256_add_pd(yoe, _mm256_mul_pd(era, _mm256_set1_pd(400.0)));
+      y = _mm256_add_pd(y, _mm256_and_pd(_mm256_cmp_pd(m, two, _CMP_LT_OQ), one));
+      md = KERNEL_FLOOR_DIV_AVX(_mm256_add_pd(_mm256_mul_pd(mp, _mm256_set1_pd(153.0)), two),
+				_mm256_set1_pd(5.0));
+      md = _mm256_add_pd(_mm256_sub_pd(doy, md), one);
+      h = KERNEL_FLOOR_DIV_AVX(secs, _mm256_set1_pd(SECONDS_PER_HOUR));
+      mins = KERNEL_FLOOR_DIV_AVX(secs, _mm256_set1_pd(SECONDS_PER_MINUTE));
+
+#define STORE4(col, v) _mm_storeu_si128((__m128i *)&(col)[i], _mm256_cvtpd_epi32(v))
+      STORE4(year, y); STORE4(month, m); STORE4(mday, md); STORE4(hour, h);
+      STORE4(minute, _mm256_sub_pd(mins, _mm256_mul_pd(h, _mm256_set1_pd(MINUTES_PER_HOUR))));
+      STORE4(second, _mm256_sub_pd(secs, _mm256_mul_pd(mins, _mm256_set1_pd(SECONDS_PER_MINUTE))));
+#undef STORE4
+      _mm256_storeu_si256((__m256i *)&out_ns[i], nsv);
+    }
 
-#if DEBUG_REBASED
-  printf("rebase_op[2]: offset   = %s\n", dbg_pdate(offset));
-  printf("rebase_op[2]: tgt      = %s\n", dbg_pdate(&tgt));
-#endif
-  
+  _mm256_zeroupper();
   {
-    int ls = 0;
-    if (tgt.second == 60) { ls =1; --tgt.second; }
-    
-    rv = h->lower->op(h->lower, dest, &tgt, &h->offset, CDC_OP_COMPLEX_ADD);
-    if (rv) { return rv; }
-    if (ls) { ++dest->second; }
+    int rv = columns_from_instants_scalar(year, month, mday, hour, minute, 
+					  second, out_ns, s, ns, i, n);
+    if (rv && !first_rv) { first_rv = rv; }
   }
+  return first_rv;
+}
 
-  dest->system = self->system;
-#if DEBUG_REBASED
-  printf("rebase_op[3]:   dest =  %s \n", dbg_pdate(dest));
 #endif
 
-  return 0;
+//! The CDC_KERNEL_XXX level in use, or -1 if we haven't looked yet.
+static int s_kernel_level = -1;
+
+static int kernel_hw_level(void)
+{
+#if CDC_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) { return CDC_KERNEL_AVX2; }
+  if (__builtin_cpu_supports("sse4.1")) { return CDC_KERNEL_SSE41; }
+#endif
+  return CDC_KERNEL_SCALAR;
 }
 
-static int system_rebased_epoch(struct cdc_zone_struct *self,
-				cdc_calendar_t *aux)
+int cdc_kernel_level(int max_level)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
+  int level;
 
-  return h->lower->epoch(h->lower, aux);
+  if (max_level >= 0)
+    {
+      level = kernel_hw_level();
+      if (level > max_level) { level = max_level; }
+      ATOMIC_STORE_RELEASE(&s_kernel_level, level);
+      return level;
+    }
+
+  level = ATOMIC_LOAD_ACQUIRE(&s_kernel_level);
+  if (level < 0)
+    {
+      // Anyone racing us will come up with the same answer.
+      level = kernel_hw_level();
+      ATOMIC_STORE_RELEASE(&s_kernel_level, level);
+    }
+  return level;
 }
 
-static int system_rebased_lower_zone(struct cdc_zone_struct *self,
-				  struct cdc_zone_struct **next)
+int cdc_tai_columns_to_instants(int64_t *s,
+				long int *out_ns,
+				const int *year,
+				const int *month,
+				const int *mday,
+				const int *hour,
+				const int *minute,
+				const int *second,
+				const long int *ns,
+				int n)
 {
-  cdc_rebased_handle_t *h = 
-    (cdc_rebased_handle_t *)self->handle;
+  if (n <= 0) { return 0; }
 
-  (*next) = h->lower;
+#if CDC_X86_KERNELS
+  switch (cdc_kernel_level(-1))
+    {
+    case CDC_KERNEL_AVX2:
+      columns_to_instants_avx2(s, out_ns, year, month, mday, hour,
+			       minute, second, ns, n);
+      return 0;
+    case CDC_KERNEL_SSE41:
+      columns_to_instants_sse41(s, out_ns, year, month, mday, hour,
+				minute, second, ns, n);
+      return 0;
+    default:
+      break;
+    }
+#endif
+
+  columns_to_instants_scalar(s, out_ns, year, month, mday, hour,
+			     minute, second, ns, 0, n);
   return 0;
 }
 
+int cdc_tai_columns_from_instants(int *year,
+				  int *month,
+				  int *mday,
+				  int *hour,
+				  int *minute,
+				  int *second,
+				  long int *out_ns,
+				  const int64_t *s,
+				  const long int *ns,
+				  int n)
+{
+  if (n <= 0) { return 0; }
 
-static void do_knockdown(cdc_calendar_t *io_diff, const cdc_calendar_t *offset, int *do_ls)  
+#if CDC_X86_KERNELS
+  switch (cdc_kernel_level(-1))
+    {
+    case CDC_KERNEL_AVX2:
+      return columns_from_instants_avx2(year, month, mday, hour, minute,
+					second, out_ns, s, ns, n);
+    case CDC_KERNEL_SSE41:
+      return columns_from_instants_sse41(year, month, mday, hour, minute,
+					 second, out_ns, s, ns, n);
+    default:
+      break;
+    }
+#endif
+
+  return columns_from_instants_scalar(year, month, mday, hour, minute,
+				      second, out_ns, s, ns, 0, n);
+}
+
+/* ---------------------- Bulk parsing -------------------- */
+
+/* cdc_calendar_parse_bulk() finds the end of each record with 
+ * memchr() and then tries the vector code on it: if the record 
+ * starts with a fixed layout YYYY-MM-DD hh:mm:ss[.nnnnnnnnn] time, 
+ * all of that is checked and converted at once and only the system 
+ * is scanned. Anything else goes to cdc_calendar_scan().
+ */
+
+//! Length of YYYY-MM-DD hh:mm:ss
+#define BULK_HEAD_LEN 19
+
+//! Length of YYYY-MM-DD hh:mm:ss.nnnnnnnnn
+#define BULK_FRAC_LEN 29
+
+//! The vector code reads (but doesn't look at all of) this much.
+#define BULK_LOAD_LEN 32
+
+#if CDC_X86_KERNELS
+
+/* Where the digits are in the first and second 16 bytes, shuffled 
+ * into pairs for maddubs: (Yh, Yl, MM, DD, hh, mm) and (ss, f0, f12,
+ * f34, f56, f78). 
+ */
+#define BULK_SHUFFLE_LO 0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, \
+    -1, -1, -1, -1
+#define BULK_SHUFFLE_HI 1, 2, -1, 4, 5, 6, 7, 8, 9, 10, 11, 12, \
+    -1, -1, -1, -1
+//! Digits in the first 16 bytes: 0-3, 5-6, 8-9, 11-12, 14-15.
+#define BULK_DIGITS_LO 0xdb6f
+//! Punctuation in the first 16 bytes: 4, 7, 10, 13.
+#define BULK_PUNCT_LO 0x2490
+//! ss at 17-18, in the second 16 bytes.
+#define BULK_DIGITS_HI 0x6
+//! ':' at 16.
+#define BULK_PUNCT_HI 0x1
+//! Fraction digits at 20-28.
+#define BULK_FRAC_DIGITS 0x1ff0
+//! '.' at 19.
+#define BULK_FRAC_PUNCT 0x8
+
+/** Are the digits and punctuation in the right places for a head 
+ *  (and a fraction)? Bit i of the masks is byte i of the 32.
+ */
+static int bulk_head_check(uint32_t digits, uint32_t puncts, int *frac9)
 {
-  // If we've suppressed knockdown, do nothing.
-  if (offset->flags & CDC_FLAG_AS_IF_NS) { return; }
+  uint32_t digits_hi = digits >> 16, puncts_hi = puncts >> 16;
 
-  int go = !!offset->year;
-  // Year offsets always happen
-  if (go) { io_diff->month = 0; }
-  go = go || !!offset->month;
-  if (go) { io_diff->mday = 0; }
-  go = go || !!offset->hour; 
-  if (go) { io_diff->hour = 0; }
-  go = go || !!offset->minute;
-  if (go) { io_diff->second = 0; (*do_ls) = 0; } 
-  go = go || !!offset->second;
-  if (go) { io_diff->ns = 0; }
+  if ((digits & BULK_DIGITS_LO) != BULK_DIGITS_LO || 
+      (puncts & BULK_PUNCT_LO) != BULK_PUNCT_LO ||
+      (digits_hi & BULK_DIGITS_HI) != BULK_DIGITS_HI ||
+      (puncts_hi & BULK_PUNCT_HI) != BULK_PUNCT_HI)
+    {
+      return 0;
+    }
+
+  (*frac9) = ((digits_hi & BULK_FRAC_DIGITS) == BULK_FRAC_DIGITS &&
+	      (puncts_hi & BULK_FRAC_PUNCT) == BULK_FRAC_PUNCT);
+  return 1;
 }
 
-static void cdc_negate(cdc_calendar_t *cal)
+/** Turn the pair sums the vector code leaves into a time. */
+static int bulk_head_finish(cdc_calendar_t *cal, const uint16_t *lo, 
+			    const uint16_t *hi, int frac9)
 {
-  cal->year = -cal->year;
-  cal->month = -cal->month;
-  cal->mday = -cal->mday;
-  cal->hour = -cal->hour;
-  cal->minute = -cal->minute;
-  cal->second = -cal->second;
-  cal->ns  = -cal->ns;
+  memset(cal, '\0', sizeof(cdc_calendar_t));
+  cal->year = (lo[0] * 100) + lo[1];
+  cal->month = lo[2] - 1;
+  cal->mday = lo[3];
+  cal->hour = lo[4];
+  cal->minute = lo[5];
+  cal->second = hi[0];
+  if (!frac9) { return BULK_HEAD_LEN; }
+
+  cal->ns = (hi[1] * 100000000L) + (hi[2] * 1000000L) + (hi[3] * 10000L) +
+    (hi[4] * 100L) + hi[5];
+  return BULK_FRAC_LEN;
 }
 
- 
-int cdc_simple_op(cdc_calendar_t *result,
-			       const cdc_calendar_t *a,
-			       const cdc_calendar_t *b,
-			       int op)
+/** Check and convert the fixed layout head of a time at p, which has
+ *  at least BULK_LOAD_LEN readable bytes.
+ *
+ * @return 0 if it's not there, BULK_HEAD_LEN if we've read up to the
+ *          seconds, BULK_FRAC_LEN if there was a nine digit fraction
+ *          too.
+ */
+__attribute__((target("sse4.1")))
+static int bulk_head_sse41(cdc_calendar_t *cal, const char *p)
 {
-  switch (op)
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i punct = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 
+				      0, 0, ' ', 0, 0, ':', 0, 0);
+  const __m128i punct_t = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 
+					0, 0, 'T', 0, 0, 0, 0, 0);
+  const __m128i punct_hi = _mm_setr_epi8(':', 0, 0, '.', 0, 0, 0, 0, 
+					 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i weights = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 
+					10, 1, 10, 1, 10, 1, 10, 1);
+  __m128i a = _mm_loadu_si128((const __m128i *)p);
+  __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+  __m128i da = _mm_sub_epi8(a, zero);
+  __m128i db = _mm_sub_epi8(b, zero);
+  uint16_t lo[8], hi[8];
+  uint32_t digits, puncts;
+  int frac9;
+
+  digits = (uint32_t)
+    _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(da, nine), da)) |
+    ((uint32_t)
+     _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(db, nine), db)) << 16);
+  puncts = (uint32_t)
+    _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(a, punct),
+				   _mm_cmpeq_epi8(a, punct_t))) |
+    ((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, punct_hi)) << 16);
+  if (!bulk_head_check(digits, puncts, &frac9)) { return 0; }
+
+  da = _mm_maddubs_epi16(_mm_shuffle_epi8(da, 
+					  _mm_setr_epi8(BULK_SHUFFLE_LO)),
+			 weights);
+  db = _mm_maddubs_epi16(_mm_shuffle_epi8(db, 
+					  _mm_setr_epi8(BULK_SHUFFLE_HI)),
+			 weights);
+  _mm_storeu_si128((__m128i *)lo, da);
+  _mm_storeu_si128((__m128i *)hi, db);
+  return bulk_head_finish(cal, lo, hi, frac9);
+}
+
+/** bulk_head_sse41(), with both halves in one register. */
+__attribute__((target("avx2")))
+static int bulk_head_avx2(cdc_calendar_t *cal, const char *p)
+{
+  const __m256i zero = _mm256_set1_epi8('0');
+  const __m256i nine = _mm256_set1_epi8(9);
+  const __m256i punct = _mm256_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 
+					 0, 0, ' ', 0, 0, ':', 0, 0,
+					 ':', 0, 0, '.', 0, 0, 0, 0, 
+					 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i punct_t = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 
+					   0, 0, 'T', 0, 0, 0, 0, 0,
+					   0, 0, 0, 0, 0, 0, 0, 0, 
+					   0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i weights = _mm256_set1_epi16(0x010a);
+  __m256i a = _mm256_loadu_si256((const __m256i *)p);
+  __m256i d = _mm256_sub_epi8(a, zero);
+  uint16_t words[16];
+  uint32_t digits, puncts;
+  int frac9;
+
+  digits = (uint32_t)_mm256_movemask_epi8(
+    _mm256_cmpeq_epi8(_mm256_min_epu8(d, nine), d));
+  puncts = (uint32_t)_mm256_movemask_epi8(
+    _mm256_or_si256(_mm256_cmpeq_epi8(a, punct), 
+		    _mm256_cmpeq_epi8(a, punct_t)));
+  if (!bulk_head_check(digits, puncts, &frac9))
     {
-    case CDC_OP_SIMPLE_ADD:
-    case CDC_OP_COMPLEX_ADD:
-    case CDC_OP_ZONE_ADD:
-      result->year = a->year + b->year;
-      result->month = a->month + b->month;
-      result->mday = a->mday + b->mday;
-      result->hour = a->hour + b->hour;
-      result->minute = a->minute + b->minute;
-      result->second = a->second + b->second;
-      result->ns = a->ns + b->ns;
-      break;
-    case CDC_OP_SUBTRACT:
-      result->year = a->year - b->year;
-      result->month = a->month - b->month;
-      result->mday = a->mday - b->mday;
-      result->hour = a->hour - b->hour;
-      result->minute = a->minute - b->minute;
-      result->second = a->second - b->second;
-      result->ns = a->ns - b->ns;
-      break;
-    default:
-      return CDC_ERR_INVALID_ARGUMENT;
+      _mm256_zeroupper();
+      return 0;
     }
 
-  result->system = a->system;
-  return 0;
+  d = _mm256_maddubs_epi16(
+    _mm256_shuffle_epi8(d, _mm256_setr_epi8(BULK_SHUFFLE_LO, 
+					    BULK_SHUFFLE_HI)),
+    weights);
+  _mm256_storeu_si256((__m256i *)words, d);
+  _mm256_zeroupper();
+  return bulk_head_finish(cal, words, words + 8, frac9);
 }
 
-int cdc_diff(cdc_zone_t *z,
-		  cdc_interval_t *result,
-		  const cdc_calendar_t *before,
-		  const cdc_calendar_t *after)
-{
-  memset(result, '\0', sizeof(cdc_interval_t));
-  return z->diff(z, result, before, after);
-}
+#endif
 
-int cdc_rebased_tai(struct cdc_zone_struct **dst,
-			 struct cdc_zone_struct *human_zone,
-			 const cdc_calendar_t *human_time,
-			 const cdc_calendar_t *machine_time)
+/** Parse the len characters at p as one record. */
+static int bulk_parse_one(cdc_calendar_t *out, const char *p, int len,
+			  int level, int loadable)
 {
+  const char *end = p + len;
+  const char *q = p;
+  cdc_calendar_t cal;
+  int got = 0;
   int rv;
-  cdc_calendar_t c1;
-  cdc_interval_t iv;
-  cdc_zone_t *lzone;
 
-#if DEBUG_REBASED
-  printf("> rebased_tai()\n");
+  (void)level; (void)loadable;
+#if CDC_X86_KERNELS
+  if (loadable && len >= BULK_HEAD_LEN)
+    {
+      if (level == CDC_KERNEL_AVX2) 
+	{
+	  got = bulk_head_avx2(&cal, p);
+	}
+      else if (level == CDC_KERNEL_SSE41)
+	{
+	  got = bulk_head_sse41(&cal, p);
+	}
+    }
 #endif
+  if (got == BULK_FRAC_LEN && 
+      (len < BULK_FRAC_LEN || 
+       (len > BULK_FRAC_LEN && SCAN_IS_DIGIT(p[BULK_FRAC_LEN]))))
+    {
+      // The fraction isn't all there, or there's more of it.
+      got = 0;
+    }
 
-  rv = cdc_zone_lower_to(human_zone, &c1, &lzone, human_time, machine_time->system);
-  if (rv) { return rv; }
+  if (!got)
+    {
+      int consumed;
 
-  // Otherwise ..
-  rv = cdc_diff(lzone, &iv, &c1, machine_time);
-  if (rv) { return rv; }
+      rv = cdc_calendar_scan(&cal, p, len, &consumed);
+      if (rv) { return rv; }
+      q = p + consumed;
+    }
+  else
+    {
+      q = p + got;
+      if (got == BULK_HEAD_LEN && q < end && (*q == '.' || *q == ','))
+	{
+	  ++q;
+	  rv = scan_fraction(&q, end, &cal.ns);
+	  if (rv) { return rv; }
+	}
+      rv = scan_zone(&q, end, &cal.system);
+      if (rv) { return rv; }
+    }
 
-  cdc_calendar_t offset;
+  // Trailing white space (a '\r', say) is fine; anything else isn't.
+  while (q < end && SCAN_IS_SPACE(*q)) { ++q; }
+  if (q != end) { return CDC_ERR_CANNOT_CONVERT; }
 
-  memset(&offset, '\0', sizeof(cdc_calendar_t));
-  offset.second = iv.s;
-  offset.ns = iv.ns;
-  offset.flags |= CDC_FLAG_AS_IF_NS;
-  offset.system = CDC_SYSTEM_OFFSET;
-  
-  rv = cdc_rebased_new(dst, &offset, lzone);
-  return rv;
+  memcpy(out, &cal, sizeof(cdc_calendar_t));
+  return 0;
 }
 
-// WARNING: This is a semi-clone of ZoneHandleT::FromSystem() in cdcpp.
-// If you change this, you must make a matching change in the other.
-int cdc_zone_from_system(cdc_zone_t **zone_o, uint32_t inSystem)
+int cdc_calendar_parse_bulk(cdc_calendar_t *out,
+			    int *errs,
+			    int max_out,
+			    int *nr_out,
+			    const char *buf,
+			    int n,
+			    char delim,
+			    int *consumed)
 {
-    if (inSystem > CDC_SYSTEM_UTCPLUS_BASE) {
-        int offset = inSystem - CDC_SYSTEM_UTCPLUS_ZERO;
-        return cdc_utcplus_new(zone_o, offset);
-    }
-    switch (inSystem) {
-        case CDC_SYSTEM_GREGORIAN_TAI:
-            return cdc_tai_new(zone_o);
-        case CDC_SYSTEM_UTC:
-            return cdc_utc_new(zone_o);
-        case CDC_SYSTEM_UKCT:
-            return cdc_ukct_new(zone_o);
-        // More cases go here.
-        default:
-            return CDC_ERR_BAD_SYSTEM;
+  const char *p = buf;
+  const char *end = buf + n;
+  int level = cdc_kernel_level(-1);
+  int first_rv = 0;
+  int i = 0;
+
+  if (n < 0 || max_out < 0) { return CDC_ERR_INVALID_ARGUMENT; }
+
+  while (p < end && i < max_out)
+    {
+      const char *rec_end = (const char *)memchr(p, delim, end - p);
+      const char *next;
+      int rv;
+
+      if (rec_end) 
+	{
+	  next = rec_end + 1;
+	}
+      else
+	{
+	  rec_end = end;
+	  next = end;
+	}
+
+      rv = bulk_parse_one(&out[i], p, (int)(rec_end - p), level,
+			  (end - p) >= BULK_LOAD_LEN);
+      BATCH_RESULT(rv, errs, i, first_rv);
+      ++i;
+      p = next;
     }
-}
 
+  if (nr_out) { (*nr_out) = i; }
+  if (consumed) { (*consumed) = (int)(p - buf); }
+  return first_rv;
+}
 
 /* End file */
@@ -89,7 +89,10 @@ namespace cdc
     {
         std::string ToString(const uint32_t inSystem)
         {
-            return std::string(cdc_describe_system(inSystem));
+            char buf[CDC_DESCRIBE_SYSTEM_MAX];
+
+            cdc_describe_system_r(buf, CDC_DESCRIBE_SYSTEM_MAX, inSystem);
+            return std::string(buf);
         }
     }
 
@@ -401,7 +404,7 @@ namespace cdc
     std::auto_ptr<ZoneHandleT> ZoneHandleT::FromSystem(uint32_t inSystem)
     {
 
-        if (inSystem > System::kUTCPlusBase)
+        if (inSystem >= System::kUTCPlusBase)
         {
             int offset = (inSystem - System::kUTCPlusBase) - (12*60);
             if (offset < -720 || offset > 1440)
@@ -419,6 +422,24 @@ namespace cdc
         }
     }
 
+    std::auto_ptr<ZoneHandleT> ZoneHandleT::Shared(uint32_t inSystem)
+    {
+        cdc_zone_t *h(NULL);
+        int rv;
+        rv = cdc_zone_get_shared(&h, inSystem);
+        if (rv) { throw ErrorExceptionT(rv); }
+        return std::auto_ptr<ZoneHandleT>(Wrap(h, false));
+    }
+
+    std::auto_ptr<ZoneHandleT> ZoneHandleT::Named(const std::string& inName)
+    {
+        cdc_zone_t *h(NULL);
+        int rv;
+        rv = cdc_registry_lookup_name(&h, inName.c_str());
+        if (rv) { throw ErrorExceptionT(rv); }
+        return std::auto_ptr<ZoneHandleT>(Wrap(h, false));
+    }
+
     std::string ErrorExceptionT::ToString() const
     {
         std::ostringstream ss;
@@ -556,8 +577,10 @@ namespace cdc
     
     std::string SystemToString(const unsigned int inSys)
     {
-        const char *b(cdc_describe_system(inSys));
-        return std::string(b);
+        char buf[CDC_DESCRIBE_SYSTEM_MAX];
+
+        cdc_describe_system_r(buf, CDC_DESCRIBE_SYSTEM_MAX, inSys);
+        return std::string(buf);
     }
 
 }
@@ -164,6 +164,12 @@ extern "C" {
 //! Cannot convert
 #define CDC_ERR_CANNOT_CONVERT       (-3992)
 
+//! Couldn't open or read a file
+#define CDC_ERR_NO_SUCH_FILE         (-3991)
+
+//! A file wasn't in the format we expected
+#define CDC_ERR_BAD_FORMAT           (-3990)
+
 
 /** Represents an interval.
  *
@@ -182,6 +188,23 @@ typedef struct cdc_interval_struct
   
 } cdc_interval_t;
 
+/** Represents an instant: a point on the TAI timescale, in seconds
+ *  and nanoseconds since 1958-01-01 00:00:00 TAI.
+ *
+ *  Unlike a calendar time this is linear, so differences and offsets
+ *  are just integer arithmetic. ns is always in [0, 1e9), so
+ *  instants before the epoch have negative s and positive ns.
+ */
+typedef struct cdc_instant_struct
+{
+  /** Seconds since the TAI epoch */
+  int64_t s;
+
+  /** Nanoseconds (0 - 999999999) */
+  long int ns;
+
+} cdc_instant_t;
+
 /** Represents a calendar time (wall clock or zone corrected) */
 typedef struct cdc_calendar_struct
 {
@@ -273,6 +296,11 @@ typedef struct cdc_calendar_aux_struct
  *
  *  The distinction is that offsets to your current date and time are applied to
  *  the calendar and then corrected by the offset.
+ *
+ *  The span and flags members were added to the end of this structure,
+ *  which changes its size and layout: code which builds its own zones 
+ *  must be rebuilt against this header, and should set span (or leave
+ *  it NULL, in which case cdc_zone_span() fails) and zero flags.
  */
 typedef struct cdc_zone_struct
 {
@@ -345,8 +373,39 @@ typedef struct cdc_zone_struct
   int (*lower_zone)(struct cdc_zone_struct *self,
 		    struct cdc_zone_struct **next);
 
+  /** Find the longest stretch of time around cal over which offset()
+   *  doesn't change. cal may be in this zone's system or the lower 
+   *  zone's, as for offset(); start (the first time in the span) and 
+   *  end (the first time after it) are in the same system as cal, 
+   *  and offset gets what offset() would give for any time in it.
+   *
+   *  A span which goes on forever starts in year INT_MIN or ends in
+   *  year INT_MAX.
+   *
+   *  Zones you build yourself must fill this in, or set it to NULL if
+   *  they can't say.
+   */
+  int (*span)(struct cdc_zone_struct *self,
+	      const cdc_calendar_t *cal,
+	      cdc_calendar_t *start,
+	      cdc_calendar_t *end,
+	      cdc_calendar_t *offset);
+
+  //! CDC_ZONE_FLAG_XXX
+  uint32_t flags;
+
 } cdc_zone_t;
 
+/** This zone is one of the process-wide zones from cdc_zone_get_shared():
+ *  it must not be changed, and cdc_zone_dispose() leaves it alone.
+ */
+#define CDC_ZONE_FLAG_SHARED (1<<0)
+
+/** This zone was made in an arena: it goes when the arena is reset
+ *  or disposed of, and cdc_zone_dispose() leaves it alone.
+ */
+#define CDC_ZONE_FLAG_ARENA  (1<<1)
+
 /** Add two intervals */
 int cdc_interval_add(cdc_interval_t *result,
 			  const cdc_interval_t *a,
@@ -382,26 +441,213 @@ int cdc_calendar_sprintf(char *buf,
 			      int n,
 			      const cdc_calendar_t *date);
 
+//! cdc_calendar_format(): write RFC 3339 - a 'T' between date and 
+//! time, and 'Z' or +hh:mm rather than the system name.
+#define CDC_FORMAT_RFC3339 (1<<0)
+
+/** Print a calendar time into buf: with no flags, this is what 
+ *  cdc_calendar_sprintf() writes. As for snprintf(), at most n 
+ *  characters (including the terminating NUL) are written.
+ *
+ * @return The length of the whole time (which may be more than was
+ *          written), or CDC_ERR_BAD_SYSTEM if the system can't be 
+ *          written in RFC 3339 (anything but UTC and UTC-plus).
+ */
+int cdc_calendar_format(char *buf,
+			int n,
+			const cdc_calendar_t *date,
+			int flags);
+
 /** Parse an interval in %lld.%lld s format */
 int cdc_interval_parse(cdc_interval_t *out,
                        const char *buf,
                        const int n);
 
-/** Parse a calendar time in ISO format */
+/** Parse a calendar time in ISO format: what cdc_calendar_sprintf()
+ *  writes, or RFC 3339 ('T' separator, any number of fraction digits,
+ *  and 'Z' for UTC or +hh:mm for a UTC-plus system). Stops at n 
+ *  characters or a NUL, whichever comes first, and ignores anything
+ *  after the time.
+ *
+ * @return 0 on success, CDC_ERR_CANNOT_CONVERT if the time is 
+ *          malformed, CDC_ERR_BAD_SYSTEM if the system is.
+ */
 int cdc_calendar_parse(cdc_calendar_t *out,
                        const char *buf,
                        const int n);
 
+/** As cdc_calendar_parse(), but if consumed isn't NULL, it gets the 
+ *  number of characters the time took up, so you can parse the next 
+ *  thing in the buffer.
+ */
+int cdc_calendar_scan(cdc_calendar_t *out,
+		      const char *buf,
+		      int n,
+		      int *consumed);
+
+
+/** Parse a buffer of times, one to a record, with records ending in
+ *  delim ('\n' for a file of times, ',' for a CSV column, ..): 
+ *  out[i] is what cdc_calendar_parse() gives for record i, apart 
+ *  from white space at the end of a record, which is ignored. The 
+ *  last record needn't end with delim. Stops after max_out records.
+ *
+ *  Records in the layout cdc_calendar_sprintf() writes (with 'T' or 
+ *  ' ' separators) are checked and converted with vector 
+ *  instructions where the CPU has them (see cdc_kernel_level()).
+ *
+ *  nr_out, if not NULL, gets the number of records parsed and 
+ *  consumed, if not NULL, how many characters of buf they took up.
+ *  Errors are as cdc_zone_raise_batch().
+ */
+int cdc_calendar_parse_bulk(cdc_calendar_t *out,
+			    int *errs,
+			    int max_out,
+			    int *nr_out,
+			    const char *buf,
+			    int n,
+			    char delim,
+			    int *consumed);
 
 /** Return the sign of an interval */
 int cdc_interval_sgn(const cdc_interval_t *a);			      
 
-/** Describe this system as a string, returned in a static buffer */
+/** Describe this system as a string. The buffer it's returned in 
+ *  belongs to the calling thread, and is overwritten by the next 
+ *  call from that thread.
+ */
 const char *cdc_describe_system(const int system);
 
+//! Room cdc_describe_system_r() needs for any system: UTC-1200* or
+//! REBASED*, and a NUL.
+#define CDC_DESCRIBE_SYSTEM_MAX 16
+
+/** Describe this system into buf, which has room for n characters 
+ *  including the terminating NUL. 
+ *
+ * @return The length of the description, as snprintf().
+ */
+int cdc_describe_system_r(char *buf, int n, const int system);
+
 /** Reconstruct a system from its description, if you can */
 int cdc_undescribe_system(unsigned int *out_sys, const char *in_desc);
 
+/** Convert a proleptic Gregorian date to a day number, counting
+ *  1 January 1958 (the TAI epoch) as day 0.
+ *
+ *  month is 0-based and mday 1-based, as in cdc_calendar_t. Out of
+ *  range months and days are folded in linearly, so (2010, 12, 1) is
+ *  1 January 2011 and (2010, 0, 0) is 31 December 2009.
+ *
+ *  This is closed-form - it costs the same however far from the epoch
+ *  you are.
+ *
+ * @return 0 on success, < 0 on failure.
+ */
+int cdc_days_from_civil(int64_t *days, int year, int month, int mday);
+
+/** The inverse of cdc_days_from_civil(): convert a day number back
+ *  to a (normalised) proleptic Gregorian date.
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if the year won't
+ *          fit in an int.
+ */
+int cdc_civil_from_days(int *year, int *month, int *mday, int64_t days);
+
+/** Convert a calendar time in 'zone' to an instant, by lowering it
+ *  all the way to TAI.
+ *
+ * @return 0 on success, CDC_ERR_CANNOT_CONVERT if the zone doesn't
+ *          bottom out in TAI, < 0 on other failures.
+ */
+int cdc_zone_to_instant(cdc_zone_t *zone,
+			cdc_instant_t *out,
+			const cdc_calendar_t *src);
+
+/** Convert an instant to a calendar time in 'zone'.
+ *
+ * @return 0 on success, < 0 on failure.
+ */
+int cdc_zone_from_instant(cdc_zone_t *zone,
+			  cdc_calendar_t *out,
+			  const cdc_instant_t *src);
+
+/** Compare two instants: returns -1, 0 or 1 as a is less than, 
+ *  equal to or greater than b.
+ */
+int cdc_instant_cmp(const cdc_instant_t *a,
+		    const cdc_instant_t *b);
+
+/** Find the interval between two instants. As with cdc_diff(),
+ *  a negative interval has both its s and ns negative.
+ */
+int cdc_instant_diff(cdc_interval_t *result,
+		     const cdc_instant_t *before,
+		     const cdc_instant_t *after);
+
+/** Add an interval to an instant 
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if the result 
+ *          overflows.
+ */
+int cdc_instant_add(cdc_instant_t *result,
+		    const cdc_instant_t *a,
+		    const cdc_interval_t *ival);
+
+/** Convert n Gregorian TAI times, given as columns of fields, to 
+ *  instants: (s[i], out_ns[i]) is what cdc_zone_to_instant() would 
+ *  give for (year[i], month[i], ... ns[i]) in a TAI zone. As there,
+ *  fields may be out of range.
+ *
+ *  Where the CPU has them, this uses vector instructions for runs of
+ *  times with sensible fields, and falls back to doing one at a time
+ *  for the rest.
+ *
+ * @return 0 on success, < 0 on failure.
+ */
+int cdc_tai_columns_to_instants(int64_t *s,
+				long int *out_ns,
+				const int *year,
+				const int *month,
+				const int *mday,
+				const int *hour,
+				const int *minute,
+				const int *second,
+				const long int *ns,
+				int n);
+
+/** The inverse of cdc_tai_columns_to_instants(), as 
+ *  cdc_zone_from_instant() in a TAI zone.
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if any year won't
+ *          fit in an int (in which case that element is undefined).
+ */
+int cdc_tai_columns_from_instants(int *year,
+				  int *month,
+				  int *mday,
+				  int *hour,
+				  int *minute,
+				  int *second,
+				  long int *out_ns,
+				  const int64_t *s,
+				  const long int *ns,
+				  int n);
+
+//! Column kernels: plain C.
+#define CDC_KERNEL_SCALAR 0
+//! Column kernels: SSE4.1.
+#define CDC_KERNEL_SSE41  1
+//! Column kernels: AVX2.
+#define CDC_KERNEL_AVX2   2
+
+/** Find which instruction set the column kernels use. If max_level
+ *  is >= 0, first stop them using anything better than that (it's 
+ *  mostly useful for testing). 
+ *
+ * @return The CDC_KERNEL_XXX level in use.
+ */
+int cdc_kernel_level(int max_level);
+
 /** Add two calendar times fieldwise */
 int cdc_simple_op(cdc_calendar_t *result,
 		       const cdc_calendar_t *a,
@@ -410,7 +656,8 @@ int cdc_simple_op(cdc_calendar_t *result,
 			
 
 /** Find the difference between two calendar times; this is 
- *  really a shim on top of the diff() method 
+ *  really a shim on top of the diff() method. For the built-in
+ *  zones, the difference is taken between instants.
  *
  *  Unlike the diff() method, this function zeroes result,
  *  so can't (easily) accumulate dates.
@@ -422,8 +669,12 @@ int cdc_diff(cdc_zone_t *z,
 
 
 
-/** Add an interval to a calendar time and normalise. This is essentially
- *  a repeated add.
+/** Add an interval to a calendar time and normalise. Any interval
+ *  will do - large ones are applied as whole Gregorian cycles, days
+ *  and seconds in a single op.
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if the result
+ *          would not fit in a cdc_calendar_t.
  */
 int cdc_zone_add(cdc_zone_t *zone,
 		      cdc_calendar_t *out,
@@ -515,6 +766,19 @@ int cdc_zone_lower(cdc_zone_t *zone,
 			cdc_zone_t **lzone,
 			const cdc_calendar_t *src);
 
+/** Find the span of times around cal over which zone's offset is 
+ *  constant, so that every time in [start, end) can be raised to 
+ *  zone by adding the same offset. See cdc_zone_t::span().
+ *
+ * @return 0 on success, CDC_ERR_NOT_MY_SYSTEM if the zone has no 
+ *          span(), or whatever span() returns.
+ */
+int cdc_zone_span(cdc_zone_t *zone,
+		  const cdc_calendar_t *cal,
+		  cdc_calendar_t *start,
+		  cdc_calendar_t *end,
+		  cdc_calendar_t *offset);
+
 /** Lower a date to a given system, or if the system is -1, down to 
  *  the lowest zone we can.
  */
@@ -524,6 +788,269 @@ int cdc_zone_lower_to(cdc_zone_t *zone,
 			   const cdc_calendar_t *src,
 			   int to_system);
 
+/** Raise n dates at once: dest[i] = src[i] raised to 'zone', as 
+ *  cdc_zone_raise(). The zone chain is worked out once for the whole
+ *  batch. dest may be the same array as src.
+ *
+ *  One bad element doesn't stop the rest: if errs is not NULL, 
+ *  errs[i] gets the result for element i (and dest[i] is undefined
+ *  if it's not 0). Elements from a system which isn't in zone's 
+ *  chain at all fail with CDC_ERR_NOT_MY_SYSTEM.
+ *
+ * @return 0 if every element succeeded, else the error for the first
+ *          element that failed.
+ */
+int cdc_zone_raise_batch(cdc_zone_t *zone,
+			 cdc_calendar_t *dest,
+			 const cdc_calendar_t *src,
+			 int n,
+			 int *errs);
+
+/** Lower n dates at once, as cdc_zone_lower_to(); lzone, if not NULL,
+ *  is an array of n which gets the zone each result is in. Errors 
+ *  are as cdc_zone_raise_batch().
+ */
+int cdc_zone_lower_to_batch(cdc_zone_t *zone,
+			    cdc_calendar_t *dest,
+			    cdc_zone_t **lzone,
+			    const cdc_calendar_t *src,
+			    int n,
+			    int to_system,
+			    int *errs);
+
+/** Bounce n dates at once, as cdc_bounce(). Errors are as 
+ *  cdc_zone_raise_batch().
+ */
+int cdc_bounce_batch(struct cdc_zone_struct *down_zone,
+		     struct cdc_zone_struct *up_zone,
+		     cdc_calendar_t *dst,
+		     const cdc_calendar_t *src,
+		     int n,
+		     int *errs);
+
+//! Batch flag: use the first (and only) element of the first operand
+//! array for every element of the batch.
+#define CDC_BATCH_FIXED_A (1<<0)
+
+//! Batch flag: use the first (and only) element of the second operand
+//! array for every element of the batch.
+#define CDC_BATCH_FIXED_B (1<<1)
+
+/** result[i] = cdc_diff(z, before[i], after[i]) for n elements. With
+ *  CDC_BATCH_FIXED_A, before is a single time which every after[i] 
+ *  is measured from; with CDC_BATCH_FIXED_B, after is a single time 
+ *  every before[i] is measured to. Fixed times are only converted 
+ *  once, and conversions keep their place in the leap second table
+ *  from one element to the next. Errors are as 
+ *  cdc_zone_raise_batch().
+ */
+int cdc_diff_batch(cdc_zone_t *z,
+		   cdc_interval_t *result,
+		   const cdc_calendar_t *before,
+		   const cdc_calendar_t *after,
+		   int n,
+		   int flags,
+		   int *errs);
+
+/** out[i] = cdc_zone_add(zone, date[i], ival[i]) for n elements. 
+ *  CDC_BATCH_FIXED_A adds every ival[i] to the single time date; 
+ *  CDC_BATCH_FIXED_B adds the single interval ival to every date[i].
+ *  out may be the same array as date. Errors are as 
+ *  cdc_zone_raise_batch().
+ */
+int cdc_zone_add_batch(cdc_zone_t *zone,
+		       cdc_calendar_t *out,
+		       const cdc_calendar_t *date,
+		       const cdc_interval_t *ival,
+		       int n,
+		       int flags,
+		       int *errs);
+
+/** Converts a stream of times from one zone to another, as 
+ *  cdc_bounce(). It remembers where the last time was in the leap 
+ *  second table and which year's BST changes it was looking at, and
+ *  starts from there next time; so a stream which is (mostly) in 
+ *  time order is converted without searching either. Out of order 
+ *  times still convert correctly, just more slowly.
+ *
+ *  A converter refers to, but doesn't own, its zones. It's not 
+ *  thread-safe: use one per stream.
+ */
+typedef struct cdc_stream_converter_struct cdc_stream_converter_t;
+
+/** Create a converter from times in from_zone to times in to_zone.
+ *
+ * @return 0 on success, CDC_ERR_INIT_FAILED if we ran out of memory.
+ */
+int cdc_stream_converter_new(cdc_stream_converter_t **out,
+			     cdc_zone_t *from_zone,
+			     cdc_zone_t *to_zone);
+
+/** Dispose of a converter */
+int cdc_stream_converter_dispose(cdc_stream_converter_t **io_conv);
+
+/** Convert the next time in the stream, as cdc_bounce(). */
+int cdc_stream_convert(cdc_stream_converter_t *conv,
+		       cdc_calendar_t *dst,
+		       const cdc_calendar_t *src);
+
+/** Convert the next n times in the stream. Errors are as 
+ *  cdc_zone_raise_batch().
+ */
+int cdc_stream_convert_batch(cdc_stream_converter_t *conv,
+			     cdc_calendar_t *dst,
+			     const cdc_calendar_t *src,
+			     int n,
+			     int *errs);
+
+/** A compiled conversion from one zone to another, as cdc_bounce():
+ *  the zones to lower through and raise through are found once, when
+ *  the plan is compiled, rather than on every conversion. 
+ *
+ *  A plan refers to, but doesn't own, its zones. It's never changed
+ *  once compiled, so any number of threads may apply it at once.
+ */
+typedef struct cdc_plan_struct cdc_plan_t;
+
+/** Compile a plan for converting times in down_zone to times in 
+ *  up_zone.
+ *
+ * @return 0 on success, CDC_ERR_INIT_FAILED if we ran out of memory,
+ *          CDC_ERR_NOT_MY_SYSTEM if the bottom of down_zone's chain
+ *          isn't in up_zone's (so there's no conversion), 
+ *          CDC_ERR_INVALID_ARGUMENT if a chain is too long to compile.
+ */
+int cdc_plan_compile(cdc_plan_t **out,
+		     cdc_zone_t *down_zone,
+		     cdc_zone_t *up_zone);
+
+/** Dispose of a plan */
+int cdc_plan_dispose(cdc_plan_t **io_plan);
+
+/** Convert src, as cdc_bounce(). src is normally in down_zone's 
+ *  system; a time in one of the zones below is converted too, just
+ *  without the plan.
+ */
+int cdc_plan_apply(const cdc_plan_t *plan,
+		   cdc_calendar_t *dst,
+		   const cdc_calendar_t *src);
+
+/** Convert n times. Like a stream converter, this starts looking for
+ *  each time's leap second and BST change where the last one was 
+ *  found. Errors are as cdc_zone_raise_batch().
+ */
+int cdc_plan_apply_batch(const cdc_plan_t *plan,
+			 cdc_calendar_t *dst,
+			 const cdc_calendar_t *src,
+			 int n,
+			 int *errs);
+
+/** A run of calendar times in the same system, kept a field to an 
+ *  array so that code which only wants (say) the dates doesn't drag
+ *  the rest through the cache. Fields are narrower than in 
+ *  cdc_calendar_t, so an out of range field that won't fit can't be
+ *  stored; flags aren't kept at all.
+ *
+ *  Make them with cdc_calendar_columns_new() - the arrays are 
+ *  allocated with the structure - and dispose of them with 
+ *  cdc_calendar_columns_dispose().
+ */
+typedef struct cdc_calendar_columns_struct
+{
+  //! Number of times.
+  int n;
+
+  //! Number of times there's room for.
+  int capacity;
+
+  //! The system every time is in.
+  uint32_t system;
+
+  int32_t *year;
+  int8_t *month;
+  int8_t *mday;
+  int8_t *hour;
+  int8_t *minute;
+  int8_t *second;
+  int32_t *ns;
+
+} cdc_calendar_columns_t;
+
+/** Create an empty set of columns with room for capacity times.
+ *
+ * @return 0 on success, CDC_ERR_INIT_FAILED if we ran out of memory.
+ */
+int cdc_calendar_columns_new(cdc_calendar_columns_t **out, int capacity);
+
+/** Dispose of a set of columns */
+int cdc_calendar_columns_dispose(cdc_calendar_columns_t **io_cols);
+
+/** Fill cols from n times, which must all be in the same system. 
+ *
+ * @return 0 on success, CDC_ERR_SYSTEMS_DO_NOT_MATCH if they aren't,
+ *          CDC_ERR_INVALID_ARGUMENT if n is more than the capacity 
+ *          or a field won't fit (cols is undefined after an error).
+ */
+int cdc_calendar_columns_from_array(cdc_calendar_columns_t *cols,
+				    const cdc_calendar_t *src,
+				    int n);
+
+/** Copy cols out to cols->n times in dst (with flags 0). */
+int cdc_calendar_columns_to_array(cdc_calendar_t *dst,
+				  const cdc_calendar_columns_t *cols);
+
+/** Raise every time in src to zone, as cdc_zone_raise_batch(). dest
+ *  may be src. Element errors are as cdc_zone_raise_batch(), plus 
+ *  CDC_ERR_INVALID_ARGUMENT for a result that won't fit.
+ *
+ * @return 0 if every element succeeded, CDC_ERR_INVALID_ARGUMENT if 
+ *          dest doesn't have room for them all, else the error for 
+ *          the first element that failed.
+ */
+int cdc_zone_raise_columns(cdc_zone_t *zone,
+			   cdc_calendar_columns_t *dest,
+			   const cdc_calendar_columns_t *src,
+			   int *errs);
+
+/** Lower every time in src, as cdc_zone_lower_to_batch(). If 
+ *  to_system is -1, dest is in the system at the bottom of zone's 
+ *  chain, and elements that don't get there fail with 
+ *  CDC_ERR_SYSTEMS_DO_NOT_MATCH. Errors are otherwise as 
+ *  cdc_zone_raise_columns().
+ */
+int cdc_zone_lower_to_columns(cdc_zone_t *zone,
+			      cdc_calendar_columns_t *dest,
+			      const cdc_calendar_columns_t *src,
+			      int to_system,
+			      int *errs);
+
+/** Bounce every time in src, as cdc_bounce_batch(). Errors are as 
+ *  cdc_zone_raise_columns().
+ */
+int cdc_bounce_columns(cdc_zone_t *down_zone,
+		       cdc_zone_t *up_zone,
+		       cdc_calendar_columns_t *dest,
+		       const cdc_calendar_columns_t *src,
+		       int *errs);
+
+/** out[i] = cdc_zone_to_instant(zone, src[i]). Columns of TAI times
+ *  go through cdc_tai_columns_to_instants(). Errors are as 
+ *  cdc_zone_raise_batch().
+ */
+int cdc_zone_columns_to_instants(cdc_zone_t *zone,
+				 cdc_instant_t *out,
+				 const cdc_calendar_columns_t *src,
+				 int *errs);
+
+/** dest[i] = cdc_zone_from_instant(zone, src[i]) for n instants: the
+ *  TAI times come from cdc_tai_columns_from_instants() and are then
+ *  raised to zone. Errors are as cdc_zone_raise_columns().
+ */
+int cdc_zone_columns_from_instants(cdc_zone_t *zone,
+				   cdc_calendar_columns_t *dest,
+				   const cdc_instant_t *src,
+				   int n,
+				   int *errs);
 
 /** Creates a raw zone for a given zone code.
  * This DOES NOT set up the chain of zones that enables raising and
@@ -544,7 +1071,63 @@ int cdc_zone_new(int system,
 int cdc_zone_from_system(cdc_zone_t **zone_o, uint32_t inSystem);
 
 
-/** Dispose of a zone */
+/** Get the process-wide zone for a built-in system (TAI, UTC, UKCT
+ *  or any UTC-plus offset). Unlike cdc_zone_from_system() this 
+ *  doesn't allocate: the zones and the chains beneath them are never
+ *  changed or freed, so any number of threads may use them at once
+ *  and the pointer stays good for the life of the process.
+ *
+ *  Disposing of a shared zone does nothing, so code which disposes 
+ *  of whatever it gets back from cdc_zone_from_system() can use these
+ *  too.
+ *
+ * @return 0 on success, CDC_ERR_BAD_SYSTEM if there is no shared 
+ *          zone for this system.
+ */
+int cdc_zone_get_shared(cdc_zone_t **zone_o, uint32_t inSystem);
+
+//! Room for the longest name cdc_registry_register() will take, and
+//! a NUL.
+#define CDC_REGISTRY_NAME_MAX 32
+
+/** Register zone under name, for cdc_registry_lookup_name(). If it's
+ *  the first zone registered with its system, cdc_registry_lookup_system()
+ *  will find it too. 
+ *
+ *  Names are never unregistered, so the zone must last as long as the
+ *  process does; the registry doesn't take ownership of it. The names
+ *  of built-in systems ("UTC", "UTC+0530", ...) always find the shared
+ *  zones and can't be registered.
+ *
+ *  Safe to call while other threads are registering or looking up.
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if name is empty, too
+ *          long, already registered or a built-in system's, 
+ *          CDC_ERR_INIT_FAILED if the registry is full.
+ */
+int cdc_registry_register(const char *name, cdc_zone_t *zone);
+
+/** Find the zone for name: a registered zone, or the shared zone for
+ *  a built-in system as cdc_undescribe_system() would read it. Takes
+ *  about the same time however many zones are registered, and never 
+ *  allocates, so it's cheap enough to call per request. 
+ *
+ * @return 0 on success, CDC_ERR_NO_SUCH_SYSTEM if there's no such 
+ *          zone (or name is NULL).
+ */
+int cdc_registry_lookup_name(cdc_zone_t **zone_o, const char *name);
+
+/** Find the zone for a system: the shared zone for a built-in system,
+ *  else the first zone registered with that system.
+ *
+ * @return 0 on success, CDC_ERR_NO_SUCH_SYSTEM if there's no such 
+ *          zone.
+ */
+int cdc_registry_lookup_system(cdc_zone_t **zone_o, uint32_t inSystem);
+
+/** Dispose of a zone; does nothing to a shared zone or one made in
+ *  an arena. 
+ */
 int cdc_zone_dispose(cdc_zone_t **io_zone);
 
 /** Easy creation functions for common time zones */
@@ -555,6 +1138,35 @@ int cdc_zone_dispose(cdc_zone_t **io_zone);
 int cdc_utc_new(cdc_zone_t **ozone);
 int cdc_tai_new(cdc_zone_t **ozone);
 
+/** Replace the leap second table used by every UTC-derived zone with
+ *  one read from 'path', in the format of the IERS/NIST 
+ *  leap-seconds.list file (NTP seconds of each UTC midnight at which 
+ *  TAI - UTC changes, then the new TAI - UTC). Offsets before the 
+ *  first entry in the file are the built-in pre-1972 ones.
+ *
+ *  Pass NULL to go back to the built-in table.
+ *
+ *  This is safe to call while other threads are converting UTC times:
+ *  each conversion uses either the old table or the new one 
+ *  throughout. Replaced tables are never freed, since a conversion
+ *  might still be using them.
+ *
+ * @return 0 on success, CDC_ERR_NO_SUCH_FILE if the file can't be 
+ *          read, CDC_ERR_BAD_FORMAT if it's malformed or contains a
+ *          negative leap second (which we can't represent). On 
+ *          failure the table in use is unchanged.
+ */
+int cdc_utc_load_leap_table(const char *path);
+
+/** Re-read the leap second table from the file it was last loaded 
+ *  from, for long-running processes which need to pick up newly
+ *  announced leap seconds. Does nothing if the built-in table is in 
+ *  use, or if the file hasn't changed.
+ *
+ * @return 0 on success, or as cdc_utc_load_leap_table().
+ */
+int cdc_utc_reload_leap_table(void);
+
 int cdc_utcplus_new(cdc_zone_t **ozone, int offset);
 int cdc_ukct_new(cdc_zone_t **ozone); // SYSTEM_UKCT
 
@@ -563,6 +1175,56 @@ int cdc_rebased_new(cdc_zone_t **ozone,
 			 const cdc_calendar_t *offset,
 			 cdc_zone_t *based_on);
 
+/** Somewhere to make zones which don't last long - a rebased zone for
+ *  each clock sync, say - without going to malloc() for each one.
+ *  Zones made in an arena are all released at once, by resetting or
+ *  disposing of the arena; until then, they're used just like any
+ *  other zone. The built-in zones don't need an arena: use 
+ *  cdc_zone_get_shared().
+ *
+ *  An arena isn't thread-safe: use one per thread.
+ */
+typedef struct cdc_arena_struct cdc_arena_t;
+
+/** Create an arena which gets memory from malloc() block_size bytes
+ *  at a time (0 for a default of 64k). 
+ *
+ * @return 0 on success, CDC_ERR_INVALID_ARGUMENT if block_size is 
+ *          negative, CDC_ERR_INIT_FAILED if we ran out of memory.
+ */
+int cdc_arena_new(cdc_arena_t **out, int block_size);
+
+/** Release every zone made in the arena, keeping its memory for the
+ *  next ones.
+ */
+int cdc_arena_reset(cdc_arena_t *arena);
+
+/** Release every zone made in the arena, and the arena itself. */
+int cdc_arena_dispose(cdc_arena_t **io_arena);
+
+/** As cdc_zone_new(), in an arena. A call which fails leaves nothing
+ *  behind in the arena.
+ *
+ * @return 0 on success, CDC_ERR_NO_SUCH_SYSTEM, or 
+ *          CDC_ERR_INIT_FAILED if we ran out of memory or the zone 
+ *          couldn't be set up.
+ */
+int cdc_arena_zone_new(cdc_arena_t *arena,
+		       int system,
+		       cdc_zone_t **out_zone,
+		       int arg_i,
+		       void *arg_n);
+
+/** As cdc_rebased_new(), in an arena. The zone and its handle come
+ *  from the arena; based_on can be any zone, and still isn't owned.
+ *
+ * @return 0 on success, CDC_ERR_INIT_FAILED if we ran out of memory.
+ */
+int cdc_arena_rebased_new(cdc_arena_t *arena,
+			  cdc_zone_t **ozone,
+			  const cdc_calendar_t *offset,
+			  cdc_zone_t *based_on);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -247,6 +247,20 @@ namespace cdc
         /** Get a zone handle from a system; will throw if the system is invalid or unrecognised. */
         static std::auto_ptr<ZoneHandleT> FromSystem(uint32_t inSystem);
 
+        /** Get a handle to the process-wide zone for a built-in system, 
+         *  as cdc_zone_get_shared(). The handle doesn't own the zone, so 
+         *  it's cheap to make and throw away; will throw if there's no 
+         *  shared zone for the system.
+         */
+        static std::auto_ptr<ZoneHandleT> Shared(uint32_t inSystem);
+
+        /** Get a handle to the zone registered under a name, or the 
+         *  shared zone for a built-in system's name, as 
+         *  cdc_registry_lookup_name(). The handle doesn't own the zone;
+         *  will throw if there's no such zone.
+         */
+        static std::auto_ptr<ZoneHandleT> Named(const std::string& inName);
+
         
 
         uint32_t GetSystem(void) const;
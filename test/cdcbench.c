@@ -0,0 +1,698 @@
+/* cdcbench.c */
+/* (C) Metropolitan Police 2010 */
+
+/*
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See the
+ * License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is cdatecalc, http://code.google.com/p/cdatecalc
+ *
+ * The Initial Developer of the Original Code is the Metropolitan Police
+ * All Rights Reserved.
+ */
+
+/** @file
+ *
+ * Micro-benchmarks for cdc. Prints the average cost of each operation
+ *  in ns; pass an iteration count as the first argument to change
+ *  how long it runs for.
+ *
+ */
+
+#include <stdint.h>
+#include "cdc/cdc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 20000
+
+#define BENCH_CHECK(x) { int rv_ = (x); if (rv_) { \
+      fprintf(stderr, "%s:%d: %s failed (rv = %d)\n", __FILE__, __LINE__, #x, rv_); \
+      exit(1); } }
+
+static double elapsed_ns(clock_t start, clock_t end)
+{
+  return ((double)(end - start) * 1.0e9) / CLOCKS_PER_SEC;
+}
+
+/** Time cdc_zone_add() for a range of interval magnitudes in 'zone'.
+ *  The cost ought not to depend on the magnitude.
+ */
+static void bench_zone_add(cdc_zone_t *zone,
+			   const cdc_calendar_t *start,
+			   int iterations)
+{
+  static const int shifts[] = { 10, 20, 30, 33, 40, 50, 55 };
+  const char *desc = cdc_describe_system(zone->system);
+  cdc_calendar_t out;
+  cdc_interval_t iv;
+  size_t i;
+
+  for (i = 0; i < sizeof(shifts)/sizeof(shifts[0]); ++i)
+    {
+      clock_t before, after;
+      int n;
+
+      iv.s = ((int64_t)1 << shifts[i]) + 12345;
+      iv.ns = 678;
+
+      before = clock();
+      for (n = 0; n < iterations; ++n)
+	{
+	  // Alternate the sign so we stay in a sensible range.
+	  iv.s = -iv.s;
+	  BENCH_CHECK(cdc_zone_add(zone, &out, start, &iv));
+	}
+      after = clock();
+
+      printf("zone_add %-5s 2^%-2d s : %10.1f ns/op\n", desc, shifts[i],
+	     elapsed_ns(before, after) / iterations);
+    }
+}
+
+/** Time a fieldwise cdc_op() of a few common sizes in 'zone'. */
+static void bench_op(cdc_zone_t *zone,
+		     const cdc_calendar_t *start,
+		     int iterations)
+{
+  static const struct 
+  {
+    const char *desc;
+    cdc_calendar_t offset;
+  } offsets[] = 
+    {
+      { "1h", { 0, 0, 0, 1, 0, 0, 0, CDC_SYSTEM_INVALID } },
+      { "1d", { 0, 0, 1, 0, 0, 0, 0, CDC_SYSTEM_INVALID } },
+      { "1m", { 0, 1, 0, 0, 0, 0, 0, CDC_SYSTEM_INVALID } },
+      { "1y", { 1, 0, 0, 0, 0, 0, 0, CDC_SYSTEM_INVALID } }
+    };
+  const char *desc = cdc_describe_system(zone->system);
+  cdc_calendar_t out;
+  size_t i;
+
+  for (i = 0; i < sizeof(offsets)/sizeof(offsets[0]); ++i)
+    {
+      clock_t before, after;
+      int n;
+
+      before = clock();
+      for (n = 0; n < iterations; ++n)
+	{
+	  BENCH_CHECK(cdc_op(zone, &out, start, &offsets[i].offset, 
+			     CDC_OP_COMPLEX_ADD));
+	}
+      after = clock();
+
+      printf("op       %-5s +%-5s : %10.1f ns/op\n", desc, offsets[i].desc,
+	     elapsed_ns(before, after) / iterations);
+    }
+}
+
+/** Time converting a column of times from 'down' to 'up', one at a
+ *  time, as a batch and through a stream converter.
+ */
+static void bench_bounce(cdc_zone_t *down, cdc_zone_t *up,
+			 const cdc_calendar_t *start,
+			 int iterations)
+{
+  char down_desc[32];
+  cdc_stream_converter_t *conv;
+  cdc_plan_t *plan;
+  cdc_calendar_t *src, *dst;
+  cdc_interval_t step;
+  clock_t before, after;
+  int n;
+
+  // cdc_describe_system() reuses its buffer.
+  snprintf(down_desc, sizeof(down_desc), "%s", 
+	   cdc_describe_system(down->system));
+
+  src = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  dst = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  if (!src || !dst) { fprintf(stderr, "Out of memory\n"); exit(1); }
+
+  // A column of times an hour and a bit apart.
+  step.s = 3607; step.ns = 0;
+  memcpy(&src[0], start, sizeof(cdc_calendar_t));
+  for (n = 1; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_add(down, &src[n], &src[n-1], &step));
+    }
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_bounce(down, up, &dst[n], &src[n]));
+    }
+  after = clock();
+  printf("bounce   %-5s ->%-3s single: %8.1f ns/op\n", down_desc, 
+	 cdc_describe_system(up->system),
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_bounce_batch(down, up, dst, src, iterations, NULL));
+  after = clock();
+  printf("bounce   %-5s ->%-3s batch:  %8.1f ns/op\n", down_desc, 
+	 cdc_describe_system(up->system),
+	 elapsed_ns(before, after) / iterations);
+
+  BENCH_CHECK(cdc_stream_converter_new(&conv, down, up));
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_stream_convert(conv, &dst[n], &src[n]));
+    }
+  after = clock();
+  printf("bounce   %-5s ->%-3s stream: %8.1f ns/op\n", down_desc, 
+	 cdc_describe_system(up->system),
+	 elapsed_ns(before, after) / iterations);
+  BENCH_CHECK(cdc_stream_converter_dispose(&conv));
+
+  BENCH_CHECK(cdc_plan_compile(&plan, down, up));
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_plan_apply(plan, &dst[n], &src[n]));
+    }
+  after = clock();
+  printf("bounce   %-5s ->%-3s plan:   %8.1f ns/op\n", down_desc, 
+	 cdc_describe_system(up->system),
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_plan_apply_batch(plan, dst, src, iterations, NULL));
+  after = clock();
+  printf("bounce   %-5s ->%-3s plan b: %8.1f ns/op\n", down_desc, 
+	 cdc_describe_system(up->system),
+	 elapsed_ns(before, after) / iterations);
+  BENCH_CHECK(cdc_plan_dispose(&plan));
+
+  free(dst);
+  free(src);
+}
+
+/** Time cdc_diff() and cdc_zone_add() against one fixed time in 
+ *  'zone', one at a time and as a batch.
+ */
+static void bench_arith_batch(cdc_zone_t *zone,
+			      const cdc_calendar_t *start,
+			      int iterations)
+{
+  char desc[32];
+  cdc_calendar_t *times, *out;
+  cdc_interval_t *diffs, step;
+  clock_t before, after;
+  int n;
+
+  snprintf(desc, sizeof(desc), "%s", cdc_describe_system(zone->system));
+
+  times = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  out = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  diffs = (cdc_interval_t *)malloc(iterations * sizeof(cdc_interval_t));
+  if (!times || !out || !diffs) { fprintf(stderr, "Out of memory\n"); exit(1); }
+
+  step.s = 3607; step.ns = 0;
+  memcpy(&times[0], start, sizeof(cdc_calendar_t));
+  for (n = 1; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_add(zone, &times[n], &times[n-1], &step));
+    }
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_diff(zone, &diffs[n], start, &times[n]));
+    }
+  after = clock();
+  printf("diff     %-5s single:     %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_diff_batch(zone, diffs, start, times, iterations, 
+			     CDC_BATCH_FIXED_A, NULL));
+  after = clock();
+  printf("diff     %-5s batch:      %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_add(zone, &out[n], &times[n], &step));
+    }
+  after = clock();
+  printf("zone_add %-5s single:     %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_zone_add_batch(zone, out, times, &step, iterations, 
+				 CDC_BATCH_FIXED_B, NULL));
+  after = clock();
+  printf("zone_add %-5s batch:      %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  free(diffs);
+  free(out);
+  free(times);
+}
+
+/** Time converting columns of TAI times to instants and back, with 
+ *  each set of vector instructions we have.
+ */
+static void bench_columns(int iterations)
+{
+  static const char *level_desc[] = { "scalar", "sse4.1", "avx2" };
+  int *year, *month, *mday, *hour, *minute, *second;
+  long int *ns, *out_ns;
+  int64_t *s;
+  int max_level, level;
+  int n;
+
+  year = (int *)malloc(6 * iterations * sizeof(int));
+  ns = (long int *)malloc(2 * iterations * sizeof(long int));
+  s = (int64_t *)malloc(iterations * sizeof(int64_t));
+  if (!year || !ns || !s) { fprintf(stderr, "Out of memory\n"); exit(1); }
+  month = year + iterations; mday = month + iterations; 
+  hour = mday + iterations; minute = hour + iterations; 
+  second = minute + iterations; out_ns = ns + iterations;
+
+  for (n = 0; n < iterations; ++n)
+    {
+      year[n] = 1970 + (n % 100); month[n] = n % 12; mday[n] = 1 + (n % 28);
+      hour[n] = n % 24; minute[n] = n % 60; second[n] = (n * 7) % 60;
+      ns[n] = n;
+    }
+
+  max_level = cdc_kernel_level(-1);
+  for (level = CDC_KERNEL_SCALAR; level <= max_level; ++level)
+    {
+      clock_t before, after;
+
+      cdc_kernel_level(level);
+
+      before = clock();
+      BENCH_CHECK(cdc_tai_columns_to_instants(s, out_ns, year, month, mday, 
+					      hour, minute, second, ns, 
+					      iterations));
+      after = clock();
+      printf("columns  to instants %-7s: %8.1f ns/op\n", level_desc[level],
+	     elapsed_ns(before, after) / iterations);
+
+      before = clock();
+      BENCH_CHECK(cdc_tai_columns_from_instants(year, month, mday, hour, 
+						minute, second, ns, s, out_ns, 
+						iterations));
+      after = clock();
+      printf("columns  from instants %-5s: %8.1f ns/op\n", level_desc[level],
+	     elapsed_ns(before, after) / iterations);
+    }
+
+  free(s);
+  free(ns);
+  free(year);
+}
+
+/** Time instant conversions for an array of calendar times against
+ *  the same times held as columns.
+ */
+static void bench_calendar_columns(cdc_zone_t *zone,
+				   const cdc_calendar_t *start,
+				   int iterations)
+{
+  char desc[32];
+  cdc_calendar_t *times;
+  cdc_calendar_columns_t *cols;
+  cdc_instant_t *when;
+  cdc_interval_t step;
+  clock_t before, after;
+  int n;
+
+  snprintf(desc, sizeof(desc), "%s", cdc_describe_system(zone->system));
+
+  times = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  when = (cdc_instant_t *)malloc(iterations * sizeof(cdc_instant_t));
+  if (!times || !when) { fprintf(stderr, "Out of memory\n"); exit(1); }
+  BENCH_CHECK(cdc_calendar_columns_new(&cols, iterations));
+
+  step.s = 3607; step.ns = 0;
+  memcpy(&times[0], start, sizeof(cdc_calendar_t));
+  for (n = 1; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_add(zone, &times[n], &times[n-1], &step));
+    }
+  BENCH_CHECK(cdc_calendar_columns_from_array(cols, times, iterations));
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_to_instant(zone, &when[n], &times[n]));
+    }
+  after = clock();
+  printf("to_instant   %-5s single: %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_zone_columns_to_instants(zone, when, cols, NULL));
+  after = clock();
+  printf("to_instant   %-5s columns:%8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_from_instant(zone, &times[n], &when[n]));
+    }
+  after = clock();
+  printf("from_instant %-5s single: %8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  BENCH_CHECK(cdc_zone_columns_from_instants(zone, cols, when, iterations, 
+					     NULL));
+  after = clock();
+  printf("from_instant %-5s columns:%8.1f ns/op\n", desc,
+	 elapsed_ns(before, after) / iterations);
+
+  BENCH_CHECK(cdc_calendar_columns_dispose(&cols));
+  free(when);
+  free(times);
+}
+
+/** Time parsing what cdc_calendar_sprintf() writes */
+static void bench_parse(const cdc_calendar_t *start, int iterations)
+{
+  enum { NR_STRINGS = 1024, STRING_LEN = 64 };
+  static char strings[NR_STRINGS][STRING_LEN];
+  cdc_calendar_t cal;
+  clock_t before, after;
+  int n;
+
+  for (n = 0; n < NR_STRINGS; ++n)
+    {
+      memcpy(&cal, start, sizeof(cdc_calendar_t));
+      cal.year += n % 50; cal.mday = 1 + (n % 28); cal.second = n % 60;
+      cal.ns = n * 977;
+      cdc_calendar_sprintf(strings[n], STRING_LEN, &cal);
+    }
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_calendar_parse(&cal, strings[n % NR_STRINGS], 
+				     STRING_LEN));
+    }
+  after = clock();
+  printf("parse    %-5s:            %8.1f ns/op\n", 
+	 cdc_describe_system(start->system),
+	 elapsed_ns(before, after) / iterations);
+}
+
+/** Time cdc_calendar_sprintf() against the snprintf() it replaced */
+static void bench_format(const cdc_calendar_t *start, int iterations)
+{
+  enum { NR_TIMES = 1024, STRING_LEN = 64 };
+  static cdc_calendar_t times[NR_TIMES];
+  char buf[STRING_LEN];
+  clock_t before, after;
+  size_t total = 0;
+  int n;
+
+  for (n = 0; n < NR_TIMES; ++n)
+    {
+      memcpy(&times[n], start, sizeof(cdc_calendar_t));
+      times[n].year += n % 50; times[n].mday = 1 + (n % 28); 
+      times[n].second = n % 60; times[n].ns = n * 977;
+    }
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      const cdc_calendar_t *date = &times[n % NR_TIMES];
+
+      total += snprintf(buf, STRING_LEN, 
+			"%04d-%02d-%02d %02d:%02d:%02d.%09ld %s",
+			date->year, date->month+1, date->mday, date->hour,
+			date->minute, date->second, date->ns,
+			cdc_describe_system(date->system));
+    }
+  after = clock();
+  printf("format   %-5s snprintf:   %8.1f ns/op\n", 
+	 cdc_describe_system(start->system),
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      total += cdc_calendar_sprintf(buf, STRING_LEN, &times[n % NR_TIMES]);
+    }
+  after = clock();
+  printf("format   %-5s sprintf:    %8.1f ns/op\n", 
+	 cdc_describe_system(start->system),
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      total += cdc_calendar_format(buf, STRING_LEN, &times[n % NR_TIMES],
+				   0);
+    }
+  after = clock();
+  printf("format   %-5s format:     %8.1f ns/op\n", 
+	 cdc_describe_system(start->system),
+	 elapsed_ns(before, after) / iterations);
+
+  // Keep the compiler from deciding none of it matters.
+  if (!total) { printf("(nothing formatted)\n"); }
+}
+
+/** Time parsing a file's worth of times, one to a line, with each 
+ *  set of vector instructions we have.
+ */
+static void bench_parse_bulk(const cdc_calendar_t *start, int iterations)
+{
+  static const char *level_desc[] = { "scalar", "sse4.1", "avx2" };
+  cdc_calendar_t *out;
+  cdc_calendar_t cal;
+  char *text;
+  int max_level, level;
+  int n, len = 0;
+
+  text = (char *)malloc((size_t)iterations * 64);
+  out = (cdc_calendar_t *)malloc(iterations * sizeof(cdc_calendar_t));
+  if (!text || !out) { fprintf(stderr, "Out of memory\n"); exit(1); }
+
+  for (n = 0; n < iterations; ++n)
+    {
+      memcpy(&cal, start, sizeof(cdc_calendar_t));
+      cal.year += n % 50; cal.mday = 1 + (n % 28); cal.second = n % 60;
+      cal.ns = n * 977;
+      len += cdc_calendar_sprintf(&text[len], 63, &cal);
+      text[len++] = '\n';
+    }
+
+  max_level = cdc_kernel_level(-1);
+  for (level = CDC_KERNEL_SCALAR; level <= max_level; ++level)
+    {
+      clock_t before, after;
+      int nr;
+
+      cdc_kernel_level(level);
+
+      before = clock();
+      BENCH_CHECK(cdc_calendar_parse_bulk(out, NULL, iterations, &nr, 
+					  text, len, '\n', NULL));
+      after = clock();
+      printf("parse    bulk %-7s:        %8.1f ns/op\n", level_desc[level],
+	     elapsed_ns(before, after) / iterations);
+    }
+
+  free(out);
+  free(text);
+}
+
+/** Time getting a zone for each conversion, as a service handling one
+ *  request at a time might, from cdc_zone_from_system() and from
+ *  cdc_zone_get_shared().
+ */
+static void bench_zone_per_request(const cdc_calendar_t *tai_start, 
+				   uint32_t system, int iterations)
+{
+  cdc_calendar_t cal;
+  cdc_zone_t *zone;
+  clock_t before, after;
+  int n;
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_from_system(&zone, system));
+      BENCH_CHECK(cdc_zone_raise(zone, &cal, tai_start));
+      BENCH_CHECK(cdc_zone_dispose(&zone));
+    }
+  after = clock();
+  printf("request  %-5s from_system:%8.1f ns/op\n", 
+	 cdc_describe_system(system), elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_zone_get_shared(&zone, system));
+      BENCH_CHECK(cdc_zone_raise(zone, &cal, tai_start));
+      BENCH_CHECK(cdc_zone_dispose(&zone));
+    }
+  after = clock();
+  printf("request  %-5s get_shared: %8.1f ns/op\n", 
+	 cdc_describe_system(system), elapsed_ns(before, after) / iterations);
+}
+
+/** Time turning a zone name into a zone, by way of 
+ *  cdc_undescribe_system() and cdc_zone_from_system(), and from the
+ *  registry.
+ */
+static void bench_zone_by_name(const char *name, int iterations)
+{
+  unsigned int system;
+  cdc_zone_t *zone;
+  clock_t before, after;
+  int n;
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_undescribe_system(&system, name));
+      BENCH_CHECK(cdc_zone_from_system(&zone, system));
+      BENCH_CHECK(cdc_zone_dispose(&zone));
+    }
+  after = clock();
+  printf("by name  %-8s undescribe:%8.1f ns/op\n", name,
+	 elapsed_ns(before, after) / iterations);
+
+  before = clock();
+  for (n = 0; n < iterations; ++n)
+    {
+      BENCH_CHECK(cdc_registry_lookup_name(&zone, name));
+    }
+  after = clock();
+  printf("by name  %-8s registry:  %8.1f ns/op\n", name,
+	 elapsed_ns(before, after) / iterations);
+}
+
+/** Time making a rebased zone and dropping it again - as for a clock
+ *  sync - with the zone from malloc() and from an arena reset every so
+ *  often; first on its own, then converting one time into each zone.
+ */
+static void bench_rebased_churn(const cdc_calendar_t *tai_start, 
+				int iterations)
+{
+  enum { ZONES_PER_RESET = 1024 };
+  static const char *desc[] = { "", "+ convert" };
+  cdc_calendar_t offset, cal;
+  cdc_zone_t *ukct, *tai, *zone;
+  cdc_arena_t *arena;
+  clock_t before, after;
+  int convert, n;
+
+  BENCH_CHECK(cdc_zone_get_shared(&ukct, CDC_SYSTEM_UKCT));
+  BENCH_CHECK(cdc_zone_get_shared(&tai, CDC_SYSTEM_GREGORIAN_TAI));
+  BENCH_CHECK(cdc_arena_new(&arena, 0));
+  memset(&offset, '\0', sizeof(cdc_calendar_t));
+  offset.system = CDC_SYSTEM_OFFSET;
+
+  for (convert = 0; convert < 2; ++convert)
+    {
+      before = clock();
+      for (n = 0; n < iterations; ++n)
+	{
+	  offset.ns = n;
+	  BENCH_CHECK(cdc_rebased_new(&zone, &offset, ukct));
+	  if (convert) { BENCH_CHECK(cdc_bounce(tai, zone, &cal, tai_start)); }
+	  BENCH_CHECK(cdc_zone_dispose(&zone));
+	}
+      after = clock();
+      printf("rebased  malloc %-9s:  %8.1f ns/op\n", desc[convert],
+	     elapsed_ns(before, after) / iterations);
+
+      before = clock();
+      for (n = 0; n < iterations; ++n)
+	{
+	  if (!(n % ZONES_PER_RESET)) { BENCH_CHECK(cdc_arena_reset(arena)); }
+	  offset.ns = n;
+	  BENCH_CHECK(cdc_arena_rebased_new(arena, &zone, &offset, ukct));
+	  if (convert) { BENCH_CHECK(cdc_bounce(tai, zone, &cal, tai_start)); }
+	}
+      after = clock();
+      printf("rebased  arena  %-9s:  %8.1f ns/op\n", desc[convert],
+	     elapsed_ns(before, after) / iterations);
+    }
+
+  BENCH_CHECK(cdc_arena_dispose(&arena));
+}
+
+int main(int argn, char *args[])
+{
+  cdc_zone_t *gtai, *utc, *ukct;
+  int iterations = DEFAULT_ITERATIONS;
+  static const cdc_calendar_t tai_start =
+    { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_GREGORIAN_TAI };
+  static const cdc_calendar_t utc_start =
+    { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_UTC };
+  static const cdc_calendar_t ukct_start =
+    { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_UKCT };
+
+  if (argn > 1)
+    {
+      iterations = atoi(args[1]);
+      if (iterations < 1) { iterations = 1; }
+    }
+
+  BENCH_CHECK(cdc_tai_new(&gtai));
+  BENCH_CHECK(cdc_utc_new(&utc));
+  BENCH_CHECK(cdc_ukct_new(&ukct));
+
+  bench_zone_add(gtai, &tai_start, iterations);
+  bench_zone_add(utc, &utc_start, iterations);
+  bench_zone_add(ukct, &ukct_start, iterations);
+
+  bench_op(utc, &utc_start, iterations);
+  bench_op(ukct, &ukct_start, iterations);
+
+  bench_bounce(ukct, gtai, &ukct_start, iterations);
+  bench_bounce(gtai, ukct, &tai_start, iterations);
+
+  bench_arith_batch(utc, &utc_start, iterations);
+  bench_arith_batch(ukct, &ukct_start, iterations);
+
+  bench_format(&ukct_start, iterations);
+  bench_parse(&ukct_start, iterations);
+  bench_parse_bulk(&ukct_start, iterations);
+
+  bench_zone_per_request(&tai_start, CDC_SYSTEM_UTC, iterations);
+  bench_zone_per_request(&tai_start, CDC_SYSTEM_UKCT, iterations);
+
+  bench_rebased_churn(&tai_start, iterations);
+
+  bench_zone_by_name("UTC", iterations);
+  bench_zone_by_name("UK", iterations);
+  bench_zone_by_name("UTC+0530", iterations);
+
+  bench_columns(iterations);
+  bench_calendar_columns(gtai, &tai_start, iterations);
+  bench_calendar_columns(utc, &utc_start, iterations);
+  bench_calendar_columns(ukct, &ukct_start, iterations);
+
+  BENCH_CHECK(cdc_zone_dispose(&ukct));
+  BENCH_CHECK(cdc_zone_dispose(&utc));
+  BENCH_CHECK(cdc_zone_dispose(&gtai));
+
+  return 0;
+}
+
+/* End file */
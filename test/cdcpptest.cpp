@@ -62,6 +62,17 @@ int main(int argn, char *args[])
         cdc::CalendarTimeT backInUKCT
             (cdc::Raise(aZone.get(), utc));
         std::cout << " Back in UKCT = " << backInUKCT << std::endl;
+
+        // The shared zone doesn't belong to us, but works the same.
+        std::auto_ptr<cdc::ZoneHandleT> sharedZone
+            (cdc::ZoneHandleT::Shared(cdc::System::kUKCT));
+        std::cout << "Shared UKCT = " 
+                  << cdc::Raise(sharedZone.get(), utc) << std::endl;
+
+        std::auto_ptr<cdc::ZoneHandleT> namedZone
+            (cdc::ZoneHandleT::Named("UK"));
+        std::cout << "Named UK = " 
+                  << cdc::Raise(namedZone.get(), utc) << std::endl;
         
         
         
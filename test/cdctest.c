@@ -28,6 +28,7 @@
  */
 
 #include <stdint.h>
+#include <limits.h>
 #include "cdc/cdc.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -87,11 +88,51 @@ static int cdc_test_utcplus(void);
 WARN_UNUSED
 static int cdc_test_bst(void);
 WARN_UNUSED
+static int cdc_test_bst_years(void);
+WARN_UNUSED
+static int cdc_test_batch(void);
+WARN_UNUSED
+static int cdc_test_batch_arith(void);
+WARN_UNUSED
+static int cdc_test_stream(void);
+WARN_UNUSED
+static int cdc_test_span(void);
+WARN_UNUSED
+static int cdc_test_columns(void);
+WARN_UNUSED
+static int cdc_test_calendar_columns(void);
+WARN_UNUSED
+static int cdc_test_calendar_scan(void);
+WARN_UNUSED
+static int cdc_test_parse_bulk(void);
+WARN_UNUSED
+static int cdc_test_calendar_format(void);
+WARN_UNUSED
+static int cdc_test_shared_zones(void);
+WARN_UNUSED
+static int cdc_test_registry(void);
+WARN_UNUSED
+static int cdc_test_plans(void);
+WARN_UNUSED
+static int cdc_test_arena(void);
+WARN_UNUSED
 static int cdc_test_rebased(void);
 WARN_UNUSED
 static int cdc_test_bounce(void);
 WARN_UNUSED
 static int cdc_test_parse(void);
+WARN_UNUSED
+static int cdc_test_civil(void);
+WARN_UNUSED
+static int cdc_test_gtai_normalise(void);
+WARN_UNUSED
+static int cdc_test_instant(void);
+WARN_UNUSED
+static int cdc_test_utc_offsets(void);
+WARN_UNUSED
+static int cdc_test_utc_span(void);
+WARN_UNUSED
+static int cdc_test_leap_table(void);
 
 /* Test interval - date arithmetic bugs found whilst developing RAW */
 WARN_UNUSED
@@ -122,18 +163,77 @@ int cdc_test_function(int argn, char *args[])
   printf("-- test_calendar() \n");
   DO_TEST(cdc_test_calendar());
 
+  printf(" -- test_civil()\n");
+  DO_TEST(cdc_test_civil());
+
   printf(" -- test_gtai()\n");
   DO_TEST(cdc_test_gtai());
+
+  printf(" -- test_gtai_normalise()\n");
+  DO_TEST(cdc_test_gtai_normalise());
   
   printf(" -- test_utc() \n");
   DO_TEST(cdc_test_utc());
 
+  printf(" -- test_utc_offsets() \n");
+  DO_TEST(cdc_test_utc_offsets());
+
+  printf(" -- test_utc_span() \n");
+  DO_TEST(cdc_test_utc_span());
+  printf(" -- test_leap_table() \n");
+  DO_TEST(cdc_test_leap_table());
+
+  printf(" -- test_instant() \n");
+  DO_TEST(cdc_test_instant());
+
   printf(" -- test_utcplus() \n");
   DO_TEST(cdc_test_utcplus());
 
   printf(" -- test_bst() \n");
   DO_TEST(cdc_test_bst());
 
+  printf(" -- test_bst_years() \n");
+  DO_TEST(cdc_test_bst_years());
+
+  printf(" -- test_batch() \n");
+  DO_TEST(cdc_test_batch());
+
+  printf(" -- test_batch_arith() \n");
+  DO_TEST(cdc_test_batch_arith());
+
+  printf(" -- test_stream() \n");
+  DO_TEST(cdc_test_stream());
+
+  printf(" -- test_span() \n");
+  DO_TEST(cdc_test_span());
+
+  printf(" -- test_columns() \n");
+  DO_TEST(cdc_test_columns());
+
+  printf(" -- test_calendar_columns() \n");
+  DO_TEST(cdc_test_calendar_columns());
+
+  printf(" -- test_calendar_scan() \n");
+  DO_TEST(cdc_test_calendar_scan());
+
+  printf(" -- test_parse_bulk() \n");
+  DO_TEST(cdc_test_parse_bulk());
+
+  printf(" -- test_calendar_format() \n");
+  DO_TEST(cdc_test_calendar_format());
+
+  printf(" -- test_shared_zones() \n");
+  DO_TEST(cdc_test_shared_zones());
+
+  printf(" -- test_registry() \n");
+  DO_TEST(cdc_test_registry());
+
+  printf(" -- test_plans() \n");
+  DO_TEST(cdc_test_plans());
+
+  printf(" -- test_arena() \n");
+  DO_TEST(cdc_test_arena());
+
   printf(" -- test_rebased() \n");
   DO_TEST(cdc_test_rebased());
 
@@ -158,6 +258,12 @@ static int cdc_test_reflexivity(unsigned int sys, const char *correct_descriptio
 
     sprintf(buf2, "%s: description of system %d is incorrect", __func__, sys);
     ASSERT_STRINGS_EQUAL(buf, correct_description, buf2);
+
+    rv = cdc_describe_system_r(buf, CDC_DESCRIBE_SYSTEM_MAX, sys);
+    sprintf(buf2, "%s: reentrant description of system %d is incorrect", 
+	    __func__, sys);
+    ASSERT_STRINGS_EQUAL(buf, correct_description, buf2);
+    ASSERT_INTEGERS_EQUAL((int)strlen(correct_description), rv, buf2);
     
     rv = cdc_undescribe_system(&test_sys, buf);
     sprintf(buf2, "%s: cannot undescribe %s", __func__, correct_description);
@@ -241,6 +347,17 @@ static int cdc_test_parse(void)
     DO_TEST(cdc_test_reflexivity((CDC_SYSTEM_UTCPLUS_ZERO + (60 + 23)) |
                          CDC_SYSTEM_TAINTED,
                          "UTC+0123*"));
+    DO_TEST(cdc_test_reflexivity(CDC_SYSTEM_OFFSET, "OFF"));
+    DO_TEST(cdc_test_reflexivity(CDC_SYSTEM_REBASED, "REBASED*"));
+
+    {
+        char buf[8];
+
+        rv = cdc_describe_system_r(buf, sizeof(buf), 
+                                   CDC_SYSTEM_UTCPLUS_ZERO - (120 + 4));
+        ASSERT_INTEGERS_EQUAL(8, rv, "Truncated description length is wrong");
+        ASSERT_STRINGS_EQUAL(buf, "UTC-020", "Truncated description is wrong");
+    }
 
     // Now check interval parsing.
     {
@@ -357,6 +474,133 @@ static int cdc_test_interval(void)
   return 0;
 }
 
+static int cdc_test_civil(void)
+{
+  int64_t days;
+  int rv;
+
+  // Day 0 is the TAI epoch.
+  rv = cdc_days_from_civil(&days, 1958, CDC_JANUARY, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [0]");
+  ASSERT_INTEGERS_EQUAL(0, (int)days, "1 Jan 1958 is not day 0");
+
+  rv = cdc_days_from_civil(&days, 1970, CDC_JANUARY, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [1]");
+  ASSERT_INTEGERS_EQUAL(4383, (int)days, "Wrong day number for the UNIX epoch");
+
+  rv = cdc_days_from_civil(&days, 1600, CDC_MARCH, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [2]");
+  ASSERT_INTEGERS_EQUAL(-130697, (int)days, "Wrong day number for 1 Mar 1600");
+
+  // Out of range months and days fold linearly.
+  rv = cdc_days_from_civil(&days, 1970, 12, 0);
+  ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [3]");
+  ASSERT_INTEGERS_EQUAL(4383 + 364, (int)days, "1970-13-00 is not 31 Dec 1970");
+
+  rv = cdc_days_from_civil(&days, 1970, -1, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [4]");
+  ASSERT_INTEGERS_EQUAL(4383 - 31, (int)days, "1970-00-01 is not 1 Dec 1969");
+
+  // Round trip every day from 1599 to 2401, checking that the dates
+  // advance one day at a time.
+  {
+    int64_t d, first, last;
+    int year = 1599, month = CDC_JANUARY, mday = 1;
+    static const int mdays[] = 
+      { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    rv = cdc_days_from_civil(&first, 1599, CDC_JANUARY, 1);
+    ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [5]");
+    rv = cdc_days_from_civil(&last, 2401, CDC_DECEMBER, 31);
+    ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [6]");
+
+    for (d = first; d <= last; ++d)
+      {
+	int y, m, md;
+	int64_t back;
+	int is_leap = (!(year % 4) && (year % 100)) || !(year % 400);
+
+	rv = cdc_civil_from_days(&y, &m, &md, d);
+	ASSERT_INTEGERS_EQUAL(0, rv, "civil_from_days() failed");
+	ASSERT_INTEGERS_EQUAL(year, y, "civil_from_days() year wrong");
+	ASSERT_INTEGERS_EQUAL(month, m, "civil_from_days() month wrong");
+	ASSERT_INTEGERS_EQUAL(mday, md, "civil_from_days() mday wrong");
+
+	rv = cdc_days_from_civil(&back, y, m, md);
+	ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [7]");
+	ASSERT_INTEGERS_EQUAL(1, (back == d), "days_from_civil() doesn't round trip");
+
+	++mday;
+	if (mday > mdays[month] + ((month == CDC_FEBRUARY && is_leap) ? 1 : 0))
+	  {
+	    mday = 1;
+	    if (++month > CDC_DECEMBER) { month = CDC_JANUARY; ++year; }
+	  }
+      }
+  }
+
+  // Day numbers whose years don't fit in an int are rejected, however
+  // far out they are.
+  {
+    int64_t d;
+    int y, m, md;
+
+    rv = cdc_days_from_civil(&d, INT_MAX, CDC_DECEMBER, 31);
+    ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [8]");
+    rv = cdc_civil_from_days(&y, &m, &md, d);
+    ASSERT_INTEGERS_EQUAL(0, rv, "civil_from_days() failed at INT_MAX");
+    ASSERT_INTEGERS_EQUAL(INT_MAX, y, "civil_from_days() INT_MAX year wrong");
+    rv = cdc_civil_from_days(&y, &m, &md, d + 1);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "civil_from_days() past INT_MAX didn't fail");
+
+    rv = cdc_days_from_civil(&d, INT_MIN, CDC_JANUARY, 1);
+    ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [9]");
+    rv = cdc_civil_from_days(&y, &m, &md, d);
+    ASSERT_INTEGERS_EQUAL(0, rv, "civil_from_days() failed at INT_MIN");
+    ASSERT_INTEGERS_EQUAL(INT_MIN, y, "civil_from_days() INT_MIN year wrong");
+    rv = cdc_civil_from_days(&y, &m, &md, d - 1);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "civil_from_days() before INT_MIN didn't fail");
+
+    rv = cdc_civil_from_days(&y, &m, &md, INT64_MAX);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "civil_from_days(INT64_MAX) didn't fail");
+    rv = cdc_civil_from_days(&y, &m, &md, INT64_MIN);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "civil_from_days(INT64_MIN) didn't fail");
+  }
+
+  // Diffs are now closed-form, so let's do a few centuries.
+  {
+    cdc_zone_t *gtai;
+    static cdc_calendar_t b = 
+      { 1600, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    static cdc_calendar_t a = 
+      { 2400, CDC_JANUARY, 1, 0, 0, 1, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    cdc_interval_t iv;
+    char buf[128];
+
+    rv = cdc_tai_new(&gtai);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+
+    rv = cdc_diff(gtai, &iv, &b, &a);
+    ASSERT_INTEGERS_EQUAL(0, rv, "diff() failed [8]");
+    cdc_interval_sprintf(buf, 128, &iv);
+    // 292194 days, and a second.
+    ASSERT_STRINGS_EQUAL(buf, "25245561601 s 0 ns", "800 year diff() failed [8]");
+
+    rv = cdc_diff(gtai, &iv, &a, &b);
+    ASSERT_INTEGERS_EQUAL(0, rv, "diff() failed [9]");
+    cdc_interval_sprintf(buf, 128, &iv);
+    ASSERT_STRINGS_EQUAL(buf, "-25245561601 s 0 ns", "800 year diff() failed [9]");
+
+    rv = cdc_zone_dispose(&gtai);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+  }
+
+  return 0;
+}
 
 static int cdc_test_gtai(void)
 {
@@ -544,6 +788,125 @@ static int cdc_test_gtai(void)
   return 0;
 }
 
+static int cdc_test_gtai_normalise(void)
+{
+  typedef struct 
+  {
+    cdc_calendar_t src;
+    cdc_calendar_t offset;
+    int op;
+    const char *result;
+  } norm_test_t;
+  static const norm_test_t tests[] = 
+    {
+      // 2^30 s from the epoch - this used to walk ~400 months.
+      { { 1958, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 0, 0, 0, 0, 1073741824, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"1992-01-10 13:37:04.000000000 TAI" },
+      { { 1958, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 0, 0, 0, 0, 2147483647, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"2026-01-19 03:14:07.000000000 TAI" },
+      { { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 0, 0, 0, 0, 2000000000, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SUBTRACT,
+	"1947-01-29 09:01:36.000000000 TAI" },
+      // Every field out of range, in both directions at once.
+      { { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 0, 1000000, -20000000, 3000000, -1, -1999999999, 
+	  CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"2472-06-22 12:34:53.000000001 TAI" },
+      { { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 0, -700000, 0, 0, 2000000000, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"0157-04-18 16:08:16.000000000 TAI" },
+      // Months still carry before days ..
+      { { 2000, CDC_JANUARY, 31, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 1, 0, 0, 0, 0, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"2000-03-02 00:00:00.000000000 TAI" },
+      { { 2000, CDC_JANUARY, 31, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	{ 0, 1000, 0, 0, 0, 0, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SUBTRACT,
+	"1916-10-01 00:00:00.000000000 TAI" },
+    };
+  cdc_zone_t *gtai;
+  cdc_calendar_t tgt;
+  char buf[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_tai_new(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+      rv = cdc_op(gtai, &tgt, &tests[i].src, &tests[i].offset, tests[i].op);
+      sprintf(msg, "Normalising op failed [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      
+      cdc_calendar_sprintf(buf, 128, &tgt);
+      sprintf(msg, "Normalised result is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, tests[i].result, msg);
+    }
+
+  // Adding 2^30 s and taking it away again should get you back where
+  // you started.
+  {
+    static cdc_calendar_t b = 
+      { 2010, CDC_JUNE, 15, 12, 34, 56, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    cdc_calendar_t c;
+    cdc_interval_t iv;
+
+    iv.s = 1 << 30; iv.ns = 0;
+    rv = cdc_zone_add(gtai, &tgt, &b, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot add 2^30 s");
+
+    iv.s = -iv.s;
+    rv = cdc_zone_add(gtai, &c, &tgt, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot subtract 2^30 s");
+
+    rv = cdc_calendar_cmp(&b, &c);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Adding 2^30 s doesn't round trip");
+  }
+
+  // cdc_zone_add() takes the whole int64 range in one go ..
+  {
+    static cdc_calendar_t b = 
+      { 1958, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    cdc_interval_t iv;
+
+    // 100000 Gregorian cycles and a bit.
+    iv.s = (int64_t)146097 * 100000 * 86400 + 86400 + 1; iv.ns = 0;
+    rv = cdc_zone_add(gtai, &tgt, &b, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot add 40 million years");
+    cdc_calendar_sprintf(buf, 128, &tgt);
+    ASSERT_STRINGS_EQUAL(buf, "40001958-01-02 00:00:01.000000000 TAI", 
+			 "Adding 40 million years failed");
+
+    iv.s = -iv.s;
+    rv = cdc_zone_add(gtai, &tgt, &b, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot subtract 40 million years");
+    cdc_calendar_sprintf(buf, 128, &tgt);
+    ASSERT_STRINGS_EQUAL(buf, "-39998043-12-30 23:59:59.000000000 TAI", 
+			 "Subtracting 40 million years failed");
+
+    // .. but not if the year won't fit.
+    iv.s = INT64_MAX;
+    rv = cdc_zone_add(gtai, &tgt, &b, &iv);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "Adding INT64_MAX s didn't overflow");
+  }
+
+  rv = cdc_zone_dispose(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+
+  return 0;
+}
+
 
 
 static int cdc_test_utc(void)
@@ -846,6 +1209,412 @@ static int cdc_test_utc(void)
   return 0;
 }
 
+static int cdc_test_utc_offsets(void)
+{
+  typedef struct 
+  {
+    cdc_calendar_t src;
+    const char *result;
+  } offset_test_t;
+  static const offset_test_t tests[] = 
+    {
+      // From TAI, the new offset applies a whole second after the 
+      // leap second starts.
+      { { 1979, CDC_JANUARY, 1, 0, 0, 17, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-17.000000000 OFF" },
+      { { 1979, CDC_JANUARY, 1, 0, 0, 17, 999999999, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-17.000000000 OFF" },
+      { { 1979, CDC_JANUARY, 1, 0, 0, 18, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-18.000000000 OFF" },
+      { { 2013, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-35.000000000 OFF" },
+      { { 1961, CDC_JANUARY, 1, 0, 0, 1, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:00.000000000 OFF" },
+      { { 1961, CDC_JANUARY, 1, 0, 0, 2, 500000000, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-1.-422818000 OFF" },
+      // From UTC, the leap second itself belongs to the old offset.
+      { { 1978, CDC_DECEMBER, 31, 23, 59, 59, 500000000, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:-17.000000000 OFF" },
+      { { 1978, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:-17.000000000 OFF" },
+      { { 1979, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:-18.000000000 OFF" },
+      // .. but sync points take effect as soon as they're passed.
+      { { 1961, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:00.000000000 OFF" },
+      { { 1961, CDC_JANUARY, 1, 0, 0, 0, 500000000, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:-1.-422818000 OFF" },
+      { { 1950, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:00.000000000 OFF" },
+      { { 2017, CDC_JANUARY, 1, 0, 0, 37, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"0000-01-00 00:00:-37.000000000 OFF" },
+      { { 2100, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"0000-01-00 00:00:-37.000000000 OFF" },
+    };
+  cdc_zone_t *utc;
+  cdc_calendar_t tgt;
+  char buf[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_utc_new(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+      rv = utc->offset(utc, &tgt, &tests[i].src);
+      sprintf(msg, "Cannot find UTC - TAI offset [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      
+      cdc_calendar_sprintf(buf, 128, &tgt);
+      sprintf(msg, "UTC - TAI offset is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, tests[i].result, msg);
+    }
+
+  rv = cdc_zone_dispose(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose utc");
+
+  return 0;
+}
+
+static int cdc_test_utc_span(void)
+{
+  typedef struct 
+  {
+    cdc_calendar_t src;
+    cdc_calendar_t offset;
+    int op;
+    const char *result;
+  } span_test_t;
+  static const span_test_t tests[] = 
+    {
+      // No leap second anywhere near.
+      { { 2010, CDC_JUNE, 15, 12, 0, 0, 0, CDC_SYSTEM_UTC },
+	{ 0, 0, 0, 0, 0, 3600, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"2010-06-15 13:00:00.000000000 UTC" },
+      // Into and out of a leap second.
+      { { 1978, CDC_DECEMBER, 31, 23, 59, 59, 0, CDC_SYSTEM_UTC },
+	{ 0, 0, 0, 0, 0, 1, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"1978-12-31 23:59:60.000000000 UTC" },
+      { { 1978, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UTC },
+	{ 0, 0, 0, 0, 0, 1, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"1979-01-01 00:00:00.000000000 UTC" },
+      // Two hours of seconds across a leap second is a second short ..
+      { { 1978, CDC_DECEMBER, 31, 23, 0, 0, 0, CDC_SYSTEM_UTC },
+	{ 0, 0, 0, 0, 0, 7200, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_SIMPLE_ADD,
+	"1979-01-01 00:59:59.000000000 UTC" },
+      // .. but two hours is two hours.
+      { { 1978, CDC_DECEMBER, 31, 23, 0, 0, 0, CDC_SYSTEM_UTC },
+	{ 0, 0, 0, 2, 0, 0, 0, CDC_SYSTEM_INVALID },
+	CDC_OP_COMPLEX_ADD,
+	"1979-01-01 01:00:00.000000000 UTC" },
+    };
+  cdc_zone_t *utc;
+  cdc_calendar_t tgt;
+  char buf[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_utc_new(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+
+  for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+    {
+      rv = cdc_op(utc, &tgt, &tests[i].src, &tests[i].offset, tests[i].op);
+      sprintf(msg, "UTC op failed [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      
+      cdc_calendar_sprintf(buf, 128, &tgt);
+      sprintf(msg, "UTC op result is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, tests[i].result, msg);
+    }
+
+  rv = cdc_zone_dispose(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose utc");
+
+  return 0;
+}
+
+static int cdc_test_leap_table(void)
+{
+  static const char *path = "cdctest-leap-seconds.list";
+  // The start of leap-seconds.list, plus a leap second that hasn't 
+  // (yet) happened so we can tell the file is in use.
+  static const char *good = 
+    "#\tleap-seconds.list, abridged\n"
+    "#$\t 3676924800\n"
+    "#@\t 4291747200\n"
+    "\n"
+    "2272060800\t10\t# 1 Jan 1972\n"
+    "2287785600\t11\t# 1 Jul 1972\n"
+    "2303683200\t12\t# 1 Jan 1973\n"
+    "4102444800\t13\t# 1 Jan 2030\n"
+    "#h\t0 0 0 0 0\n";
+  static const char *negative = 
+    "2272060800\t10\t# 1 Jan 1972\n"
+    "2287785600\t11\t# 1 Jul 1972\n"
+    "2303683200\t10\t# 1 Jan 1973\n";
+  static const char *announced = 
+    "4118083200\t14\t# 1 Jul 2030\n";
+  static const char *not_midnight = 
+    "2272060801\t10\n";
+  static cdc_calendar_t y2100 = 
+    { 2100, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC };
+  static cdc_calendar_t before_leap = 
+    { 2029, CDC_DECEMBER, 31, 23, 59, 59, 0, CDC_SYSTEM_UTC };
+  static cdc_calendar_t one_second = 
+    { 0, 0, 0, 0, 0, 1, 0, CDC_SYSTEM_INVALID };
+  cdc_zone_t *utc;
+  cdc_calendar_t tgt;
+  char buf[128];
+  FILE *fp;
+  int rv;
+
+  rv = cdc_utc_new(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+
+  rv = cdc_utc_load_leap_table("cdctest-no-such-file.list");
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_FILE, rv, 
+			"Loaded a leap second file that doesn't exist");
+
+  fp = fopen(path, "w"); fputs(negative, fp); fclose(fp);
+  rv = cdc_utc_load_leap_table(path);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_BAD_FORMAT, rv, 
+			"Loaded a negative leap second");
+
+  fp = fopen(path, "w"); fputs(not_midnight, fp); fclose(fp);
+  rv = cdc_utc_load_leap_table(path);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_BAD_FORMAT, rv, 
+			"Loaded a leap second not at midnight");
+
+  fp = fopen(path, "w"); fputs(good, fp); fclose(fp);
+  rv = cdc_utc_load_leap_table(path);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot load leap second file");
+
+  rv = utc->offset(utc, &tgt, &y2100);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot find loaded UTC offset");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "0000-01-00 00:00:-13.000000000 OFF", 
+		       "Loaded UTC offset is wrong");
+
+  rv = cdc_op(utc, &tgt, &before_leap, &one_second, CDC_OP_SIMPLE_ADD);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot add into loaded leap second");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "2029-12-31 23:59:60.000000000 UTC", 
+		       "Loaded leap second doesn't exist");
+  
+  // Reloading picks up a newly announced leap second.
+  fp = fopen(path, "w"); fputs(good, fp); fputs(announced, fp); fclose(fp);
+  rv = cdc_utc_reload_leap_table();
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot reload leap second file");
+
+  rv = utc->offset(utc, &tgt, &y2100);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot find reloaded UTC offset");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "0000-01-00 00:00:-14.000000000 OFF", 
+		       "Reloaded UTC offset is wrong");
+
+  // .. but a broken file leaves the old table in place.
+  fp = fopen(path, "w"); fputs(not_midnight, fp); fclose(fp);
+  rv = cdc_utc_reload_leap_table();
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_BAD_FORMAT, rv, "Reloaded a broken file");
+
+  rv = utc->offset(utc, &tgt, &y2100);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot find kept UTC offset");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "0000-01-00 00:00:-14.000000000 OFF", 
+		       "Broken reload changed UTC offset");
+
+  // Back to the built-in table.
+  rv = cdc_utc_load_leap_table(NULL);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot restore built-in leap seconds");
+
+  rv = utc->offset(utc, &tgt, &y2100);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot find built-in UTC offset");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "0000-01-00 00:00:-37.000000000 OFF", 
+		       "Built-in UTC offset is wrong");
+
+  rv = cdc_op(utc, &tgt, &before_leap, &one_second, CDC_OP_SIMPLE_ADD);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot add past unloaded leap second");
+  cdc_calendar_sprintf(buf, 128, &tgt);
+  ASSERT_STRINGS_EQUAL(buf, "2030-01-01 00:00:00.000000000 UTC", 
+		       "Unloaded leap second still exists");
+
+  // Which is never reloaded.
+  rv = cdc_utc_reload_leap_table();
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot reload built-in leap seconds");
+
+  remove(path);
+
+  rv = cdc_zone_dispose(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose utc");
+
+  return 0;
+}
+
+static int cdc_test_instant(void)
+{
+  cdc_zone_t *gtai, *utc, *ukct;
+  cdc_instant_t i, j;
+  cdc_calendar_t c;
+  cdc_interval_t iv;
+  char buf[128];
+  int rv;
+
+  rv = cdc_tai_new(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+  rv = cdc_utc_new(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+  rv = cdc_ukct_new(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+
+  // The epoch is instant 0, and instants before it have positive ns.
+  {
+    static cdc_calendar_t epoch = 
+      { 1958, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    static cdc_calendar_t before = 
+      { 1957, CDC_DECEMBER, 31, 23, 59, 59, 500000000, 
+	CDC_SYSTEM_GREGORIAN_TAI };
+
+    rv = cdc_zone_to_instant(gtai, &i, &epoch);
+    ASSERT_INTEGERS_EQUAL(0, rv, "to_instant() failed [0]");
+    ASSERT_INTEGERS_EQUAL(1, (i.s == 0 && i.ns == 0), "Epoch is not instant 0");
+
+    rv = cdc_zone_to_instant(gtai, &i, &before);
+    ASSERT_INTEGERS_EQUAL(0, rv, "to_instant() failed [1]");
+    ASSERT_INTEGERS_EQUAL(1, (i.s == -1 && i.ns == 500000000), 
+			  "Wrong instant before the epoch");
+
+    rv = cdc_zone_from_instant(gtai, &c, &i);
+    ASSERT_INTEGERS_EQUAL(0, rv, "from_instant() failed [1]");
+    rv = cdc_calendar_cmp(&c, &before);
+    ASSERT_INTEGERS_EQUAL(0, rv, "TAI instant doesn't round trip");
+
+    // Negative differences are negated positive ones, as for cdc_diff()
+    j.s = 0; j.ns = 0;
+    rv = cdc_instant_diff(&iv, &j, &i);
+    ASSERT_INTEGERS_EQUAL(0, rv, "instant_diff() failed");
+    cdc_interval_sprintf(buf, 128, &iv);
+    ASSERT_STRINGS_EQUAL(buf, "0 s -500000000 ns", "Negative instant_diff() wrong");
+
+    // .. and adding them back gets you where you started.
+    rv = cdc_instant_add(&j, &j, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "instant_add() failed");
+    ASSERT_INTEGERS_EQUAL(0, cdc_instant_cmp(&i, &j), "instant_add() wrong");
+
+    i.s = 1; i.ns = 0;
+    iv.s = INT64_MAX; iv.ns = 0;
+    rv = cdc_instant_add(&j, &i, &iv);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			  "instant_add() didn't overflow");
+  }
+
+  // UTC instants are TAI instants.
+  {
+    static cdc_calendar_t midnight = 
+      { 1972, CDC_JANUARY, 1, 0, 0, 1, 0, CDC_SYSTEM_UTC };
+    static cdc_calendar_t leap = 
+      { 1978, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UTC };
+
+    // 5113 days, a second and the 10s UTC was behind TAI at the time.
+    rv = cdc_zone_to_instant(utc, &i, &midnight);
+    ASSERT_INTEGERS_EQUAL(0, rv, "to_instant() failed [2]");
+    ASSERT_INTEGERS_EQUAL(1, (i.s == (int64_t)5113 * 86400 + 11 && i.ns == 0),
+			  "Wrong instant for 1972-01-01 UTC");
+
+    rv = cdc_zone_to_instant(utc, &i, &leap);
+    ASSERT_INTEGERS_EQUAL(0, rv, "to_instant() failed [3]");
+    rv = cdc_zone_from_instant(utc, &c, &i);
+    ASSERT_INTEGERS_EQUAL(0, rv, "from_instant() failed [3]");
+    cdc_calendar_sprintf(buf, 128, &c);
+    ASSERT_STRINGS_EQUAL(buf, "1978-12-31 23:59:60.000000000 UTC",
+			 "Leap second doesn't round trip through an instant");
+
+    // Two seconds later we're into the new year.
+    iv.s = 2; iv.ns = 0;
+    rv = cdc_instant_add(&i, &i, &iv);
+    ASSERT_INTEGERS_EQUAL(0, rv, "instant_add() failed [4]");
+    rv = cdc_zone_from_instant(utc, &c, &i);
+    ASSERT_INTEGERS_EQUAL(0, rv, "from_instant() failed [4]");
+    cdc_calendar_sprintf(buf, 128, &c);
+    ASSERT_STRINGS_EQUAL(buf, "1979-01-01 00:00:01.000000000 UTC",
+			 "Two seconds after a leap second is wrong");
+
+    // And cdc_diff() sees the leap second.
+    rv = cdc_diff(utc, &iv, &leap, &midnight);
+    ASSERT_INTEGERS_EQUAL(0, rv, "diff() failed [5]");
+    cdc_interval_sprintf(buf, 128, &iv);
+    ASSERT_STRINGS_EQUAL(buf, "-220924806 s 0 ns", 
+			 "UTC diff() across leap seconds is wrong");
+  }
+
+  // UKCT goes via UTC.
+  {
+    static cdc_calendar_t summer = 
+      { 2010, CDC_JULY, 1, 12, 0, 0, 0, CDC_SYSTEM_UKCT };
+    cdc_instant_t k;
+
+    rv = cdc_zone_to_instant(ukct, &i, &summer);
+    ASSERT_INTEGERS_EQUAL(0, rv, "to_instant() failed [6]");
+
+    // 11:00 UTC, 34s behind TAI
+    rv = cdc_days_from_civil(&k.s, 2010, CDC_JULY, 1);
+    ASSERT_INTEGERS_EQUAL(0, rv, "days_from_civil() failed [6]");
+    k.s = (k.s * 86400) + (11 * 3600) + 34; k.ns = 0;
+    ASSERT_INTEGERS_EQUAL(0, cdc_instant_cmp(&i, &k), "Wrong UKCT instant");
+
+    rv = cdc_zone_from_instant(ukct, &c, &i);
+    ASSERT_INTEGERS_EQUAL(0, rv, "from_instant() failed [6]");
+    rv = cdc_calendar_cmp(&c, &summer);
+    ASSERT_INTEGERS_EQUAL(0, rv, "UKCT instant doesn't round trip");
+  }
+
+  // Months run 0-11, and a bad one on either side of a TAI diff is
+  // rejected, singly or in a batch.
+  {
+    static const cdc_calendar_t good =
+      { 2010, CDC_DECEMBER, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI };
+    cdc_calendar_t bad;
+    int err;
+
+    memcpy(&bad, &good, sizeof(cdc_calendar_t));
+    bad.month = CDC_DECEMBER + 1;
+
+    rv = cdc_diff(gtai, &iv, &good, &good);
+    ASSERT_INTEGERS_EQUAL(0, rv, "diff() failed [7]");
+    rv = cdc_diff(gtai, &iv, &bad, &good);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv,
+			  "diff() took a bad month before");
+    rv = cdc_diff(gtai, &iv, &good, &bad);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv,
+			  "diff() took a bad month after");
+    rv = cdc_diff_batch(gtai, &iv, &good, &bad, 1, 0, &err);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, err,
+			  "diff_batch() took a bad month after");
+
+    bad.month = -1;
+    rv = cdc_diff(gtai, &iv, &good, &bad);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv,
+			  "diff() took a negative month");
+  }
+
+  rv = cdc_zone_dispose(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose ukct");
+  rv = cdc_zone_dispose(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose utc");
+  rv = cdc_zone_dispose(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+
+  return 0;
+}
+
 
 static int cdc_test_utcplus(void)
 {
@@ -1188,6 +1957,1361 @@ static int cdc_test_bst(void)
   return 0;
 }
 
+static int cdc_test_bst_years(void)
+{
+  typedef struct 
+  {
+    cdc_calendar_t when;
+    int is_dst;
+  } bst_year_test_t;
+  // Years 64 apart share a slot in the transition cache.
+  static const bst_year_test_t tests[] = 
+    {
+      // 1900: last Sundays are March 25, October 28.
+      { { 1900, CDC_MARCH, 24, 23, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 1900, CDC_MARCH, 25, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 1900, CDC_MARCH, 25, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 1900, CDC_MARCH, 25, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 1900, CDC_MARCH, 25, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 1900, CDC_OCTOBER, 28, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 1900, CDC_OCTOBER, 28, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 1900, CDC_OCTOBER, 28, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 1900, CDC_OCTOBER, 28, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 1900, CDC_OCTOBER, 29, 12, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      // 2010: last Sundays are March 28, October 31.
+      { { 2010, CDC_MARCH, 27, 23, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2010, CDC_MARCH, 28, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2010, CDC_MARCH, 28, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2010, CDC_MARCH, 28, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2010, CDC_MARCH, 28, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2010, CDC_OCTOBER, 31, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2010, CDC_OCTOBER, 31, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2010, CDC_OCTOBER, 31, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2010, CDC_OCTOBER, 31, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2010, CDC_OCTOBER, 30, 12, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      // 2074: last Sundays are March 25, October 28.
+      { { 2074, CDC_MARCH, 24, 23, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2074, CDC_MARCH, 25, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2074, CDC_MARCH, 25, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2074, CDC_MARCH, 25, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2074, CDC_MARCH, 25, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2074, CDC_OCTOBER, 28, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2074, CDC_OCTOBER, 28, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2074, CDC_OCTOBER, 28, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2074, CDC_OCTOBER, 28, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2074, CDC_OCTOBER, 29, 12, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      // 2138: last Sundays are March 30, October 26.
+      { { 2138, CDC_MARCH, 29, 23, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2138, CDC_MARCH, 30, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2138, CDC_MARCH, 30, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2138, CDC_MARCH, 30, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2138, CDC_MARCH, 30, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2138, CDC_OCTOBER, 26, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2138, CDC_OCTOBER, 26, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2138, CDC_OCTOBER, 26, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2138, CDC_OCTOBER, 26, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2138, CDC_OCTOBER, 27, 12, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      // 2400: last Sundays are March 26, October 29.
+      { { 2400, CDC_MARCH, 25, 23, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2400, CDC_MARCH, 26, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2400, CDC_MARCH, 26, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2400, CDC_MARCH, 26, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2400, CDC_MARCH, 26, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2400, CDC_OCTOBER, 29, 0, 0, 0, 0, CDC_SYSTEM_UTC }, 1 },
+      { { 2400, CDC_OCTOBER, 29, 1, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+      { { 2400, CDC_OCTOBER, 29, 1, 0, 0, 0, CDC_SYSTEM_UKCT }, 1 },
+      { { 2400, CDC_OCTOBER, 29, 2, 0, 0, 0, CDC_SYSTEM_UKCT }, 0 },
+      { { 2400, CDC_OCTOBER, 30, 12, 0, 0, 0, CDC_SYSTEM_UTC }, 0 },
+    };
+  cdc_zone_t *bst;
+  cdc_calendar_aux_t aux;
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_ukct_new(&bst);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create bst.");
+
+  // Twice, so that we see both cache misses and hits.
+  for (i = 0; i < 2 * (sizeof(tests) / sizeof(tests[0])); ++i)
+    {
+      const bst_year_test_t *t = &tests[i % (sizeof(tests) / sizeof(tests[0]))];
+
+      rv = bst->aux(bst, &t->when, &aux);
+      sprintf(msg, "Cannot get UKCT aux [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      sprintf(msg, "UKCT is_dst is wrong [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(t->is_dst, aux.is_dst, msg);
+    }
+
+  rv = cdc_zone_dispose(&bst);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose bst");
+
+  return 0;
+}
+
+static int cdc_test_batch(void)
+{
+  static const cdc_calendar_t src[] = 
+    {
+      { 2010, CDC_MARCH, 28, 0, 59, 59, 0, CDC_SYSTEM_UKCT },
+      { 2010, CDC_MARCH, 28, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      // Not from the UKCT chain; the rest of the batch should carry on.
+      { 2010, CDC_MARCH, 28, 2, 0, 0, 0, CDC_SYSTEM_UTCPLUS_BASE + 60 },
+      { 2008, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UKCT },
+      { 2010, CDC_JULY, 1, 12, 0, 0, 0, CDC_SYSTEM_UKCT },
+    };
+#define NR_BATCH (sizeof(src) / sizeof(src[0]))
+  cdc_zone_t *ukct, *gtai;
+  cdc_zone_t *lower[NR_BATCH];
+  cdc_calendar_t tai[NR_BATCH], back[NR_BATCH], one;
+  int errs[NR_BATCH];
+  char buf[128], buf2[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_ukct_new(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+  rv = cdc_tai_new(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+
+  rv = cdc_zone_lower_to_batch(ukct, tai, lower, src, NR_BATCH, 
+			       CDC_SYSTEM_GREGORIAN_TAI, errs);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_CANNOT_CONVERT, rv, "Batch lower didn't fail");
+  
+  for (i = 0; i < NR_BATCH; ++i)
+    {
+      cdc_zone_t *l;
+      int one_rv = cdc_zone_lower_to(ukct, &one, &l, &src[i], 
+				     CDC_SYSTEM_GREGORIAN_TAI);
+
+      sprintf(msg, "Batch lower error differs [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(one_rv, errs[i], msg);
+      if (one_rv) { continue; }
+      
+      cdc_calendar_sprintf(buf, 128, &one);
+      cdc_calendar_sprintf(buf2, 128, &tai[i]);
+      sprintf(msg, "Batch lower result differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+      sprintf(msg, "Batch lower zone differs [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(1, (lower[i] == l), msg);
+    }
+
+  // Round trip; raise in place.
+  memcpy(&tai[2], &src[2], sizeof(cdc_calendar_t));
+  rv = cdc_zone_raise_batch(ukct, tai, tai, NR_BATCH, errs);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, "Batch raise didn't fail");
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, errs[2], 
+			"Batch raise error is wrong");
+
+  rv = cdc_bounce_batch(ukct, ukct, back, src, NR_BATCH, NULL);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, "Batch bounce didn't fail");
+
+  for (i = 0; i < NR_BATCH; ++i)
+    {
+      if (src[i].system != CDC_SYSTEM_UKCT) { continue; }
+
+      cdc_calendar_sprintf(buf, 128, &src[i]);
+      cdc_calendar_sprintf(buf2, 128, &tai[i]);
+      sprintf(msg, "Batch raise didn't round trip [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+
+      cdc_calendar_sprintf(buf2, 128, &back[i]);
+      sprintf(msg, "Batch bounce didn't round trip [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+#undef NR_BATCH
+
+  rv = cdc_zone_dispose(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+  rv = cdc_zone_dispose(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose ukct");
+
+  return 0;
+}
+
+static int cdc_test_batch_arith(void)
+{
+  static const cdc_calendar_t times[] = 
+    {
+      { 2008, CDC_DECEMBER, 31, 23, 59, 58, 0, CDC_SYSTEM_UTC },
+      { 2008, CDC_DECEMBER, 31, 23, 59, 60, 500, CDC_SYSTEM_UTC },
+      { 2009, CDC_JANUARY, 1, 0, 0, 1, 0, CDC_SYSTEM_UTC },
+      { 2009, CDC_JANUARY, 1, 12, 0, 0, 0, CDC_SYSTEM_UTC },
+      { 1972, CDC_JUNE, 30, 23, 59, 59, 0, CDC_SYSTEM_UTC },
+      { 2016, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UTC },
+    };
+#define NR_BATCH (sizeof(times) / sizeof(times[0]))
+  static const cdc_interval_t steps[NR_BATCH] = 
+    {
+      { 1, 0 }, { 2, 0 }, { -3, 999999500 }, { 86400, 0 }, 
+      { -86400*366, 0 }, { 1, 0 }
+    };
+  cdc_zone_t *utc;
+  cdc_interval_t diffs[NR_BATCH], one_diff;
+  cdc_calendar_t sums[NR_BATCH], one_sum;
+  int errs[NR_BATCH];
+  char buf[128], buf2[128];
+  char msg[128];
+  int rv, flags;
+  size_t i;
+
+  rv = cdc_utc_new(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+
+  for (flags = 0; flags < 4; ++flags)
+    {
+      rv = cdc_diff_batch(utc, diffs, times, &times[1], NR_BATCH - 1, 
+			  flags, errs);
+      sprintf(msg, "Batch diff failed [%d]", flags);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+
+      for (i = 0; i < NR_BATCH - 1; ++i)
+	{
+	  rv = cdc_diff(utc, &one_diff,
+			(flags & CDC_BATCH_FIXED_A) ? &times[0] : &times[i],
+			(flags & CDC_BATCH_FIXED_B) ? &times[1] : &times[i + 1]);
+	  ASSERT_INTEGERS_EQUAL(0, rv, "Diff failed");
+	  
+	  sprintf(msg, "Batch diff differs [%d, %d]", flags, (int)i);
+	  ASSERT_INTEGERS_EQUAL((int)one_diff.s, (int)diffs[i].s, msg);
+	  ASSERT_INTEGERS_EQUAL(one_diff.ns, diffs[i].ns, msg);
+	}
+
+      rv = cdc_zone_add_batch(utc, sums, times, steps, NR_BATCH, 
+			      flags, errs);
+      sprintf(msg, "Batch add failed [%d]", flags);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+
+      for (i = 0; i < NR_BATCH; ++i)
+	{
+	  rv = cdc_zone_add(utc, &one_sum,
+			    (flags & CDC_BATCH_FIXED_A) ? &times[0] : &times[i],
+			    (flags & CDC_BATCH_FIXED_B) ? &steps[0] : &steps[i]);
+	  ASSERT_INTEGERS_EQUAL(0, rv, "Add failed");
+
+	  cdc_calendar_sprintf(buf, 128, &one_sum);
+	  cdc_calendar_sprintf(buf2, 128, &sums[i]);
+	  sprintf(msg, "Batch add differs [%d, %d]", flags, (int)i);
+	  ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+	}
+    }
+
+  // A spot check that we really went through the leap second.
+  rv = cdc_diff_batch(utc, diffs, times, &times[2], 1, 0, NULL);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Batch diff failed");
+  ASSERT_INTEGERS_EQUAL(4, (int)diffs[0].s, "Batch diff missed the leap second");
+
+  // Errors are per element.
+  memcpy(sums, times, sizeof(times));
+  sums[1].system = CDC_SYSTEM_UKCT;
+  rv = cdc_diff_batch(utc, diffs, sums, &times[0], 3, CDC_BATCH_FIXED_B, errs);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, "Bad batch diff didn't fail");
+  ASSERT_INTEGERS_EQUAL(0, errs[0], "Batch diff failed too early");
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, errs[1], "Batch diff error is wrong");
+  ASSERT_INTEGERS_EQUAL(0, errs[2], "Batch diff didn't carry on");
+  ASSERT_INTEGERS_EQUAL(-4, (int)diffs[2].s, "Batch diff is wrong after an error");
+
+  // Zones with offsets, and TAI, should add as one at a time does.
+  {
+    cdc_zone_t *others[3];
+    cdc_calendar_t dates[NR_BATCH];
+    int j;
+
+    rv = cdc_ukct_new(&others[0]);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+    rv = cdc_utcplus_new(&others[1], 5*60 + 30);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utcplus zone");
+    rv = cdc_tai_new(&others[2]);
+    ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create tai zone");
+
+    for (j = 0; j < 3; ++j)
+      {
+	memcpy(dates, times, sizeof(times));
+	for (i = 0; i < NR_BATCH; ++i) { dates[i].system = others[j]->system; }
+
+	for (flags = 0; flags < 4; ++flags)
+	  {
+	    cdc_zone_add_batch(others[j], sums, dates, steps, NR_BATCH,
+			       flags, errs);
+	    for (i = 0; i < NR_BATCH; ++i)
+	      {
+		rv = cdc_zone_add(others[j], &one_sum,
+				  (flags & CDC_BATCH_FIXED_A) ? &dates[0] : &dates[i],
+				  (flags & CDC_BATCH_FIXED_B) ? &steps[0] : &steps[i]);
+		sprintf(msg, "Batch add error differs [%d, %d, %d]",
+			j, flags, (int)i);
+		ASSERT_INTEGERS_EQUAL(rv, errs[i], msg);
+		if (rv) { continue; }
+
+		cdc_calendar_sprintf(buf, 128, &one_sum);
+		cdc_calendar_sprintf(buf2, 128, &sums[i]);
+		sprintf(msg, "Batch add differs [%d, %d, %d]", j, flags, (int)i);
+		ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+	      }
+	  }
+
+	rv = cdc_zone_dispose(&others[j]);
+	ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose zone");
+      }
+  }
+#undef NR_BATCH
+
+  rv = cdc_zone_dispose(&utc);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose utc");
+
+  return 0;
+}
+
+static int cdc_test_stream(void)
+{
+  static const cdc_calendar_t src[] = 
+    {
+      { 2008, CDC_OCTOBER, 26, 0, 59, 59, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_OCTOBER, 26, 1, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_OCTOBER, 26, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_DECEMBER, 31, 23, 59, 59, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UKCT },
+      { 2009, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2009, CDC_MARCH, 29, 0, 59, 59, 0, CDC_SYSTEM_UKCT },
+      { 2009, CDC_MARCH, 29, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      // Out of order, and from another year.
+      { 1985, CDC_MARCH, 31, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2009, CDC_MARCH, 29, 2, 0, 1, 0, CDC_SYSTEM_UKCT },
+    };
+  // Not something we can convert (cdc_bounce() never returns for it).
+  static const cdc_calendar_t bad = 
+    { 2009, CDC_MARCH, 29, 2, 0, 1, 0, CDC_SYSTEM_UTCPLUS_BASE + 60 };
+#define NR_STREAM (sizeof(src) / sizeof(src[0]))
+  cdc_zone_t *ukct, *gtai;
+  cdc_stream_converter_t *down, *up;
+  cdc_calendar_t tai[NR_STREAM], back[NR_STREAM], one;
+  int errs[NR_STREAM];
+  char buf[128], buf2[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_ukct_new(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+  rv = cdc_tai_new(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+
+  rv = cdc_stream_converter_new(&down, ukct, gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create down converter");
+  rv = cdc_stream_converter_new(&up, gtai, ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create up converter");
+
+  for (i = 0; i < NR_STREAM; ++i)
+    {
+      int one_rv = cdc_bounce(ukct, gtai, &one, &src[i]);
+
+      rv = cdc_stream_convert(down, &tai[i], &src[i]);
+      sprintf(msg, "Stream conversion error differs [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(one_rv, rv, msg);
+      if (one_rv) { continue; }
+
+      cdc_calendar_sprintf(buf, 128, &one);
+      cdc_calendar_sprintf(buf2, 128, &tai[i]);
+      sprintf(msg, "Stream conversion differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+
+  // And back again, all at once.
+  rv = cdc_stream_convert(down, &one, &bad);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, "Bad stream conversion didn't fail");
+
+  rv = cdc_stream_convert_batch(up, back, tai, NR_STREAM, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Stream batch failed");
+  for (i = 0; i < NR_STREAM; ++i)
+    {
+      // Not src[i]: midnight after a leap second comes back as the
+      // leap second.
+      rv = cdc_bounce(gtai, ukct, &one, &tai[i]);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Bounce failed");
+
+      cdc_calendar_sprintf(buf, 128, &one);
+      cdc_calendar_sprintf(buf2, 128, &back[i]);
+      sprintf(msg, "Stream batch conversion differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+#undef NR_STREAM
+
+  rv = cdc_stream_converter_dispose(&up);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose up converter");
+  rv = cdc_stream_converter_dispose(&down);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose down converter");
+  ASSERT_INTEGERS_EQUAL(1, (down == NULL), "Dispose didn't clear converter");
+
+  rv = cdc_zone_dispose(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+  rv = cdc_zone_dispose(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose ukct");
+
+  return 0;
+}
+
+static int cdc_test_span(void)
+{
+  static const struct 
+  {
+    int zone;
+    cdc_calendar_t cal;
+    const char *start;
+    const char *end;
+    int offset_s;
+  } tests[] = 
+    {
+      // 0 = TAI, 1 = UTC, 2 = UK, 3 = UTC+0530
+      { 0, { 2010, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"-2147483648-01-01 00:00:00.000000000 TAI",
+	"2147483647-01-01 00:00:00.000000000 TAI", 0 },
+      { 1, { 2010, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"2008-12-31 23:59:60.000000001 UTC",
+	"2012-06-30 23:59:60.000000001 UTC", -34 },
+      // The leap second itself still has the old offset.
+      { 1, { 2008, CDC_DECEMBER, 31, 23, 59, 60, 0, CDC_SYSTEM_UTC },
+	"2005-12-31 23:59:60.000000001 UTC",
+	"2008-12-31 23:59:60.000000001 UTC", -33 },
+      { 1, { 2009, CDC_JANUARY, 1, 0, 0, 33, 0, CDC_SYSTEM_GREGORIAN_TAI },
+	"2006-01-01 00:00:33.000000000 TAI",
+	"2009-01-01 00:00:34.000000000 TAI", -33 },
+      { 1, { 2020, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"2016-12-31 23:59:60.000000001 UTC",
+	"2147483647-01-01 00:00:00.000000000 UTC", -37 },
+      { 1, { 1950, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"-2147483648-01-01 00:00:00.000000000 UTC",
+	"1961-01-01 00:00:00.000000001 UTC", 0 },
+      { 2, { 2010, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_UKCT },
+	"2010-03-28 02:00:00.000000000 UK",
+	"2010-10-31 02:00:00.000000000 UK", 3600 },
+      { 2, { 2010, CDC_DECEMBER, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"2010-10-31 01:00:00.000000000 UTC",
+	"2011-03-27 01:00:00.000000000 UTC", 0 },
+      { 2, { 2011, CDC_MARCH, 27, 0, 59, 59, 0, CDC_SYSTEM_UTC },
+	"2010-10-31 01:00:00.000000000 UTC",
+	"2011-03-27 01:00:00.000000000 UTC", 0 },
+      { 3, { 2010, CDC_JUNE, 1, 0, 0, 0, 0, CDC_SYSTEM_UTC },
+	"-2147483648-01-01 00:00:00.000000000 UTC",
+	"2147483647-01-01 00:00:00.000000000 UTC", 19800 },
+    };
+  cdc_zone_t *zones[4];
+  cdc_calendar_t start, end, offset;
+  char buf[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_tai_new(&zones[0]);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create tai zone");
+  rv = cdc_utc_new(&zones[1]);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utc zone");
+  rv = cdc_ukct_new(&zones[2]);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+  rv = cdc_utcplus_new(&zones[3], 330);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create utcplus zone");
+
+  for (i = 0; i < sizeof(tests)/sizeof(tests[0]); ++i)
+    {
+      rv = cdc_zone_span(zones[tests[i].zone], &tests[i].cal, 
+			 &start, &end, &offset);
+      sprintf(msg, "Span failed [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+
+      cdc_calendar_sprintf(buf, 128, &start);
+      sprintf(msg, "Span start is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, tests[i].start, msg);
+
+      cdc_calendar_sprintf(buf, 128, &end);
+      sprintf(msg, "Span end is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, tests[i].end, msg);
+
+      sprintf(msg, "Span offset is wrong [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(tests[i].offset_s, 
+			    (offset.hour * 3600) + (offset.minute * 60) + 
+			    offset.second, msg);
+    }
+
+  // UK spans only make sense in UK time or UTC.
+  rv = cdc_zone_span(zones[2], &tests[0].cal, &start, &end, &offset);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, "TAI span in UK didn't fail");
+
+  // A zone with no span() - built before there was one, say - fails.
+  {
+    cdc_zone_t no_span;
+
+    memcpy(&no_span, zones[1], sizeof(cdc_zone_t));
+    no_span.span = NULL;
+    rv = cdc_zone_span(&no_span, &tests[1].cal, &start, &end, &offset);
+    ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, 
+			  "Span with no span() didn't fail");
+  }
+
+  for (i = 0; i < 4; ++i)
+    {
+      rv = cdc_zone_dispose(&zones[i]);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose zone");
+    }
+
+  return 0;
+}
+
+static int cdc_test_columns(void)
+{
+  static const cdc_calendar_t times[] = 
+    {
+      { 2010, CDC_JUNE, 15, 12, 34, 56, 789, CDC_SYSTEM_GREGORIAN_TAI },
+      { 1958, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+      { 1957, CDC_DECEMBER, 31, 23, 59, 59, 999999999, CDC_SYSTEM_GREGORIAN_TAI },
+      { 2000, CDC_FEBRUARY, 29, 23, 59, 60, 0, CDC_SYSTEM_GREGORIAN_TAI },
+      { -4713, CDC_NOVEMBER, 24, 12, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+      { 2100, CDC_MARCH, 1, 0, 0, 0, 1, CDC_SYSTEM_GREGORIAN_TAI },
+      // Out of range fields; these go one at a time.
+      { 2010, 13, 40, 25, 61, 61, 0, CDC_SYSTEM_GREGORIAN_TAI },
+      { 2010, CDC_JANUARY, 1, 0, 0, 0, -1, CDC_SYSTEM_GREGORIAN_TAI },
+      { 1 << 30, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_GREGORIAN_TAI },
+    };
+#define NR_COLUMNS (sizeof(times) / sizeof(times[0]))
+  int year[NR_COLUMNS], month[NR_COLUMNS], mday[NR_COLUMNS];
+  int hour[NR_COLUMNS], minute[NR_COLUMNS], second[NR_COLUMNS];
+  long int ns[NR_COLUMNS], out_ns[NR_COLUMNS];
+  int64_t s[NR_COLUMNS];
+  cdc_zone_t *tai;
+  char buf[128], buf2[128];
+  char msg[128];
+  int rv, level, max_level;
+  size_t i;
+
+  rv = cdc_tai_new(&tai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create tai zone");
+
+  max_level = cdc_kernel_level(-1);
+  for (level = CDC_KERNEL_SCALAR; level <= max_level; ++level)
+    {
+      ASSERT_INTEGERS_EQUAL(level, cdc_kernel_level(level), 
+			    "Cannot set kernel level");
+
+      for (i = 0; i < NR_COLUMNS; ++i)
+	{
+	  year[i] = times[i].year; month[i] = times[i].month;
+	  mday[i] = times[i].mday; hour[i] = times[i].hour;
+	  minute[i] = times[i].minute; second[i] = times[i].second;
+	  ns[i] = times[i].ns;
+	}
+
+      rv = cdc_tai_columns_to_instants(s, out_ns, year, month, mday, hour,
+				       minute, second, ns, NR_COLUMNS);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Columns to instants failed");
+
+      for (i = 0; i < NR_COLUMNS; ++i)
+	{
+	  cdc_instant_t one;
+
+	  rv = cdc_zone_to_instant(tai, &one, &times[i]);
+	  ASSERT_INTEGERS_EQUAL(0, rv, "To instant failed");
+
+	  sprintf(msg, "Column instant differs [%d, %d]", level, (int)i);
+	  ASSERT_INTEGERS_EQUAL(1, (one.s == s[i] && one.ns == out_ns[i]), msg);
+	}
+
+      rv = cdc_tai_columns_from_instants(year, month, mday, hour, minute,
+					 second, ns, s, out_ns, NR_COLUMNS);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Columns from instants failed");
+
+      for (i = 0; i < NR_COLUMNS; ++i)
+	{
+	  cdc_calendar_t one, col;
+	  cdc_instant_t when;
+
+	  when.s = s[i]; when.ns = out_ns[i];
+	  rv = cdc_zone_from_instant(tai, &one, &when);
+	  ASSERT_INTEGERS_EQUAL(0, rv, "From instant failed");
+
+	  memset(&col, '\0', sizeof(cdc_calendar_t));
+	  col.year = year[i]; col.month = month[i]; col.mday = mday[i];
+	  col.hour = hour[i]; col.minute = minute[i]; col.second = second[i];
+	  col.ns = ns[i]; col.system = CDC_SYSTEM_GREGORIAN_TAI;
+
+	  cdc_calendar_sprintf(buf, 128, &one);
+	  cdc_calendar_sprintf(buf2, 128, &col);
+	  sprintf(msg, "Column calendar differs [%d, %d]", level, (int)i);
+	  ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+	}
+    }
+  cdc_kernel_level(max_level);
+#undef NR_COLUMNS
+
+  rv = cdc_zone_dispose(&tai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose tai");
+
+  return 0;
+}
+
+static int cdc_test_calendar_columns(void)
+{
+  static const cdc_calendar_t src[] = 
+    {
+      { 2008, CDC_OCTOBER, 26, 0, 59, 59, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_OCTOBER, 26, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2008, CDC_DECEMBER, 31, 23, 59, 60, 500, CDC_SYSTEM_UKCT },
+      { 2009, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 2009, CDC_MARCH, 29, 2, 0, 0, 0, CDC_SYSTEM_UKCT },
+      { 1985, CDC_MARCH, 31, 2, 0, 0, 999999999, CDC_SYSTEM_UKCT },
+    };
+#define NR_COLUMNS (sizeof(src) / sizeof(src[0]))
+  cdc_zone_t *ukct, *gtai;
+  cdc_calendar_columns_t *cols, *small;
+  cdc_calendar_t arr[NR_COLUMNS], batch[NR_COLUMNS], one;
+  cdc_instant_t when[NR_COLUMNS], one_when;
+  int errs[NR_COLUMNS];
+  char buf[128], buf2[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  rv = cdc_ukct_new(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create ukct zone");
+  rv = cdc_tai_new(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create gtai zone");
+  rv = cdc_calendar_columns_new(&cols, NR_COLUMNS);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create columns");
+  rv = cdc_calendar_columns_new(&small, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot create small columns");
+
+  // What won't go in.
+  rv = cdc_calendar_columns_from_array(small, src, 2);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, "Overfull columns");
+  memcpy(arr, src, sizeof(src));
+  arr[1].system = CDC_SYSTEM_UTC;
+  rv = cdc_calendar_columns_from_array(cols, arr, NR_COLUMNS);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_SYSTEMS_DO_NOT_MATCH, rv, "Mixed systems");
+  arr[1].system = CDC_SYSTEM_UKCT;
+  arr[1].mday = 200;
+  rv = cdc_calendar_columns_from_array(cols, arr, NR_COLUMNS);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, "Day won't fit");
+
+  // Round trip.
+  rv = cdc_calendar_columns_from_array(cols, src, NR_COLUMNS);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot fill columns");
+  ASSERT_INTEGERS_EQUAL(NR_COLUMNS, cols->n, "Wrong column count");
+  rv = cdc_calendar_columns_to_array(arr, cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot empty columns");
+  for (i = 0; i < NR_COLUMNS; ++i)
+    {
+      cdc_calendar_sprintf(buf, 128, &src[i]);
+      cdc_calendar_sprintf(buf2, 128, &arr[i]);
+      sprintf(msg, "Column round trip differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+
+  rv = cdc_bounce_columns(ukct, gtai, small, cols, NULL);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, "Bounce into small columns");
+
+  // Down to TAI in place, as an instant, and back up.
+  rv = cdc_bounce_batch(ukct, gtai, batch, src, NR_COLUMNS, NULL);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Batch bounce failed");
+  rv = cdc_bounce_columns(ukct, gtai, cols, cols, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Column bounce failed");
+  ASSERT_INTEGERS_EQUAL(CDC_SYSTEM_GREGORIAN_TAI, cols->system, 
+			"Column bounce gave the wrong system");
+  rv = cdc_calendar_columns_to_array(arr, cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot empty columns");
+  for (i = 0; i < NR_COLUMNS; ++i)
+    {
+      cdc_calendar_sprintf(buf, 128, &batch[i]);
+      cdc_calendar_sprintf(buf2, 128, &arr[i]);
+      sprintf(msg, "Column bounce differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+
+  rv = cdc_zone_columns_to_instants(ukct, when, cols, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Columns to instants failed");
+  rv = cdc_zone_columns_from_instants(gtai, cols, when, NR_COLUMNS, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Columns from TAI instants failed");
+  rv = cdc_calendar_columns_to_array(arr, cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot empty columns");
+  for (i = 0; i < NR_COLUMNS; ++i)
+    {
+      cdc_calendar_sprintf(buf, 128, &batch[i]);
+      cdc_calendar_sprintf(buf2, 128, &arr[i]);
+      sprintf(msg, "Column from TAI instant differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+  rv = cdc_zone_columns_from_instants(ukct, cols, when, NR_COLUMNS, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Columns from instants failed");
+  ASSERT_INTEGERS_EQUAL(CDC_SYSTEM_UKCT, cols->system, 
+			"Columns from instants gave the wrong system");
+  rv = cdc_calendar_columns_to_array(arr, cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot empty columns");
+  for (i = 0; i < NR_COLUMNS; ++i)
+    {
+      rv = cdc_zone_to_instant(ukct, &one_when, &src[i]);
+      ASSERT_INTEGERS_EQUAL(0, rv, "To instant failed");
+      sprintf(msg, "Column instant differs [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(1, (!cdc_instant_cmp(&one_when, &when[i])), msg);
+
+      rv = cdc_zone_from_instant(ukct, &one, &when[i]);
+      ASSERT_INTEGERS_EQUAL(0, rv, "From instant failed");
+      cdc_calendar_sprintf(buf, 128, &one);
+      cdc_calendar_sprintf(buf2, 128, &arr[i]);
+      sprintf(msg, "Column from instant differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+
+  // UKCT columns straight to instants, and lowered to UTC.
+  rv = cdc_zone_columns_to_instants(ukct, when, cols, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "UKCT columns to instants failed");
+  rv = cdc_zone_lower_to_batch(ukct, batch, NULL, arr, NR_COLUMNS, 
+			       CDC_SYSTEM_UTC, NULL);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Batch lower failed");
+  rv = cdc_zone_lower_to_columns(ukct, cols, cols, CDC_SYSTEM_UTC, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Column lower failed");
+  rv = cdc_calendar_columns_to_array(arr, cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot empty columns");
+  for (i = 0; i < NR_COLUMNS; ++i)
+    {
+      rv = cdc_zone_to_instant(ukct, &one_when, &src[i]);
+      ASSERT_INTEGERS_EQUAL(0, rv, "To instant failed");
+      sprintf(msg, "UKCT column instant differs [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(1, (!cdc_instant_cmp(&one_when, &when[i])), msg);
+
+      cdc_calendar_sprintf(buf, 128, &batch[i]);
+      cdc_calendar_sprintf(buf2, 128, &arr[i]);
+      sprintf(msg, "Column lower differs [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf2, buf, msg);
+    }
+
+  // .. and raised again; bottom of the chain is TAI.
+  rv = cdc_zone_raise_columns(ukct, cols, cols, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Column raise failed");
+  ASSERT_INTEGERS_EQUAL(CDC_SYSTEM_UKCT, cols->system, 
+			"Column raise gave the wrong system");
+  rv = cdc_zone_lower_to_columns(ukct, cols, cols, -1, errs);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Column lower to bottom failed");
+  ASSERT_INTEGERS_EQUAL(CDC_SYSTEM_GREGORIAN_TAI, cols->system, 
+			"Column lower to bottom gave the wrong system");
+#undef NR_COLUMNS
+
+  rv = cdc_calendar_columns_dispose(&small);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose small columns");
+  rv = cdc_calendar_columns_dispose(&cols);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose columns");
+  ASSERT_INTEGERS_EQUAL(1, (cols == NULL), "Dispose didn't clear columns");
+
+  rv = cdc_zone_dispose(&gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose gtai");
+  rv = cdc_zone_dispose(&ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Cannot dispose ukct");
+
+  return 0;
+}
+
+static int cdc_test_calendar_scan(void)
+{
+  static const struct 
+  {
+    const char *in;
+    int n;
+    int rv;
+    const char *out;
+    int consumed;
+  } cases[] = 
+      {
+	{ "1990-01-01 00:00:00.000000000 TAI", 64, 0, 
+	  "1990-01-01 00:00:00.000000000 TAI", 33 },
+	{ "2008-12-31T23:59:60.5Z", 64, 0, 
+	  "2008-12-31 23:59:60.500000000 UTC", 22 },
+	{ "2010-06-15t12:34:56,1234567891+05:30 next", 64, 0, 
+	  "2010-06-15 12:34:56.123456789 UTC+0530", 36 },
+	{ "2010-06-15T12:34:56-01:00", 64, 0, 
+	  "2010-06-15 12:34:56.000000000 UTC-0100", 25 },
+	{ "2010-06-15T12:34:56-00:00", 64, 0, 
+	  "2010-06-15 12:34:56.000000000 UTC", 25 },
+	{ "-4713-11-24 12:00:00.000000000   UK* more", 64, 0, 
+	  "-4713-11-24 12:00:00.000000000 UK*", 36 },
+	{ "2001-03-23 23:59:60.-02428509 OFF", 64, 0, 
+	  "2001-03-23 23:59:60.-02428509 OFF", 33 },
+	{ "2001-03-23 23:59:60 REBASED*", 64, 0, 
+	  "2001-03-23 23:59:60.000000000 REBASED*", 28 },
+	// n cuts these short.
+	{ "2008-12-31T23:59:60.5Z", 21, CDC_ERR_BAD_SYSTEM, NULL, 0 },
+	{ "2008-12-31T23:59:60.5Z", 20, CDC_ERR_CANNOT_CONVERT, NULL, 0 },
+	{ "2010-06-15 12:34:56 UTC+0530", 23, 0, 
+	  "2010-06-15 12:34:56.000000000 UTC", 23 },
+	// Malformed.
+	{ "2010-06-15X12:34:56Z", 64, CDC_ERR_CANNOT_CONVERT, NULL, 0 },
+	{ "2010-06-15 12:34:56+13:00", 64, CDC_ERR_BAD_SYSTEM, NULL, 0 },
+	{ "2010-06-15 12:34:56 TAIX", 64, CDC_ERR_BAD_SYSTEM, NULL, 0 },
+	{ "2010-06-15 12:34:56.Z", 64, CDC_ERR_CANNOT_CONVERT, NULL, 0 },
+      };
+  char buf[128];
+  char msg[128];
+  size_t i;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+      cdc_calendar_t cal;
+      int consumed = -1;
+      int rv;
+
+      rv = cdc_calendar_scan(&cal, cases[i].in, cases[i].n, &consumed);
+      sprintf(msg, "Scan result is wrong [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(cases[i].rv, rv, msg);
+      if (rv) { continue; }
+
+      cdc_calendar_sprintf(buf, 128, &cal);
+      sprintf(msg, "Scanned time is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, cases[i].out, msg);
+      sprintf(msg, "Scan consumed the wrong length [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(cases[i].consumed, consumed, msg);
+    }
+
+  return 0;
+}
+
+static int cdc_test_parse_bulk(void)
+{
+  static const char csv[] = 
+    "2010-06-15 12:34:56.123456789 UK,"
+    "2010-06-15T12:34:56.123456789Z\r,"
+    "2010-06-15 12:34:56 TAI,"
+    "2010-06-15 12:34:56.5+01:00,"
+    "2010-06-15 12:34:56.1234567891 UTC,"
+    "2010-06-15 12:34:56:123456789 UTC,"
+    "2010-06-15 12:34:56.123456789 UK junk,"
+    "-4713-11-24 12:00:00.000000000 UTC-0130*,"
+    "2008-12-31 23:59:60.999999999 UTC";
+  static const char *expected[] = 
+    {
+      "2010-06-15 12:34:56.123456789 UK",
+      "2010-06-15 12:34:56.123456789 UTC",
+      "2010-06-15 12:34:56.000000000 TAI",
+      "2010-06-15 12:34:56.500000000 UTC+0100",
+      "2010-06-15 12:34:56.123456789 UTC",
+      NULL,
+      NULL,
+      "-4713-11-24 12:00:00.000000000 UTC-0130*",
+      "2008-12-31 23:59:60.999999999 UTC",
+    };
+#define NR_BULK (sizeof(expected) / sizeof(expected[0]))
+  cdc_calendar_t out[NR_BULK];
+  int errs[NR_BULK];
+  char buf[128];
+  char msg[128];
+  int rv, level, max_level;
+  int nr, consumed;
+  size_t i;
+
+  max_level = cdc_kernel_level(-1);
+  for (level = CDC_KERNEL_SCALAR; level <= max_level; ++level)
+    {
+      cdc_kernel_level(level);
+
+      rv = cdc_calendar_parse_bulk(out, errs, NR_BULK, &nr, csv, 
+				   sizeof(csv) - 1, ',', &consumed);
+      sprintf(msg, "Bulk parse didn't fail [%d]", level);
+      ASSERT_INTEGERS_EQUAL(CDC_ERR_CANNOT_CONVERT, rv, msg);
+      ASSERT_INTEGERS_EQUAL(NR_BULK, nr, "Wrong number of records");
+      ASSERT_INTEGERS_EQUAL(sizeof(csv) - 1, consumed, 
+			    "Bulk parse didn't consume everything");
+
+      for (i = 0; i < NR_BULK; ++i)
+	{
+	  sprintf(msg, "Bulk parse result is wrong [%d, %d]", level, (int)i);
+	  ASSERT_INTEGERS_EQUAL(expected[i] ? 0 : CDC_ERR_CANNOT_CONVERT, 
+				errs[i], msg);
+	  if (!expected[i]) { continue; }
+
+	  cdc_calendar_sprintf(buf, 128, &out[i]);
+	  sprintf(msg, "Bulk parsed time is wrong [%d, %d]", level, (int)i);
+	  ASSERT_STRINGS_EQUAL(buf, expected[i], msg);
+	}
+
+      // Stop part way through.
+      rv = cdc_calendar_parse_bulk(out, NULL, 2, &nr, csv, sizeof(csv) - 1, 
+				   ',', &consumed);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Partial bulk parse failed");
+      ASSERT_INTEGERS_EQUAL(2, nr, "Partial bulk parse count is wrong");
+      ASSERT_INTEGERS_EQUAL(65, consumed, 
+			    "Partial bulk parse consumed the wrong amount");
+    }
+  cdc_kernel_level(max_level);
+#undef NR_BULK
+
+  return 0;
+}
+
+static int cdc_test_calendar_format(void)
+{
+  static const struct 
+  {
+    cdc_calendar_t cal;
+    const char *iso;
+    const char *rfc3339;
+  } cases[] = 
+      {
+	{ { 2010, CDC_JUNE, 15, 12, 34, 56, 789, CDC_SYSTEM_UTC },
+	  "2010-06-15 12:34:56.000000789 UTC",
+	  "2010-06-15T12:34:56.000000789Z" },
+	{ { 33, CDC_JANUARY, 1, 0, 0, 0, 0, CDC_SYSTEM_UTCPLUS_ZERO + 330 },
+	  "0033-01-01 00:00:00.000000000 UTC+0530",
+	  "0033-01-01T00:00:00.000000000+05:30" },
+	{ { -4713, CDC_NOVEMBER, 24, 12, 0, 0, 0, 
+	    CDC_SYSTEM_UTCPLUS_ZERO - 90 },
+	  "-4713-11-24 12:00:00.000000000 UTC-0130",
+	  "-4713-11-24T12:00:00.000000000-01:30" },
+	// Unnormalised fields come out as printf() would have them.
+	{ { -5, -1, 123, -7, 60, 61, -2428509, CDC_SYSTEM_UKCT },
+	  "-005-00-123 -7:60:61.-02428509 UK", NULL },
+	{ { 12345, CDC_DECEMBER, 31, 23, 59, 60, 1234567890, 
+	    CDC_SYSTEM_REBASED },
+	  "12345-12-31 23:59:60.1234567890 REBASED*", NULL },
+	{ { 2010, CDC_JUNE, 15, 12, 34, 56, 0, 
+	    CDC_SYSTEM_UTC | CDC_SYSTEM_TAINTED },
+	  "2010-06-15 12:34:56.000000000 UTC*", NULL },
+      };
+  char buf[128];
+  char msg[128];
+  int rv;
+  size_t i;
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+    {
+      rv = cdc_calendar_format(buf, 128, &cases[i].cal, 0);
+      sprintf(msg, "ISO format is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, cases[i].iso, msg);
+      sprintf(msg, "ISO format length is wrong [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL((int)strlen(cases[i].iso), rv, msg);
+
+      rv = cdc_calendar_format(buf, 128, &cases[i].cal, CDC_FORMAT_RFC3339);
+      if (!cases[i].rfc3339)
+	{
+	  sprintf(msg, "RFC 3339 format didn't fail [%d]", (int)i);
+	  ASSERT_INTEGERS_EQUAL(CDC_ERR_BAD_SYSTEM, rv, msg);
+	  continue;
+	}
+      sprintf(msg, "RFC 3339 format is wrong [%d]", (int)i);
+      ASSERT_STRINGS_EQUAL(buf, cases[i].rfc3339, msg);
+      sprintf(msg, "RFC 3339 format length is wrong [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL((int)strlen(cases[i].rfc3339), rv, msg);
+    }
+
+  // Truncation is as snprintf().
+  rv = cdc_calendar_format(buf, 11, &cases[0].cal, 0);
+  ASSERT_INTEGERS_EQUAL((int)strlen(cases[0].iso), rv, 
+			"Truncated format length is wrong");
+  ASSERT_STRINGS_EQUAL(buf, "2010-06-15", "Truncated format is wrong");
+  buf[0] = 'x';
+  rv = cdc_calendar_format(buf, 0, &cases[0].cal, 0);
+  ASSERT_INTEGERS_EQUAL((int)strlen(cases[0].iso), rv, 
+			"Empty format length is wrong");
+  ASSERT_INTEGERS_EQUAL('x', buf[0], "Empty format wrote something");
+
+  return 0;
+}
+
+static int cdc_test_shared_zones(void)
+{
+  static const uint32_t systems[] = 
+    {
+      CDC_SYSTEM_GREGORIAN_TAI, CDC_SYSTEM_UTC, CDC_SYSTEM_UKCT,
+      CDC_SYSTEM_UTCPLUS_ZERO, CDC_SYSTEM_UTCPLUS_ZERO + 330,
+      CDC_SYSTEM_UTCPLUS_ZERO - 720, CDC_SYSTEM_UTCPLUS_ZERO + 720
+    };
+  static const uint32_t bad_systems[] = 
+    {
+      CDC_SYSTEM_OFFSET, CDC_SYSTEM_REBASED, 
+      CDC_SYSTEM_UTC | CDC_SYSTEM_TAINTED, CDC_SYSTEM_UTCPLUS_ZERO + 721
+    };
+  // Just after the 2012 leap second, in summer time.
+  const cdc_calendar_t tai = 
+    { 2012, CDC_JULY, 1, 0, 0, 34, 500, CDC_SYSTEM_GREGORIAN_TAI };
+  cdc_calendar_t from_shared, from_new;
+  cdc_zone_t *shared, *again, *fresh, *lower;
+  char msg[128];
+  int rv;
+  size_t i;
+
+  for (i = 0; i < sizeof(systems) / sizeof(systems[0]); ++i)
+    {
+      rv = cdc_zone_get_shared(&shared, systems[i]);
+      sprintf(msg, "Can't get shared zone [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      sprintf(msg, "Shared zone has the wrong system [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL((int)systems[i], (int)shared->system, msg);
+      sprintf(msg, "Shared zone isn't marked shared [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(CDC_ZONE_FLAG_SHARED, 
+			    (int)(shared->flags & CDC_ZONE_FLAG_SHARED), msg);
+
+      rv = cdc_zone_get_shared(&again, systems[i]);
+      sprintf(msg, "Shared zone changed between calls [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(1, (rv == 0 && again == shared), msg);
+
+      // Disposing of it does nothing but forget the pointer.
+      rv = cdc_zone_dispose(&again);
+      sprintf(msg, "Disposing of a shared zone failed [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(1, (rv == 0 && again == NULL), msg);
+
+      rv = cdc_zone_from_system(&fresh, systems[i]);
+      sprintf(msg, "Can't make zone [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      sprintf(msg, "Fresh zone is marked shared [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, (int)(fresh->flags & CDC_ZONE_FLAG_SHARED), 
+			    msg);
+
+      rv = cdc_zone_raise(shared, &from_shared, &tai);
+      sprintf(msg, "Can't raise into shared zone [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      rv = cdc_zone_raise(fresh, &from_new, &tai);
+      sprintf(msg, "Can't raise into fresh zone [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      sprintf(msg, "Shared and fresh zones disagree [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, cdc_calendar_cmp(&from_shared, &from_new), msg);
+      ASSERT_INTEGERS_EQUAL((int)from_new.system, (int)from_shared.system,
+			    msg);
+
+      rv = cdc_zone_dispose(&fresh);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of fresh zone");
+    }
+
+  // The zones beneath are the shared ones too.
+  rv = cdc_zone_get_shared(&shared, CDC_SYSTEM_UTCPLUS_ZERO + 60);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get shared UTC+0100");
+  lower = NULL;
+  rv = shared->lower_zone(shared, &lower);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't find the zone under UTC+0100");
+  rv = cdc_zone_get_shared(&again, CDC_SYSTEM_UTC);
+  ASSERT_INTEGERS_EQUAL(1, (lower == again), 
+			"UTC+0100 doesn't sit on the shared UTC zone");
+
+  for (i = 0; i < sizeof(bad_systems) / sizeof(bad_systems[0]); ++i)
+    {
+      shared = (cdc_zone_t *)1;
+      rv = cdc_zone_get_shared(&shared, bad_systems[i]);
+      sprintf(msg, "Got a shared zone for a bad system [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(CDC_ERR_BAD_SYSTEM, rv, msg);
+      ASSERT_INTEGERS_EQUAL(1, (shared == NULL), msg);
+    }
+
+  return 0;
+}
+
+static int cdc_test_registry(void)
+{
+  static const struct 
+  {
+    const char *name;
+    uint32_t system;
+  } builtins[] = 
+      {
+	{ "TAI", CDC_SYSTEM_GREGORIAN_TAI },
+	{ "UTC", CDC_SYSTEM_UTC },
+	{ "UK", CDC_SYSTEM_UKCT },
+	{ "UTC+0530", CDC_SYSTEM_UTCPLUS_ZERO + 330 },
+	{ "UTC-1200", CDC_SYSTEM_UTCPLUS_ZERO - 720 },
+	// Other spellings work, though they aren't kept.
+	{ "UTC+05:30", CDC_SYSTEM_UTCPLUS_ZERO + 330 },
+	{ "UTC-0000", CDC_SYSTEM_UTCPLUS_ZERO },
+      };
+  static const char *missing[] = 
+    {
+      "", "Nowhere", "UTC*", "REBASED", "OFF", "UTC+1201", "utc",
+      "A name which is far too long to have been registered"
+    };
+  const cdc_calendar_t offset = 
+    { 0, 0, 0, 1, 0, 0, 0, CDC_SYSTEM_OFFSET };
+  cdc_zone_t *zone, *shared, *gtai, *ship;
+  char msg[128];
+  int rv, pass;
+  size_t i;
+
+  // Twice: once to find the names and once to find what that added.
+  for (pass = 0; pass < 2; ++pass)
+    {
+      for (i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i)
+	{
+	  rv = cdc_registry_lookup_name(&zone, builtins[i].name);
+	  sprintf(msg, "Can't look up %s [%d]", builtins[i].name, pass);
+	  ASSERT_INTEGERS_EQUAL(0, rv, msg);
+	  rv = cdc_zone_get_shared(&shared, builtins[i].system);
+	  sprintf(msg, "%s isn't the shared zone [%d]", builtins[i].name, 
+		  pass);
+	  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && zone == shared), msg);
+
+	  rv = cdc_registry_lookup_system(&zone, builtins[i].system);
+	  sprintf(msg, "Can't look up the system for %s [%d]", 
+		  builtins[i].name, pass);
+	  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && zone == shared), msg);
+	}
+    }
+
+  for (i = 0; i < sizeof(missing) / sizeof(missing[0]); ++i)
+    {
+      zone = (cdc_zone_t *)1;
+      rv = cdc_registry_lookup_name(&zone, missing[i]);
+      sprintf(msg, "Found a zone for '%.20s'", missing[i]);
+      ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_SYSTEM, rv, msg);
+      ASSERT_INTEGERS_EQUAL(1, (zone == NULL), msg);
+    }
+  rv = cdc_registry_lookup_name(&zone, NULL);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_SYSTEM, rv, "Found a zone for NULL");
+  rv = cdc_registry_lookup_system(&zone, CDC_SYSTEM_REBASED);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_SYSTEM, rv, 
+			"Found a rebased zone before registering one");
+
+  // An alias for a shared zone.
+  rv = cdc_zone_get_shared(&shared, CDC_SYSTEM_UKCT);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get shared UKCT");
+  rv = cdc_registry_register("Europe/London", shared);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't register Europe/London");
+  rv = cdc_registry_lookup_name(&zone, "Europe/London");
+  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && zone == shared),
+			"Europe/London isn't the shared UKCT zone");
+
+  // A zone of our own. The registry keeps it for good, so it's never
+  // disposed of.
+  rv = cdc_zone_get_shared(&gtai, CDC_SYSTEM_GREGORIAN_TAI);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get shared TAI");
+  rv = cdc_rebased_new(&ship, &offset, gtai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't make rebased zone");
+  rv = cdc_registry_register("Ship time", ship);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't register Ship time");
+  rv = cdc_registry_lookup_name(&zone, "Ship time");
+  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && zone == ship), 
+			"Ship time isn't the zone registered");
+  rv = cdc_registry_lookup_system(&zone, ship->system);
+  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && zone == ship), 
+			"Ship time can't be found by system");
+  rv = cdc_registry_lookup_name(&zone, "Ship tim");
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_SYSTEM, rv, 
+			"Found a zone for a prefix of a name");
+
+  // Names which can't be had.
+  rv = cdc_registry_register("Ship time", shared);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			"Registered a name twice");
+  rv = cdc_registry_register("UTC+0100", ship);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			"Registered a built-in name");
+  rv = cdc_registry_register("", ship);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			"Registered an empty name");
+  rv = cdc_registry_register(missing[7], ship);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			"Registered a name which is too long");
+
+  return 0;
+}
+
+static int cdc_test_plans(void)
+{
+  static const struct 
+  {
+    uint32_t down, up;
+  } pairs[] = 
+      {
+	{ CDC_SYSTEM_UKCT, CDC_SYSTEM_GREGORIAN_TAI },
+	{ CDC_SYSTEM_GREGORIAN_TAI, CDC_SYSTEM_UKCT },
+	{ CDC_SYSTEM_UTCPLUS_ZERO + 330, CDC_SYSTEM_UKCT },
+	{ CDC_SYSTEM_UTC, CDC_SYSTEM_UTC },
+      };
+  // Around the 2012 leap second and the changes to and from BST, with
+  // a time that doesn't exist in the UK.
+  static const cdc_calendar_t times[] = 
+    {
+      { 2012, CDC_JUNE, 30, 23, 59, 59, 999999999, 0 },
+      { 2012, CDC_JULY, 1, 0, 0, 0, 0, 0 },
+      { 2012, CDC_JULY, 1, 0, 59, 60, 0, 0 },
+      { 2010, CDC_MARCH, 28, 0, 59, 59, 0, 0 },
+      { 2010, CDC_MARCH, 28, 1, 30, 0, 0, 0 },
+      { 2010, CDC_OCTOBER, 31, 1, 30, 0, 0, 0 },
+      { 1970, CDC_JANUARY, 1, 0, 0, 0, 0, 0 },
+      { 2010, CDC_JUNE, 15, 12, 34, 56, 789, 0 },
+    };
+  enum { NR_TIMES = sizeof(times) / sizeof(times[0]) };
+  cdc_calendar_t src[NR_TIMES], planned[NR_TIMES], bounced, tmp;
+  int errs[NR_TIMES];
+  cdc_zone_t *down, *up, *raw;
+  cdc_plan_t *plan;
+  char msg[128];
+  int rv, bounce_rv;
+  size_t i, j;
+
+  for (i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i)
+    {
+      rv = cdc_zone_get_shared(&down, pairs[i].down);
+      rv |= cdc_zone_get_shared(&up, pairs[i].up);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't get zones to plan for");
+      rv = cdc_plan_compile(&plan, down, up);
+      sprintf(msg, "Can't compile plan [%d]", (int)i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+
+      for (j = 0; j < NR_TIMES; ++j)
+	{
+	  memcpy(&src[j], &times[j], sizeof(cdc_calendar_t));
+	  src[j].system = pairs[i].down;
+	}
+      rv = cdc_plan_apply_batch(plan, planned, src, NR_TIMES, errs);
+
+      for (j = 0; j < NR_TIMES; ++j)
+	{
+	  bounce_rv = cdc_bounce(down, up, &bounced, &src[j]);
+	  sprintf(msg, "Plan and bounce disagree [%d, %d]", (int)i, (int)j);
+	  ASSERT_INTEGERS_EQUAL(bounce_rv, errs[j], msg);
+	  if (bounce_rv) { continue; }
+	  ASSERT_INTEGERS_EQUAL(0, cdc_calendar_cmp(&bounced, &planned[j]), 
+				msg);
+	  ASSERT_INTEGERS_EQUAL((int)bounced.system, (int)planned[j].system,
+				msg);
+
+	  rv = cdc_plan_apply(plan, &tmp, &src[j]);
+	  sprintf(msg, "Plan applied singly is wrong [%d, %d]", 
+		  (int)i, (int)j);
+	  ASSERT_INTEGERS_EQUAL(0, rv, msg);
+	  ASSERT_INTEGERS_EQUAL(0, cdc_calendar_cmp(&bounced, &tmp), msg);
+	}
+
+      rv = cdc_plan_dispose(&plan);
+      ASSERT_INTEGERS_EQUAL(1, (rv == 0 && plan == NULL), 
+			    "Can't dispose of plan");
+    }
+
+  // A time in a zone further down doesn't use the plan, but still 
+  // converts.
+  rv = cdc_zone_get_shared(&down, CDC_SYSTEM_UKCT);
+  rv |= cdc_zone_get_shared(&up, CDC_SYSTEM_UTCPLUS_ZERO - 300);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get zones to plan for");
+  rv = cdc_plan_compile(&plan, down, up);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't compile UK -> UTC-0500");
+  memcpy(&tmp, &times[0], sizeof(cdc_calendar_t));
+  tmp.system = CDC_SYSTEM_UTC;
+  rv = cdc_plan_apply(plan, &planned[0], &tmp);
+  bounce_rv = cdc_bounce(down, up, &bounced, &tmp);
+  ASSERT_INTEGERS_EQUAL(bounce_rv, rv, "Plan from UTC failed");
+  ASSERT_INTEGERS_EQUAL(0, cdc_calendar_cmp(&bounced, &planned[0]), 
+			"Plan from UTC is wrong");
+  rv = cdc_plan_dispose(&plan);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of plan");
+
+  // A UTC zone with nothing under it has nothing in common with TAI.
+  rv = cdc_zone_new(CDC_SYSTEM_UTC, &raw, 0, NULL);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't make raw UTC zone");
+  rv = cdc_zone_get_shared(&up, CDC_SYSTEM_GREGORIAN_TAI);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get shared TAI");
+  plan = (cdc_plan_t *)1;
+  rv = cdc_plan_compile(&plan, raw, up);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NOT_MY_SYSTEM, rv, 
+			"Compiled a plan between unrelated zones");
+  ASSERT_INTEGERS_EQUAL(1, (plan == NULL), 
+			"Failed compile didn't clear plan");
+  rv = cdc_zone_dispose(&raw);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of raw UTC zone");
+
+  rv = cdc_plan_dispose(&plan);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of no plan");
+
+  return 0;
+}
+
+static int cdc_test_arena(void)
+{
+  enum { NR_ZONES = 50 };
+  const cdc_calendar_t when = 
+    { 2010, CDC_MARCH, 28, 0, 30, 0, 0, CDC_SYSTEM_GREGORIAN_TAI };
+  cdc_calendar_t offset, from_arena, from_malloc;
+  cdc_zone_t *zones[NR_ZONES];
+  cdc_zone_t *ukct, *tai, *z, *plain;
+  cdc_arena_t *arena, *bad;
+  char msg[128];
+  int rv, i;
+
+  rv = cdc_arena_new(&bad, -1);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_INVALID_ARGUMENT, rv, 
+			"Made an arena with negative blocks");
+
+  // The smallest blocks there are, so every zone needs a new one.
+  rv = cdc_arena_new(&arena, 1);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't make arena");
+  rv = cdc_zone_get_shared(&ukct, CDC_SYSTEM_UKCT);
+  rv |= cdc_zone_get_shared(&tai, CDC_SYSTEM_GREGORIAN_TAI);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't get shared zones");
+
+  memset(&offset, '\0', sizeof(cdc_calendar_t));
+  offset.system = CDC_SYSTEM_OFFSET;
+  for (i = 0; i < NR_ZONES; ++i)
+    {
+      offset.minute = i * 7;
+      offset.ns = i;
+      rv = cdc_arena_rebased_new(arena, &zones[i], &offset, ukct);
+      sprintf(msg, "Can't make rebased zone in arena [%d]", i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      sprintf(msg, "Arena zone isn't marked [%d]", i);
+      ASSERT_INTEGERS_EQUAL(CDC_ZONE_FLAG_ARENA, 
+			    (int)(zones[i]->flags & CDC_ZONE_FLAG_ARENA), 
+			    msg);
+    }
+
+  for (i = 0; i < NR_ZONES; ++i)
+    {
+      offset.minute = i * 7;
+      offset.ns = i;
+      rv = cdc_rebased_new(&plain, &offset, ukct);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't make rebased zone");
+
+      rv = cdc_bounce(tai, zones[i], &from_arena, &when);
+      sprintf(msg, "Can't convert into arena zone [%d]", i);
+      ASSERT_INTEGERS_EQUAL(0, rv, msg);
+      rv = cdc_bounce(tai, plain, &from_malloc, &when);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't convert into rebased zone");
+      sprintf(msg, "Arena and malloc()ed zones disagree [%d]", i);
+      ASSERT_INTEGERS_EQUAL(0, cdc_calendar_cmp(&from_arena, &from_malloc),
+			    msg);
+
+      rv = cdc_zone_dispose(&plain);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of rebased zone");
+    }
+
+  // Disposing of an arena zone leaves it be.
+  z = zones[0];
+  rv = cdc_zone_dispose(&z);
+  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && z == NULL), 
+			"Can't dispose of arena zone");
+  rv = cdc_bounce(tai, zones[0], &from_arena, &when);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Arena zone went when disposed of");
+
+  // After a reset, the same memory comes round again.
+  rv = cdc_arena_reset(arena);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't reset arena");
+  rv = cdc_arena_rebased_new(arena, &z, &offset, ukct);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't make zone after reset");
+  ASSERT_INTEGERS_EQUAL(1, (z == zones[0]), 
+			"Arena didn't reuse its memory");
+  for (i = 1; i < NR_ZONES; ++i)
+    {
+      rv = cdc_arena_rebased_new(arena, &z, &offset, ukct);
+      ASSERT_INTEGERS_EQUAL(0, rv, "Can't refill arena");
+    }
+  ASSERT_INTEGERS_EQUAL(1, (z == zones[NR_ZONES - 1]), 
+			"Arena didn't reuse all its blocks");
+
+  rv = cdc_arena_zone_new(arena, CDC_SYSTEM_OFFSET, &z, 0, NULL);
+  ASSERT_INTEGERS_EQUAL(CDC_ERR_NO_SUCH_SYSTEM, rv, 
+			"Made a zone for a system with no zones");
+  rv = cdc_arena_zone_new(arena, CDC_SYSTEM_UTC, &z, 0, tai);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't make UTC zone in arena");
+  rv = cdc_bounce(tai, z, &from_arena, &when);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't convert into arena UTC zone");
+
+  rv = cdc_arena_dispose(&arena);
+  ASSERT_INTEGERS_EQUAL(1, (rv == 0 && arena == NULL), 
+			"Can't dispose of arena");
+  rv = cdc_arena_dispose(&arena);
+  ASSERT_INTEGERS_EQUAL(0, rv, "Can't dispose of no arena");
+
+  return 0;
+}
+
 static int cdc_test_rebased(void)
 {
   cdc_zone_t *rb;